@@ -0,0 +1,525 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "corpus.h"
+#include "lexer.h"
+#include "parser.h"
+#include "flat.h"
+#include "analyzer.h"
+#include "lower.h"
+#include "fold.h"
+#include "symbol.h"
+
+#define DEFAULT_KIB 1024        // Corpus size
+#define DEFAULT_RUNS 11         // Samples per benchmark
+#define DEFAULT_DEPTH 64        // Call nesting of the nested shape
+#define DEFAULT_IDENT 48        // Identifier length of the idents shape
+#define DEFAULT_SYMBOLS 4096    // Symbols besides the builtins in the searched table
+#define DEFAULT_INSERTS 1000000 // Symbols added by the `add_symbol` benchmark
+#define LOOKUPS 100000          // `search_symbol` calls per sample
+#define LOOKUP_SCOPES 4         // Scopes the searched symbols are spread over
+#define MISSES 64               // Names searched for but never declared
+
+// One run of a phase benchmark, in a context of its own. Sets the time of the
+// measured call and the items it processed, returns false if the run failed.
+typedef bool (*RunFn)(CompilerContext *ctx, const char *path, double *ms, size_t *items);
+
+static int workers = 1; // Threads of the parallel resolve benchmark, `-j`
+
+// Samples of one benchmark, in milliseconds
+typedef struct {
+    double *ms;
+    int count;
+} Samples;
+
+/**
+ * @brief Monotonic wall clock in milliseconds.
+ * @return
+ */
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+/**
+ * @brief Orders samples, for `qsort`.
+ * @param a
+ * @param b
+ * @return
+ */
+static int cmp_ms(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Nearest rank percentile of sorted samples.
+ * @param s
+ * @param q Fraction in (0, 1].
+ * @return
+ */
+static double percentile(const Samples *s, double q) {
+    int rank = (int)(q * s->count);
+    if (rank < q * s->count) rank++; // Rounds up
+    return s->ms[rank > 0 ? rank - 1 : 0];
+}
+
+/**
+ * @brief Prints the distribution of the samples and the throughput at the
+ * median.
+ * @param name
+ * @param s Sorted in place.
+ * @param items Items processed per sample.
+ * @param unit What the items are.
+ */
+static void print_samples(const char *name, Samples *s, size_t items, const char *unit) {
+    qsort(s->ms, s->count, sizeof(double), cmp_ms);
+
+    double p50 = percentile(s, 0.5);
+    printf(
+        "  %-8s %10.3f %10.3f %10.3f %10.3f %10.3f %10.2f M%s/s\n", name, s->ms[0], p50,
+        percentile(s, 0.9), percentile(s, 0.99), s->ms[s->count - 1],
+        p50 > 0 ? items / (p50 * 1e3) : 0, unit
+    );
+}
+
+/**
+ * @brief Counts the nodes the parser allocated.
+ * @param prs
+ * @return
+ */
+static size_t ast_nodes(const Parser *prs) {
+    ParseStats stats = parse_stats(prs);
+
+    size_t nodes = 0;
+    for (int i = 0; i <= NODE_TYPE; i++) nodes += stats.nodes[i];
+    return nodes;
+}
+
+/**
+ * @brief Counts the nodes of a flat AST.
+ * @param ast
+ * @return
+ */
+static size_t flat_nodes(const FlatAst *ast) {
+    return (size_t)ast->type_count + ast->decl_count + ast->block_count + ast->stmt_count +
+           ast->expr_count;
+}
+
+/**
+ * @brief Times `scan` of the whole file, see `RunFn`.
+ */
+static bool run_scan(CompilerContext *ctx, const char *path, double *ms, size_t *items) {
+    Lexer *lexer = make_lexer(ctx, path);
+    if (!lexer) return false;
+
+    double t0     = now();
+    TokList *list = scan(lexer);
+    *ms           = now() - t0;
+
+    if (list) *items = list->count;
+    purge_toklist(list);
+    purge_lexer(lexer);
+    return list != NULL;
+}
+
+/**
+ * @brief Times `parse_program` over a token list scanned beforehand, see
+ * `RunFn`.
+ */
+static bool run_parse(CompilerContext *ctx, const char *path, double *ms, size_t *items) {
+    Lexer *lexer   = make_lexer(ctx, path);
+    TokList *list  = lexer ? scan(lexer) : NULL;
+    Parser *parser = list ? make_parser(ctx, list) : NULL;
+    Program *prog  = NULL;
+
+    if (parser) {
+        double t0 = now();
+        prog      = parse_program(parser);
+        *ms       = now() - t0;
+        *items    = ast_nodes(parser);
+    }
+
+    purge_parser(parser);
+    purge_toklist(list);
+    purge_lexer(lexer);
+    return prog != NULL;
+}
+
+/**
+ * @brief Times `resolve_parallel` over a flat AST built beforehand.
+ * @param ctx
+ * @param path
+ * @param ms
+ * @param items
+ * @param threads Analyzer threads, 1 resolves serially.
+ * @return false if the run failed.
+ */
+static bool time_resolve(
+    CompilerContext *ctx, const char *path, double *ms, size_t *items, int threads
+) {
+    Lexer *lexer   = make_lexer(ctx, path);
+    TokList *list  = lexer ? scan(lexer) : NULL;
+    Parser *parser = list ? make_parser(ctx, list) : NULL;
+    Program *prog  = parser ? parse_program(parser) : NULL;
+    FlatAst *ast   = prog ? flatten_program(ctx, prog) : NULL;
+    Analyzer *anz  = ast ? make_analyzer(ctx) : NULL;
+    CompErr err    = CERR_NOMEM;
+
+    if (anz) {
+        double t0 = now();
+        err       = resolve_parallel(anz, ast, threads);
+        *ms       = now() - t0;
+        *items    = flat_nodes(ast);
+    }
+
+    purge_analyzer(anz);
+    purge_flat(ast);
+    purge_parser(parser);
+    purge_toklist(list);
+    purge_lexer(lexer);
+    return err == CERR_OK;
+}
+
+/**
+ * @brief Times `resolve_program`, see `RunFn`.
+ */
+static bool run_resolve(CompilerContext *ctx, const char *path, double *ms, size_t *items) {
+    return time_resolve(ctx, path, ms, items, 1);
+}
+
+/**
+ * @brief Times `resolve_parallel` on `workers` threads, see `RunFn`.
+ */
+static bool run_parallel(CompilerContext *ctx, const char *path, double *ms, size_t *items) {
+    return time_resolve(ctx, path, ms, items, workers);
+}
+
+/**
+ * @brief Lowers a program into a module, timing `lower_program` and then, if
+ * `fold`, `fold_module` instead.
+ * @param ctx
+ * @param path
+ * @param ms
+ * @param items IR instructions made, or the ones folding went through.
+ * @param fold
+ * @return false if the run failed.
+ */
+static bool time_lower(
+    CompilerContext *ctx, const char *path, double *ms, size_t *items, bool fold
+) {
+    Lexer *lexer   = make_lexer(ctx, path);
+    TokList *list  = lexer ? scan(lexer) : NULL;
+    Parser *parser = list ? make_parser(ctx, list) : NULL;
+    Program *prog  = parser ? parse_program(parser) : NULL;
+    FlatAst *ast   = prog ? flatten_program(ctx, prog) : NULL;
+    Analyzer *anz  = ast ? make_analyzer(ctx) : NULL;
+    IrModule *mod  = NULL;
+
+    if (anz && resolve_program(anz, ast) == CERR_OK) {
+        double t0 = now();
+        mod       = lower_program(ctx, ast);
+        *ms       = now() - t0;
+        *items    = mod ? ir_inst_count(mod) : 0;
+    }
+    if (mod && fold) {
+        double t0 = now();
+        fold_module(ctx, mod);
+        *ms = now() - t0;
+    }
+
+    purge_module(mod);
+    purge_analyzer(anz);
+    purge_flat(ast);
+    purge_parser(parser);
+    purge_toklist(list);
+    purge_lexer(lexer);
+    return mod && ctx->err == CERR_OK;
+}
+
+/**
+ * @brief Times `lower_program`, see `RunFn`.
+ */
+static bool run_lower(CompilerContext *ctx, const char *path, double *ms, size_t *items) {
+    return time_lower(ctx, path, ms, items, false);
+}
+
+/**
+ * @brief Times `fold_module` over a freshly lowered module, see `RunFn`.
+ */
+static bool run_fold(CompilerContext *ctx, const char *path, double *ms, size_t *items) {
+    return time_lower(ctx, path, ms, items, true);
+}
+
+/**
+ * @brief Runs a phase benchmark `s->count` times and prints its samples. The
+ * first failing run ends it, with its diagnostics printed instead.
+ * @param name
+ * @param fn
+ * @param path
+ * @param s
+ * @param unit What the items of the phase are.
+ * @return false if a run failed.
+ */
+static bool bench_phase(
+    const char *name, RunFn fn, const char *path, Samples *s, const char *unit
+) {
+    size_t items = 0;
+
+    for (int i = 0; i < s->count; i++) {
+        CompilerContext *ctx = make_context();
+        if (!ctx) return false;
+        ctx->trace = NULL;
+
+        bool ok = fn(ctx, path, &s->ms[i], &items);
+        if (!ok) {
+            printf("  %-8s failed\n", name);
+            print_diags(&ctx->diags, stdout);
+        }
+
+        purge_context(ctx);
+        if (!ok) return false;
+    }
+
+    print_samples(name, s, items, unit);
+    return true;
+}
+
+/**
+ * @brief Times `search_symbol` on a table of `symbols` names spread over
+ * `LOOKUP_SCOPES` scopes. Each sample searches from the innermost scope
+ * `LOOKUPS` times, one in eight for a name that is not declared.
+ * @param symbols
+ * @param seed
+ * @param s
+ * @return false if memory ran out.
+ */
+static bool bench_search(unsigned symbols, unsigned seed, Samples *s) {
+    CompilerContext *ctx = make_context();
+    SymTab *table        = ctx ? make_symtab(ctx) : NULL;
+    const Atom **names   = calloc(symbols + MISSES, sizeof(Atom *));
+    const Atom **keys    = calloc(LOOKUPS, sizeof(Atom *));
+    bool ok              = table && names && keys && init_symtab(table, NULL);
+
+    char buf[32];
+    for (unsigned i = 0; ok && i < symbols + MISSES; i++) {
+        snprintf(buf, sizeof(buf), i < symbols ? "sym%u" : "miss%u", i);
+        names[i] = intern_cstr(&ctx->interner, buf);
+        if (!names[i]) {
+            ok = false;
+        } else if (i < symbols) {
+            Symbol *sym = make_symbol(names[i], SG_VAR, SA_DEC, 0, i % LOOKUP_SCOPES, NULL);
+            ok          = sym && add_symbol(table, sym);
+            if (sym && !ok) free(sym);
+        }
+    }
+
+    srand(seed);
+    for (unsigned i = 0; ok && i < LOOKUPS; i++) {
+        unsigned pick = rand() % 8 ? rand() % symbols : symbols + rand() % MISSES;
+        keys[i]       = names[pick];
+    }
+
+    unsigned found = 0;
+    for (int i = 0; ok && i < s->count; i++) {
+        double t0 = now();
+        for (unsigned k = 0; k < LOOKUPS; k++) {
+            found += search_symbol(table, keys[k], LOOKUP_SCOPES - 1) != NULL;
+        }
+        s->ms[i] = now() - t0;
+    }
+
+    if (ok) {
+        printf("search_symbol: %u symbols, %u found per sample\n", table->count, found / s->count);
+        print_samples("search", s, LOOKUPS, "lookup");
+    } else {
+        printf("search_symbol: out of memory\n");
+    }
+
+    free(keys);
+    free(names);
+    purge_symtab(table);
+    purge_context(ctx);
+    return ok;
+}
+
+/**
+ * @brief Times every single `add_symbol` of `count` new names into one table,
+ * to show the latency of the insertions that grow it.
+ * @param count
+ * @return false if memory ran out.
+ */
+static bool bench_insert(unsigned count) {
+    CompilerContext *ctx = make_context();
+    SymTab *table        = ctx ? make_symtab(ctx) : NULL;
+    const Atom **names   = calloc(count, sizeof(Atom *));
+    Samples s            = {.ms = calloc(count, sizeof(double)), .count = count};
+    bool ok              = table && names && s.ms;
+
+    char buf[32];
+    for (unsigned i = 0; ok && i < count; i++) {
+        snprintf(buf, sizeof(buf), "ins%u", i);
+        names[i] = intern_cstr(&ctx->interner, buf);
+        ok       = names[i] != NULL;
+    }
+
+    double total = 0;
+    for (unsigned i = 0; ok && i < count; i++) {
+        Symbol *sym = make_symbol(names[i], SG_VAR, SA_DEC, 0, 0, NULL);
+        double t0   = now();
+        ok          = sym && add_symbol(table, sym);
+        s.ms[i]     = now() - t0;
+        total      += s.ms[i];
+        if (sym && !ok) free(sym);
+    }
+
+    if (ok) {
+        qsort(s.ms, s.count, sizeof(double), cmp_ms);
+        printf("add_symbol: %u inserts in %.3f ms, latency in us\n", count, total);
+        printf("  %-8s %10s %10s %10s %10s %10s\n", "", "p50", "p99", "p99.9", "p99.99", "max");
+        printf(
+            "  %-8s %10.3f %10.3f %10.3f %10.3f %10.3f\n", "insert", percentile(&s, 0.5) * 1e3,
+            percentile(&s, 0.99) * 1e3, percentile(&s, 0.999) * 1e3, percentile(&s, 0.9999) * 1e3,
+            s.ms[s.count - 1] * 1e3
+        );
+    } else {
+        printf("add_symbol: out of memory\n");
+    }
+
+    free(s.ms);
+    free(names);
+    purge_symtab(table);
+    purge_context(ctx);
+    return ok;
+}
+
+/**
+ * @brief Writes a corpus into a temporary file.
+ * @param spec
+ * @param tmp Receives the temporary file name, at least 32 bytes.
+ * @return Bytes written, 0 if the file could not be created.
+ */
+static size_t make_corpus(const CorpusSpec *spec, char *tmp) {
+    strcpy(tmp, "/tmp/corx-corpusXXXXXX");
+    int fd = mkstemp(tmp);
+    if (fd == -1) return 0;
+
+    FILE *out = fdopen(fd, "w");
+    if (!out) {
+        close(fd);
+        unlink(tmp);
+        return 0;
+    }
+
+    size_t size = write_corpus(spec, out);
+    fclose(out);
+    return size;
+}
+
+/**
+ * Generates a corpus of every requested shape, `mixed nested block funcs
+ * comments idents` by default, and times `scan`, `parse_program`,
+ * `resolve_program`, `lower_program` and `fold_module` on it, and
+ * `resolve_parallel` on `-j` threads if more than one, then `search_symbol`
+ * and `add_symbol` on their own. Each benchmark is repeated and its minimum,
+ * median, 90th and 99th percentile and maximum are reported in milliseconds,
+ * with the throughput at the median. The same options always generate the
+ * same corpora.
+ *
+ * usage: corx_bench [-s KiB] [-r runs] [-S seed] [-d depth] [-i ident]
+ *                   [-n symbols] [-N inserts] [-j threads] [shape...]
+ */
+int main(int argc, char **argv) {
+    size_t kib       = DEFAULT_KIB;
+    int runs         = DEFAULT_RUNS;
+    unsigned seed    = 1;
+    unsigned depth   = DEFAULT_DEPTH;
+    unsigned ident   = DEFAULT_IDENT;
+    unsigned symbols = DEFAULT_SYMBOLS;
+    unsigned inserts = DEFAULT_INSERTS;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:r:S:d:i:n:N:j:")) != -1) {
+        switch (opt) {
+        case 's': kib = strtoul(optarg, NULL, 10); break;
+        case 'r': runs = atoi(optarg); break;
+        case 'S': seed = strtoul(optarg, NULL, 10); break;
+        case 'd': depth = strtoul(optarg, NULL, 10); break;
+        case 'i': ident = strtoul(optarg, NULL, 10); break;
+        case 'n': symbols = strtoul(optarg, NULL, 10); break;
+        case 'N': inserts = strtoul(optarg, NULL, 10); break;
+        case 'j': workers = atoi(optarg); break;
+        default:
+            fprintf(
+                stderr,
+                "usage: %s [-s KiB] [-r runs] [-S seed] [-d depth] [-i ident] [-n symbols] "
+                "[-N inserts] [-j threads] [shape...]\n",
+                argv[0]
+            );
+            return 1;
+        }
+    }
+    if (runs < 1) runs = 1;
+    if (symbols < 1) symbols = 1;
+    if (inserts < 1) inserts = 1;
+
+    Shape shapes[SHAPE_COUNT];
+    int count = 0;
+    for (int i = optind; i < argc && count < SHAPE_COUNT; i++) {
+        if ((shapes[count++] = shape_from_str(argv[i])) == SHAPE_COUNT) {
+            fprintf(stderr, "unknown shape '%s'\n", argv[i]);
+            return 1;
+        }
+    }
+    if (!count) {
+        for (; count < SHAPE_COUNT; count++) shapes[count] = count;
+    }
+
+    Samples s = {.ms = calloc(runs, sizeof(double)), .count = runs};
+    if (!s.ms) return 1;
+
+    int fails = 0;
+    printf("%d runs per benchmark, times in ms\n", runs);
+    printf(
+        "  %-8s %10s %10s %10s %10s %10s %10s\n", "", "min", "p50", "p90", "p99", "max",
+        "at p50"
+    );
+
+    for (int i = 0; i < count; i++) {
+        CorpusSpec spec = {
+            .shape = shapes[i],
+            .size  = kib << 10,
+            .seed  = seed,
+            .depth = depth,
+            .ident = ident,
+        };
+
+        char tmp[32];
+        size_t size = make_corpus(&spec, tmp);
+        if (!size) {
+            fprintf(stderr, "failed to write the %s corpus\n", shape_str(shapes[i]));
+            free(s.ms);
+            return 1;
+        }
+
+        printf("corpus %s: %.1f KiB\n", shape_str(shapes[i]), size / 1024.0);
+        fails += !bench_phase("scan", run_scan, tmp, &s, "tok");
+        fails += !bench_phase("parse", run_parse, tmp, &s, "node");
+        fails += !bench_phase("resolve", run_resolve, tmp, &s, "node");
+        if (workers > 1) fails += !bench_phase("parallel", run_parallel, tmp, &s, "node");
+        fails += !bench_phase("lower", run_lower, tmp, &s, "inst");
+        fails += !bench_phase("fold", run_fold, tmp, &s, "inst");
+        unlink(tmp);
+    }
+
+    fails += !bench_search(symbols, seed, &s);
+    fails += !bench_insert(inserts);
+    free(s.ms);
+
+    return fails > 0;
+}
@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lexer.h"
+
+#define DEFAULT_RUNS 3
+
+// Scanner configuration under test
+typedef struct {
+    const char *name;
+    LexEngine engine;
+    int workers; // `scan_parallel` workers, 0 for `scan`
+} Config;
+
+/**
+ * @brief Monotonic wall clock in seconds.
+ * @return
+ */
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Writes `path` repeated up to at least `size` bytes into a temporary file.
+ * @param ctx
+ * @param path Source to replicate.
+ * @param size Target size in bytes.
+ * @param tmp Receives the temporary file name, at least 32 bytes.
+ * @return 0 on success.
+ */
+static int replicate(CompilerContext *ctx, const char *path, size_t size, char *tmp) {
+    Lexer *src = make_lexer(ctx, path);
+    if (!src || src->size == 0) {
+        purge_lexer(src);
+        return 1;
+    }
+
+    strcpy(tmp, "/tmp/corx-benchXXXXXX");
+    int fd = mkstemp(tmp);
+    if (fd == -1) return 1;
+
+    FILE *out = fdopen(fd, "w");
+    for (size_t written = 0; written < size; written += src->size + 1) {
+        fwrite(src->buffer, 1, src->size, out);
+        fputc('\n', out); // keep copies from merging tokens across the seam
+    }
+    fclose(out);
+    purge_lexer(src);
+    return 0;
+}
+
+/**
+ * @brief Scans `path` with `cfg`, keeping the fastest of `runs`.
+ * @param ctx
+ * @param path
+ * @param cfg
+ * @param runs
+ * @param best Receives the best time in seconds.
+ * @param lexer Receives the lexer of the last run.
+ * @return Token list of the last run, NULL if a run failed.
+ */
+static TokList *run(
+    CompilerContext *ctx, const char *path, const Config *cfg, int runs, double *best,
+    Lexer **lexer
+) {
+    TokList *list = NULL;
+    *lexer        = NULL;
+
+    for (int i = 0; i < runs; i++) {
+        purge_toklist(list);
+        purge_lexer(*lexer);
+
+        *lexer = make_lexer(ctx, path);
+        if (!*lexer) return NULL;
+        (*lexer)->engine = cfg->engine;
+
+        double t0 = now();
+        list      = cfg->workers ? scan_parallel(*lexer, cfg->workers) : scan(*lexer);
+        double t  = now() - t0;
+        if (!list) return NULL;
+
+        if (i == 0 || t < *best) *best = t;
+    }
+    return list;
+}
+
+/**
+ * @brief Checks that two token streams are identical.
+ * @param a
+ * @param b
+ * @return Index of the first difference, or -1.
+ */
+static int compare(const TokList *a, const TokList *b) {
+    int count = a->count < b->count ? a->count : b->count;
+    for (int i = 0; i < count; i++) {
+        if (a->types[i] != b->types[i] || a->lines[i] != b->lines[i] ||
+            a->cols[i] != b->cols[i] || a->offs[i] != b->offs[i] || a->lens[i] != b->lens[i] ||
+            a->hashes[i] != b->hashes[i]) {
+            return i;
+        }
+    }
+    return a->count == b->count ? -1 : count;
+}
+
+/**
+ * Compares the `scan` engines and `scan_parallel` on one file, optionally
+ * replicated to a size. Every token stream must be identical to the hand-coded
+ * one, otherwise the first mismatch is reported and the benchmark fails.
+ *
+ * usage: corx_bench_lexer <file> [megabytes] [runs] [workers]
+ */
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <file> [megabytes] [runs] [workers]\n", argv[0]);
+        return 1;
+    }
+
+    const char *path = argv[1];
+    size_t mbytes    = argc > 2 ? strtoul(argv[2], NULL, 10) : 0;
+    int runs         = argc > 3 ? atoi(argv[3]) : DEFAULT_RUNS;
+    int workers      = argc > 4 ? atoi(argv[4]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (runs < 1) runs = 1;
+    if (workers < 2) workers = 2;
+
+    CompilerContext *ctx = make_context();
+    if (!ctx) return 1;
+
+    char tmp[32] = {0};
+    if (mbytes > 0) {
+        if (replicate(ctx, path, mbytes << 20, tmp) != 0) {
+            print_diags(&ctx->diags, stderr);
+            fprintf(stderr, "failed to replicate %s\n", path);
+            return 1;
+        }
+        path = tmp;
+    }
+
+    char parallel[32];
+    snprintf(parallel, sizeof(parallel), "hand x%d", workers);
+
+    Config configs[] = {
+        {"hand", LEX_HAND, 0},
+        {"dfa", LEX_DFA, 0},
+        {parallel, LEX_HAND, workers},
+    };
+    int count = sizeof(configs) / sizeof(configs[0]);
+    int fails = 0;
+
+    TokList *base = NULL;
+    Lexer *base_lexer;
+
+    for (int c = 0; c < count; c++) {
+        Lexer *lexer;
+        double best;
+        TokList *list = run(ctx, path, &configs[c], runs, &best, &lexer);
+        if (!list) {
+            print_diags(&ctx->diags, stderr);
+            return 1;
+        }
+
+        double mb = lexer->size / 1048576.0;
+        printf(
+            "%-10s %9.2f ms %8.2f MB/s %8.2f Mtok/s", configs[c].name, best * 1e3, mb / best,
+            list->count / best / 1e6
+        );
+
+        if (!base) {
+            printf("  (%d tokens)\n", list->count);
+            base       = list;
+            base_lexer = lexer;
+            continue;
+        }
+
+        int diff = compare(base, list);
+        if (diff >= 0) {
+            printf("  differs at token %d (line %d)\n", diff, base->lines[diff]);
+            fails++;
+        } else {
+            printf("  identical\n");
+        }
+        purge_toklist(list);
+        purge_lexer(lexer);
+    }
+
+    purge_toklist(base);
+    purge_lexer(base_lexer);
+    purge_context(ctx);
+    if (tmp[0]) unlink(tmp);
+
+    return fails > 0;
+}
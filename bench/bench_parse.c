@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "lexer.h"
+#include "parser.h"
+#include "flat.h"
+
+#define DEFAULT_RUNS 5
+
+/**
+ * @brief Monotonic wall clock in seconds.
+ * @return
+ */
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * Measures `scan` + `parse_program` throughput in tokens per second, and the
+ * same parse driven by a `scan_stream` token stream instead of a full list.
+ * Best of `runs` is reported so page cache and allocator warm-up don't count.
+ * AST teardown time, arena statistics of the last parse and the time and size
+ * of its flat form are reported too.
+ *
+ * usage: corx_bench_parse <file> [runs]
+ */
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <file> [runs]\n", argv[0]);
+        return 1;
+    }
+
+    int runs = argc > 2 ? atoi(argv[2]) : DEFAULT_RUNS;
+    if (runs < 1) runs = 1;
+
+    double best_scan   = 0;
+    double best_parse  = 0;
+    double best_stream = 0;
+    double best_purge  = 0;
+    double best_flat   = 0;
+    size_t flat_bytes  = 0;
+    int count          = 0;
+    size_t size        = 0;
+    ParseStats stats   = {0};
+
+    CompilerContext *ctx = make_context();
+    if (!ctx) return 1;
+
+    for (int i = 0; i < runs; i++) {
+        Lexer *lexer = make_lexer(ctx, argv[1]);
+        if (!lexer) {
+            print_diags(&ctx->diags, stderr);
+            return 1;
+        }
+        size = lexer->size;
+
+        double t0     = now();
+        TokList *list = scan(lexer);
+        double t1     = now();
+
+        Parser *parser = make_parser(ctx, list);
+        Program *prog  = parse_program(parser);
+        double t2      = now();
+        stats          = parse_stats(parser);
+        if (!prog) {
+            print_diags(&ctx->diags, stderr);
+            return 1;
+        }
+
+        FlatAst *ast = flatten_program(ctx, prog);
+        double t3    = now();
+        flat_bytes   = flat_size(ast);
+        purge_flat(ast);
+
+        double t4 = now();
+        purge_parser(parser);
+        double t5 = now();
+
+        if (i == 0 || t1 - t0 < best_scan) best_scan = t1 - t0;
+        if (i == 0 || t2 - t1 < best_parse) best_parse = t2 - t1;
+        if (i == 0 || t3 - t2 < best_flat) best_flat = t3 - t2;
+        if (i == 0 || t5 - t4 < best_purge) best_purge = t5 - t4;
+        count = list->count;
+
+        purge_toklist(list);
+        purge_lexer(lexer);
+
+        lexer  = make_lexer(ctx, argv[1]);
+        t0     = now();
+        list   = scan_stream(lexer);
+        parser = make_parser(ctx, list);
+        parse_program(parser);
+        t1 = now();
+
+        if (i == 0 || t1 - t0 < best_stream) best_stream = t1 - t0;
+
+        purge_parser(parser);
+        purge_toklist(list);
+        purge_lexer(lexer);
+    }
+
+    purge_context(ctx);
+
+    double total = best_scan + best_parse;
+
+    printf("file:   %s (%zu bytes, %d tokens)\n", argv[1], size, count);
+    printf("scan:   %8.2f ms %8.2f Mtok/s\n", best_scan * 1e3, count / best_scan / 1e6);
+    printf("parse:  %8.2f ms %8.2f Mtok/s\n", best_parse * 1e3, count / best_parse / 1e6);
+    printf("total:  %8.2f ms %8.2f Mtok/s\n", total * 1e3, count / total / 1e6);
+    printf("stream: %8.2f ms %8.2f Mtok/s\n", best_stream * 1e3, count / best_stream / 1e6);
+    printf("purge:  %8.2f ms\n", best_purge * 1e3);
+    printf("flat:   %8.2f ms %zu bytes\n", best_flat * 1e3, flat_bytes);
+
+    static const char *kinds[] = {
+        [NODE_PROGRAM] = "program", //
+        [NODE_DECL]    = "decl",    //
+        [NODE_BLOCK]   = "block",   //
+        [NODE_STMT]    = "stmt",    //
+        [NODE_EXPR]    = "expr",    //
+        [NODE_TYPE]    = "type",    //
+    };
+
+    printf("arena:  %zu bytes used, %zu reserved\n", stats.used, stats.reserved);
+    for (int k = 0; k <= NODE_TYPE; k++) {
+        printf("  %-8s %10u\n", kinds[k], stats.nodes[k]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,301 @@
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "corpus.h"
+
+#define MAX_IDENT 256    // Longest `SHAPE_IDENTS` name, longer ones are clamped
+#define MIXED_BLOCK 1000 // Statements of a huge block in a mixed corpus
+
+static const char *shape_names[SHAPE_COUNT] = {
+    [SHAPE_MIXED]    = "mixed",
+    [SHAPE_NESTED]   = "nested",
+    [SHAPE_BLOCK]    = "block",
+    [SHAPE_FUNCS]    = "funcs",
+    [SHAPE_COMMENTS] = "comments",
+    [SHAPE_IDENTS]   = "idents",
+};
+
+// Filler of comments
+static const char *words[] = {
+    "the",   "scanner", "skips", "this",   "text", "while", "looking", "for",
+    "a",     "newline", "or",    "star",   "and",  "slash", "tokens",  "never",
+    "start", "inside",  "notes", "about",  "int",  "float", "return",  "calls",
+};
+
+// Generator state, one function is being written at a time
+typedef struct {
+    const CorpusSpec *spec;
+    FILE *out;
+    size_t written;   // Bytes written so far
+    uint32_t rand;    // xorshift32 state, never 0
+    unsigned funcs;   // Functions written, `f<i>(int, int)` for every i below
+    unsigned globals; // Globals written, `g<i>` for every i below
+    unsigned fn;      // Function being written
+    unsigned locals;  // Locals of the function being written, `c<fn>_<i>`
+} Gen;
+
+/**
+ * @brief Next pseudo random number.
+ * @param gen
+ * @param bound Exclusive upper bound, non-zero.
+ * @return
+ */
+static unsigned pick(Gen *gen, unsigned bound) {
+    uint32_t x = gen->rand;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    gen->rand = x;
+    return x % bound;
+}
+
+/**
+ * @brief Writes formatted source.
+ * @param gen
+ * @param fmt
+ */
+static void emit(Gen *gen, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void emit(Gen *gen, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int n = vfprintf(gen->out, fmt, args);
+    va_end(args);
+
+    if (n > 0) gen->written += n;
+}
+
+/**
+ * @brief Writes an int valued name or literal visible in the current function.
+ * @param gen
+ */
+static void operand(Gen *gen) {
+    switch (pick(gen, 4)) {
+    case 0:  emit(gen, "a%u", gen->fn); break;
+    case 1:  emit(gen, "b%u", gen->fn); break;
+    case 2:  emit(gen, "%u", pick(gen, 1000)); break;
+    default:
+        if (gen->locals) {
+            emit(gen, "c%u_%u", gen->fn, pick(gen, gen->locals));
+        } else {
+            emit(gen, "a%u", gen->fn);
+        }
+        break;
+    }
+}
+
+/**
+ * @brief Writes calls to earlier functions, nested `depth` deep through their
+ * first argument.
+ * @param gen
+ * @param depth
+ */
+static void call(Gen *gen, unsigned depth) {
+    if (depth == 0 || gen->funcs == 0) {
+        operand(gen);
+        return;
+    }
+
+    emit(gen, "f%u(", pick(gen, gen->funcs));
+    call(gen, depth - 1);
+    emit(gen, ", ");
+    operand(gen);
+    emit(gen, ")");
+}
+
+/**
+ * @brief Writes a chain of one to four terms joined by arithmetic operators.
+ * @param gen
+ */
+static void expression(Gen *gen) {
+    static const char *ops[] = {" + ", " - ", " * "};
+
+    unsigned terms = 1 + pick(gen, 4);
+    for (unsigned i = 0; i < terms; i++) {
+        if (i) emit(gen, "%s", ops[pick(gen, 3)]);
+        if (pick(gen, 8) == 0) {
+            call(gen, 1);
+        } else {
+            operand(gen);
+        }
+    }
+}
+
+/**
+ * @brief Writes a comment of `count` random words.
+ * @param gen
+ * @param count
+ * @param block Block comment instead of a line comment.
+ */
+static void comment(Gen *gen, unsigned count, int block) {
+    emit(gen, block ? "/*" : "//");
+    for (unsigned i = 0; i < count; i++) {
+        emit(gen, " %s", words[pick(gen, sizeof(words) / sizeof(words[0]))]);
+        if (block && i % 10 == 9) emit(gen, "\n  ");
+    }
+    emit(gen, block ? " */\n" : "\n");
+}
+
+/**
+ * @brief Opens a function, the next one to be written.
+ * @param gen
+ */
+static void open_func(Gen *gen) {
+    gen->fn     = gen->funcs;
+    gen->locals = 0;
+    emit(gen, "int f%u(int a%u, int b%u) {\n", gen->fn, gen->fn, gen->fn);
+}
+
+/**
+ * @brief Returns from and closes the function being written. It can be
+ * called from the next one on.
+ * @param gen
+ */
+static void close_func(Gen *gen) {
+    emit(gen, "    return ");
+    expression(gen);
+    emit(gen, ";\n}\n");
+    gen->funcs++;
+}
+
+/**
+ * @brief Writes a local variable, now and then followed by a nested block.
+ * @param gen
+ * @param note Adds a trailing line comment.
+ */
+static void statement(Gen *gen, int note) {
+    unsigned local = gen->locals;
+
+    emit(gen, "    int c%u_%u = ", gen->fn, local);
+    expression(gen);
+    emit(gen, ";");
+    if (note) {
+        emit(gen, " ");
+        comment(gen, 3 + pick(gen, 6), 0);
+    } else {
+        emit(gen, "\n");
+    }
+    gen->locals++;
+
+    if (pick(gen, 16) == 0) {
+        emit(gen, "    { int d%u_%u = c%u_%u; ", gen->fn, local, gen->fn, local);
+        emit(gen, "d%u_%u = d%u_%u + 1; }\n", gen->fn, local, gen->fn, local);
+    }
+}
+
+/**
+ * @brief Writes a small function.
+ * @param gen
+ * @param note Comments every statement.
+ */
+static void small_func(Gen *gen, int note) {
+    open_func(gen);
+    for (unsigned n = 2 + pick(gen, 5); n > 0; n--) statement(gen, note);
+    close_func(gen);
+}
+
+/**
+ * @brief Writes a function returning calls nested `spec->depth` deep.
+ * @param gen
+ */
+static void nested_func(Gen *gen) {
+    if (gen->funcs == 0) small_func(gen, 0); // Something to call
+
+    open_func(gen);
+    emit(gen, "    int c%u_0 = ", gen->fn);
+    call(gen, gen->spec->depth);
+    emit(gen, ";\n");
+    gen->locals++;
+    close_func(gen);
+}
+
+/**
+ * @brief Writes a function with a body of `count` statements, or up to the
+ * corpus size if `count` is 0.
+ * @param gen
+ * @param count
+ */
+static void block_func(Gen *gen, unsigned count) {
+    open_func(gen);
+    for (unsigned n = 0; count ? n < count : gen->written < gen->spec->size; n++) {
+        statement(gen, 0);
+    }
+    close_func(gen);
+}
+
+/**
+ * @brief Writes a function whose locals have long random names.
+ * @param gen
+ */
+static void idents_func(Gen *gen) {
+    unsigned len = gen->spec->ident < MAX_IDENT ? gen->spec->ident : MAX_IDENT;
+    char prev[MAX_IDENT + 16];
+    char name[MAX_IDENT + 16];
+
+    open_func(gen);
+    snprintf(prev, sizeof(prev), "a%u", gen->fn);
+
+    for (unsigned n = 2 + pick(gen, 5); n > 0; n--) {
+        for (unsigned i = 0; i < len; i++) {
+            name[i] = (i % 8 == 7) ? '_' : "abcdefghijklmnopqrstuvwxyz"[pick(gen, 26)];
+        }
+        snprintf(&name[len], sizeof(name) - len, "%u_%u", gen->fn, n); // Keeps names unique
+
+        emit(gen, "    int %s = %s + b%u * %u;\n", name, prev, gen->fn, pick(gen, 100));
+        memcpy(prev, name, sizeof(name));
+    }
+
+    emit(gen, "    return %s;\n}\n", prev);
+    gen->funcs++;
+}
+
+/**
+ * @brief Writes one top level declaration, or several, of `shape`.
+ * @param gen
+ * @param shape
+ */
+static void declaration(Gen *gen, Shape shape) {
+    switch (shape) {
+    case SHAPE_NESTED: nested_func(gen); break;
+    case SHAPE_BLOCK:  block_func(gen, 0); break;
+    case SHAPE_IDENTS: idents_func(gen); break;
+    case SHAPE_COMMENTS:
+        for (unsigned n = 1 + pick(gen, 4); n > 0; n--) comment(gen, 4 + pick(gen, 12), 0);
+        comment(gen, 20 + pick(gen, 60), 1);
+        small_func(gen, 1);
+        break;
+    case SHAPE_MIXED:
+        switch (pick(gen, 6)) {
+        case 0:  emit(gen, "int g%u = %u + 2 * 3;\n", gen->globals++, pick(gen, 100)); break;
+        case 1:  block_func(gen, 1 + pick(gen, MIXED_BLOCK)); break;
+        case 2:  nested_func(gen); break;
+        case 3:  declaration(gen, SHAPE_COMMENTS); break;
+        case 4:  idents_func(gen); break;
+        default: small_func(gen, 0); break;
+        }
+        break;
+    default: small_func(gen, 0); break;
+    }
+}
+
+size_t write_corpus(const CorpusSpec *spec, FILE *out) {
+    Gen gen = {.spec = spec, .out = out, .rand = spec->seed * 2654435761u + 1};
+    if (!gen.rand) gen.rand = 1;
+
+    while (gen.written < spec->size) {
+        declaration(&gen, spec->shape);
+    }
+    return gen.written;
+}
+
+const char *shape_str(Shape shape) {
+    return shape < SHAPE_COUNT ? shape_names[shape] : "unknown";
+}
+
+Shape shape_from_str(const char *name) {
+    for (int i = 0; i < SHAPE_COUNT; i++) {
+        if (strcmp(shape_names[i], name) == 0) return i;
+    }
+    return SHAPE_COUNT;
+}
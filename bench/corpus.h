@@ -0,0 +1,49 @@
+#ifndef _CORPUS_H
+#define _CORPUS_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+// Shape of a synthetic corpus, what most of its source looks like
+typedef enum {
+    SHAPE_MIXED,    // Every other shape, picked at random per declaration
+    SHAPE_NESTED,   // Calls nested `depth` deep as arguments of each other
+    SHAPE_BLOCK,    // One function whose body is a single huge block
+    SHAPE_FUNCS,    // Many small functions calling earlier ones
+    SHAPE_COMMENTS, // Small functions buried in line and block comments
+    SHAPE_IDENTS,   // Variables with `ident` character long names
+    SHAPE_COUNT,
+} Shape;
+
+// What to generate. The same spec always generates the same corpus.
+typedef struct {
+    Shape shape;
+    size_t size;    // Bytes to generate, the last declaration may run past it
+    unsigned seed;  // Random choices, any value
+    unsigned depth; // Call nesting of `SHAPE_NESTED`
+    unsigned ident; // Identifier length of `SHAPE_IDENTS`
+} CorpusSpec;
+
+/**
+ * @brief Writes a corpus that compiles without errors.
+ * @param spec
+ * @param out
+ * @return Bytes written.
+ */
+size_t write_corpus(const CorpusSpec *spec, FILE *out);
+
+/**
+ * @brief Display name of a shape.
+ * @param shape
+ * @return
+ */
+const char *shape_str(Shape shape);
+
+/**
+ * @brief Looks up a shape by its display name.
+ * @param name
+ * @return SHAPE_COUNT if there is no such shape.
+ */
+Shape shape_from_str(const char *name);
+
+#endif
@@ -1,58 +1,431 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
 
-#include "src/utils.h"
+#include "src/context.h"
 #include "src/lexer.h"
 #include "src/parser.h"
-#include "src/symbol.h"
+#include "src/flat.h"
+#include "src/analyzer.h"
+#include "src/lower.h"
+#include "src/fold.h"
+#include "src/timing.h"
 
-int main() {
-    clock_t stime = clock();
+#define MAX_JOBS 256 // Most worker threads, `-j` is clamped to it
 
-    const char *src = "../../source.cx";
-    TokenList *list = scan(src);
+// Format of the `-ftime-report` output
+typedef enum {
+    REPORT_NONE, // Not timing
+    REPORT_TEXT, // Table, `-ftime-report` or `-ftime-report=text`
+    REPORT_JSON, // `-ftime-report=json`
+} ReportFormat;
 
-    // print_tlist(list); // Print parsed tokens
+// What is done with the IR of every unit, or-ed together
+typedef enum {
+    DUMP_IR   = 1, // `-dump-ir`, print it to the trace
+    VERIFY_IR = 2, // `-verify-ir`, check it with `verify_ir` before and after folding
+} IrAction;
+
+// One input file and the outcome of compiling it
+typedef struct {
+    const char *path;
+    CompilerContext *ctx; // NULL if it could not be created
+    char *trace;          // Buffered analyzer output, NULL when traced directly
+    size_t tsize;
+    TimeReport timing; // Cost of each phase, when timing
+    bool done;
+} Unit;
 
-    Parser *parser = make_parser(list);
-    Node *root     = parse_program(parser);
+// Files shared by the workers, each one takes the next file nobody has taken
+typedef struct {
+    Unit *units;
+    int count;
+    bool buffered;        // Trace into memory so output follows input order
+    bool timed;           // Collect a time report of every unit
+    int workers;          // Lexer and analyzer threads of every unit
+    unsigned ir;          // `IrAction` flags of every unit
+    atomic_int next;      // Next file to take
+    pthread_mutex_t lock; // Guards `done` of every unit
+    pthread_cond_t cond;  // Signaled when a unit is done
+} Queue;
 
-    // print_ast(root, 0); // Prints AST
+/**
+ * @brief Monotonic wall clock in milliseconds.
+ * @return
+ */
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
 
-    // SymbolTable *table = make_symtbl();
-    // init_symtbl(table);
+/**
+ * @brief Starts measuring `phase` when a report is being collected.
+ * @param rep NULL when not timing.
+ * @param phase
+ */
+static void begin(TimeReport *rep, Phase phase) {
+    if (rep) start_phase(rep, phase);
+}
 
-    // Symbol *sint = make_symbol("int", SG_TYPE, SA_REF, SF_EXTERNAL, 1);
-    // add_symbol(table, sint);
+/**
+ * @brief Ends the phase started by `begin`.
+ * @param rep NULL when not timing.
+ * @param items
+ */
+static void finish(TimeReport *rep, size_t items) {
+    if (rep) end_phase(rep, items);
+}
 
-    // Symbol *sfloat = make_symbol("float", SG_TYPE, SA_REF, SF_EXTERNAL, 1);
-    // add_symbol(table, sfloat);
+/**
+ * @brief Counts the nodes the parser allocated.
+ * @param prs
+ * @return
+ */
+static size_t ast_nodes(const Parser *prs) {
+    ParseStats stats = parse_stats(prs);
 
-    // resprog(node, table);
+    size_t nodes = 0;
+    for (int i = 0; i <= NODE_TYPE; i++) nodes += stats.nodes[i];
+    return nodes;
+}
 
-    // if (table) {
-    //     for (unsigned i = 0; i < table->size; i++) {
-    //         SymbolNode *node = table->buckets[i];
-    //         while (node) {
-    //             Symbol *symbol = node->symbol;
-    //             printf(
-    //                 "Symbol: %s, Group: %d, Action: %d, Modifiers: %u, Scope: %d\n",
-    //                 symbol->name, symbol->group, symbol->action, symbol->modspec, symbol->scope
-    //             );
-    //             node = node->next; // Move to the next symbol in the bucket
-    //         }
-    //     }
-    // }
+/**
+ * @brief Counts the nodes of a flat AST.
+ * @param ast
+ * @return
+ */
+static size_t flat_nodes(const FlatAst *ast) {
+    return (size_t)ast->type_count + ast->decl_count + ast->block_count + ast->stmt_count +
+           ast->expr_count;
+}
 
-    // purge_symtbl(table);
+/**
+ * @brief Compiles `path` in `ctx`, stopping at the first phase that fails.
+ * @param ctx
+ * @param path
+ * @param rep Collects the cost of every phase, NULL when not timing. The
+ * tokens are then scanned up front instead of streamed, so scanning and
+ * parsing are measured apart.
+ * @param workers Threads the lexer and the analyzer may use. Sources of at
+ * least `MIN_CHUNK` bytes are then scanned up front in chunks.
+ * @param ir `IrAction` flags.
+ * @return
+ */
+static CompErr compile(
+    CompilerContext *ctx, const char *path, TimeReport *rep, int workers, unsigned ir
+) {
+    begin(rep, PHASE_LOAD);
+    Lexer *lexer = make_lexer(ctx, path);
+    finish(rep, lexer ? lexer->size : 0);
 
-    clock_t etime = clock();
-    double ttime  = ((double)(etime - stime)) / CLOCKS_PER_SEC * 1000;
-    printf("Total time: %f ms\n", ttime);
+    TokList *list = NULL;
+    if (lexer && workers > 1 && lexer->size >= MIN_CHUNK) {
+        begin(rep, PHASE_SCAN);
+        list = scan_parallel(lexer, workers);
+        finish(rep, list ? list->count : 0);
+    } else if (lexer && rep) {
+        begin(rep, PHASE_SCAN);
+        list = scan(lexer);
+        finish(rep, list ? list->count : 0);
+    } else if (lexer) {
+        list = scan_stream(lexer); // Tokens are pulled by the parser
+    }
+
+    Parser *parser = list ? make_parser(ctx, list) : NULL;
+    Program *prog  = NULL;
+    if (parser) {
+        begin(rep, PHASE_PARSE);
+        prog = parse_program(parser);
+        finish(rep, ast_nodes(parser));
+    }
+
+    // print_tlist(list); // Print parsed tokens
+    // print_ast((Node *)prog); // Prints AST
+
+    FlatAst *ast = NULL;
+    if (prog) {
+        begin(rep, PHASE_FLATTEN);
+        ast = flatten_program(ctx, prog);
+        finish(rep, ast ? flat_nodes(ast) : 0);
+    }
+
+    Analyzer *anz = ast ? make_analyzer(ctx) : NULL;
+    if (anz) {
+        begin(rep, PHASE_RESOLVE);
+        resolve_parallel(anz, ast, workers);
+        finish(rep, flat_nodes(ast));
+    }
+
+    IrModule *mod = NULL;
+    if (anz && ctx->err == CERR_OK) {
+        begin(rep, PHASE_LOWER);
+        mod = lower_program(ctx, ast);
+        finish(rep, flat_nodes(ast));
+    }
+
+    // Folding trusts its input, so lowered IR that fails to verify is not folded
+    bool valid    = mod && (!(ir & VERIFY_IR) || verify_ir(ctx, mod));
+    size_t folded = 0;
+    if (valid) {
+        size_t insts = ir_inst_count(mod);
+        begin(rep, PHASE_FOLD);
+        folded = fold_module(ctx, mod);
+        finish(rep, insts);
+        if (rep) prune_items(rep, PHASE_FOLD, folded);
+    }
+
+    if (valid && (ir & VERIFY_IR)) verify_ir(ctx, mod);
+    if (mod && (ir & DUMP_IR) && ctx->trace) {
+        fprintf(ctx->trace, "; %zu instructions folded away\n", folded);
+        print_ir(mod, ctx->trace);
+    }
 
     // cleanup
+    purge_module(mod);
+    purge_analyzer(anz);
+    purge_flat(ast);
     purge_parser(parser);
-    // purge_tlist(list);
+    purge_toklist(list);
+    purge_lexer(lexer);
+
+    return ctx->err;
+}
+
+/**
+ * @brief Compiles one unit in a context of its own. Only the diagnostics, the
+ * trace and the time report outlive the compilation, the atoms and types are
+ * freed right away.
+ * @param unit
+ * @param buffered Collects the trace in memory instead of writing it to stdout.
+ * @param timed Measures every phase into `unit->timing`.
+ * @param workers Threads the lexer and the analyzer may use.
+ * @param ir `IrAction` flags.
+ */
+static void compile_unit(Unit *unit, bool buffered, bool timed, int workers, unsigned ir) {
+    unit->ctx = make_context();
+    if (!unit->ctx) return;
+
+    FILE *trace = buffered ? open_memstream(&unit->trace, &unit->tsize) : stdout;
+    if (!trace) {
+        fail_context(unit->ctx, CERR_NOMEM, "failed to buffer output of '%s'", unit->path);
+        return;
+    }
+
+    unit->ctx->trace = trace;
+    compile(unit->ctx, unit->path, timed ? &unit->timing : NULL, workers, ir);
+    unit->ctx->trace = NULL;
+
+    if (buffered) fclose(trace);
+    purge_interner(&unit->ctx->interner);
+    purge_types(&unit->ctx->types);
+}
+
+/**
+ * @brief Worker thread, compiles files from the queue until none are left.
+ * @param arg Queue.
+ * @return
+ */
+static void *work(void *arg) {
+    Queue *queue = arg;
+
+    for (;;) {
+        int i = atomic_fetch_add(&queue->next, 1);
+        if (i >= queue->count) break;
+
+        compile_unit(
+            &queue->units[i], queue->buffered, queue->timed, queue->workers, queue->ir
+        );
+
+        pthread_mutex_lock(&queue->lock);
+        queue->units[i].done = true;
+        pthread_cond_broadcast(&queue->cond);
+        pthread_mutex_unlock(&queue->lock);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Prints the trace and diagnostics of a compiled unit.
+ * @param unit
+ * @param named Prefixes the report with the file name, for more than one file.
+ * @return Error of the unit.
+ */
+static CompErr report_unit(const Unit *unit, bool named) {
+    if (!unit->ctx) {
+        fprintf(stderr, "Error: context allocation failed for '%s'\n", unit->path);
+        return CERR_NOMEM;
+    }
+
+    if (unit->trace) fwrite(unit->trace, 1, unit->tsize, stdout);
+    fflush(stdout);
+
+    CompErr err = unit->ctx->err;
+    if (named && (err != CERR_OK || unit->ctx->diags.count)) {
+        fprintf(stderr, "In '%s':\n", unit->path);
+    }
+    print_diags(&unit->ctx->diags, stderr);
+
+    if (err == CERR_SEMANTIC) {
+        fprintf(stderr, "Compilation failed with semantic errors\n");
+    } else if (err == CERR_OK && !named) {
+        printf("Compilation successful.\n");
+    }
+
+    return err;
+}
+
+/**
+ * @brief Parses the argument of `-j`.
+ * @param arg
+ * @return Number of jobs, 0 if `arg` is not a positive number.
+ */
+static int parse_jobs(const char *arg) {
+    char *end;
+    long jobs = strtol(arg, &end, 10);
+    if (!*arg || *end || jobs < 1) return 0;
+
+    return jobs > MAX_JOBS ? MAX_JOBS : (int)jobs;
+}
+
+/**
+ * @brief Parses the argument of `-ftime-report`.
+ * @param opt Option, starting with `-ftime-report`.
+ * @return REPORT_NONE if the format is unknown.
+ */
+static ReportFormat parse_report(const char *opt) {
+    const char *fmt = opt + strlen("-ftime-report");
+    if (!*fmt || strcmp(fmt, "=text") == 0) return REPORT_TEXT;
+    if (strcmp(fmt, "=json") == 0) return REPORT_JSON;
+
+    return REPORT_NONE;
+}
+
+/**
+ * Compiles every file given on the command line, up to `-j` files at a time,
+ * one online core each by default. Every file gets a context of its own, so
+ * the compilations share nothing. Jobs left over when there are fewer files
+ * scan large sources and analyze function bodies in parallel. Reports are
+ * printed in command line order as soon as every file before them is done,
+ * whatever order they finish in.
+ * `-ftime-report` prints the cost of each phase, summed over every file, to
+ * stderr at the end. `-dump-ir` prints the folded IR of every file that compiled
+ * after its trace, `-verify-ir` checks it before and after folding.
+ *
+ * usage: corx [-j N] [-ftime-report[=text|json]] [-dump-ir] [-verify-ir] <file>...
+ */
+int main(int argc, char **argv) {
+    double stime = now();
+
+    int jobs            = 0;
+    int count           = 0;
+    ReportFormat format = REPORT_NONE;
+    unsigned ir         = 0;
+    Unit *units         = calloc(argc, sizeof(Unit));
+    if (!units) {
+        fprintf(stderr, "Error: out of memory\n");
+        return 1;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "-j", 2) == 0) {
+            const char *arg = argv[i][2] ? &argv[i][2] : (i + 1 < argc ? argv[++i] : "");
+            if (!(jobs = parse_jobs(arg))) {
+                fprintf(stderr, "Error: invalid number of jobs '%s'\n", arg);
+                free(units);
+                return 1;
+            }
+        } else if (strncmp(argv[i], "-ftime-report", 13) == 0) {
+            if (!(format = parse_report(argv[i]))) {
+                fprintf(stderr, "Error: unknown time report format '%s'\n", argv[i]);
+                free(units);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-dump-ir") == 0) {
+            ir |= DUMP_IR;
+        } else if (strcmp(argv[i], "-verify-ir") == 0) {
+            ir |= VERIFY_IR;
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "Error: unknown option '%s'\n", argv[i]);
+            free(units);
+            return 1;
+        } else {
+            units[count++].path = argv[i];
+        }
+    }
+
+    if (!count) {
+        fprintf(
+            stderr, "usage: %s [-j N] [-ftime-report[=text|json]] [-dump-ir] [-verify-ir] "
+                    "<file>...\n",
+            argv[0]
+        );
+        free(units);
+        return 1;
+    }
+
+    if (!jobs) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        jobs       = cores < 1 ? 1 : cores > MAX_JOBS ? MAX_JOBS : (int)cores;
+    }
+    int workers = jobs / count > 1 ? jobs / count : 1;
+    if (jobs > count) jobs = count;
+
+    Queue queue = {
+        .units    = units,
+        .count    = count,
+        .buffered = count > 1,
+        .timed    = format != REPORT_NONE,
+        .workers  = workers,
+        .ir       = ir,
+    };
+    atomic_init(&queue.next, 0);
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.cond, NULL);
+
+    pthread_t threads[MAX_JOBS];
+    int started = 0;
+    while (started < jobs && pthread_create(&threads[started], NULL, work, &queue) == 0) {
+        started++;
+    }
+    if (!started) work(&queue); // No threads at all, compile everything here
+
+    int failed        = 0;
+    TimeReport timing = {0};
+    for (int i = 0; i < count; i++) {
+        pthread_mutex_lock(&queue.lock);
+        while (!units[i].done) pthread_cond_wait(&queue.cond, &queue.lock);
+        pthread_mutex_unlock(&queue.lock);
+
+        if (report_unit(&units[i], count > 1) != CERR_OK) failed++;
+        merge_report(&timing, &units[i].timing);
+
+        purge_context(units[i].ctx);
+        free(units[i].trace);
+    }
+
+    for (int k = 0; k < started; k++) pthread_join(threads[k], NULL);
+
+    pthread_cond_destroy(&queue.cond);
+    pthread_mutex_destroy(&queue.lock);
+    free(units);
+
+    if (count > 1) printf("Compiled %d files, %d failed.\n", count, failed);
+
+    if (format == REPORT_TEXT) {
+        print_report(&timing, stderr);
+    } else if (format == REPORT_JSON) {
+        print_report_json(&timing, stderr);
+    }
+
+    double ttime = now() - stime;
+    printf("Total time: %f ms\n", ttime);
 
-    return 0;
+    return failed ? 1 : 0;
 }
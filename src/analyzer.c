@@ -1,42 +1,56 @@
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <string.h>
 
-#include "utils.h"
+#include "memstat.h"
+#include "timing.h"
 #include "analyzer.h"
 
+#define MAX_WORKERS 64   // Most threads of `resolve_parallel`
+#define MIN_STMTS   1024 // Programs with fewer statements are resolved serially
+
 /* Function prototypes */
-void resolve_program(Analyzer *anz, Node *node);
-
-static void resolve_node(Analyzer *anz, Node *node);
-static void resolve_block(Analyzer *anz, BlockNode *block);
-static void resolve_func(Analyzer *anz, FuncNode *fn);
-static void resolve_param(Analyzer *anz, VarNode *param);
-static void resolve_var_decl(Analyzer *anz, VarNode *var);
-static void resolve_for(Analyzer *anz, StmtNode *stmt);
-static void resolve_statement(Analyzer *anz, StmtNode *stmt);
-static void resolve_assignment(Analyzer *anz, StmtNode *stmt);
-static void resolve_if(Analyzer *anz, StmtNode *stmt);
-static void resolve_while(Analyzer *anz, StmtNode *stmt);
-static void resolve_do_while(Analyzer *anz, StmtNode *stmt);
-static void resolve_return(Analyzer *anz, StmtNode *stmt);
-
-static Symbol *resolve_expression(Analyzer *anz, Node *node);
-static Symbol *resolve_binary_expr(Analyzer *anz, ExprNode *expr);
-static Symbol *resolve_expr_node(Analyzer *anz, ExprNode *expr);
-static Symbol *resolve_var_expr(Analyzer *anz, ExprNode *expr);
-static Symbol *resolve_unary_expr(Analyzer *anz, ExprNode *expr);
-static Symbol *resolve_call_expr(Analyzer *anz, ExprNode *expr);
-static Symbol *resolve_conditional_expr(Analyzer *anz, ExprNode *expr);
+CompErr resolve_program(Analyzer *anz, const FlatAst *ast);
+CompErr resolve_parallel(Analyzer *anz, const FlatAst *ast, int workers);
+
+static void resolve_item(Analyzer *anz, NodeRef item);
+static void resolve_decl(Analyzer *anz, const FlatDecl *decl);
+static void resolve_block(Analyzer *anz, const FlatBlock *block);
+static void resolve_func(Analyzer *anz, const FlatDecl *fn);
+static Symbol *declare_func(Analyzer *anz, const FlatDecl *fn);
+static void sign_func(Analyzer *anz, Symbol *fsym, const FlatDecl *fn);
+static void resolve_body(Analyzer *anz, const FlatDecl *fn, Symbol *fsym);
+static void resolve_param(Analyzer *anz, const FlatDecl *param);
+static void resolve_var_decl(Analyzer *anz, const FlatDecl *var);
+static void resolve_for(Analyzer *anz, const FlatStmt *stmt);
+static void resolve_statement(Analyzer *anz, const FlatStmt *stmt);
+static void resolve_if(Analyzer *anz, const FlatStmt *stmt);
+static void resolve_while(Analyzer *anz, const FlatStmt *stmt);
+static void resolve_do_while(Analyzer *anz, const FlatStmt *stmt);
+static void resolve_return(Analyzer *anz, const FlatStmt *stmt);
+
+static Symbol *builtin_type(Analyzer *anz, TypeKind kind);
+static Symbol *resolve_type(Analyzer *anz, const FlatType *type);
+static Symbol *resolve_expression(Analyzer *anz, const FlatExpr *expr);
+static Symbol *resolve_const_expr(Analyzer *anz, const FlatExpr *expr);
+static Symbol *resolve_binary_expr(Analyzer *anz, const FlatExpr *expr);
+static Symbol *resolve_var_expr(Analyzer *anz, const FlatExpr *expr);
+static Symbol *resolve_unary_expr(Analyzer *anz, const FlatExpr *expr);
+static Symbol *resolve_assign_expr(Analyzer *anz, const FlatExpr *expr);
+static Symbol *resolve_call_expr(Analyzer *anz, const FlatExpr *expr);
+static Symbol *resolve_conditional_expr(Analyzer *anz, const FlatExpr *expr);
 
 static bool is_same_type(Symbol *t1, Symbol *t2);
 static bool is_arithmetic(Symbol *type);
+static bool is_integer(Symbol *type);
 static bool is_pointer(Symbol *type);
 static bool is_boolean(Symbol *type);
 static bool is_comparable(Symbol *t1, Symbol *t2);
 static bool is_scalar(Symbol *type);
 static bool is_compatible(Symbol *t1, Symbol *t2);
 
+static Symbol *lookup(Analyzer *anz, const Atom *name, int scope);
 static Symbol *get_bool_type(Analyzer *type);
 static Symbol *numeric_promotion(Analyzer *anz, Symbol *s1, Symbol *s2);
 
@@ -44,27 +58,77 @@ static Symbol *numeric_promotion(Analyzer *anz, Symbol *s1, Symbol *s2);
  * Helper Functions
  *********************************************/
 
+// Flat AST node lookups
+static const FlatType *type_at(Analyzer *anz, NodeRef ref) {
+    return &anz->ast->types[ref];
+}
+
+static const FlatDecl *decl_at(Analyzer *anz, NodeRef ref) {
+    return &anz->ast->decls[ref];
+}
+
+static const FlatBlock *block_at(Analyzer *anz, NodeRef ref) {
+    return &anz->ast->blocks[ref];
+}
+
+static const FlatStmt *stmt_at(Analyzer *anz, NodeRef ref) {
+    return &anz->ast->stmts[ref];
+}
+
+static const FlatExpr *expr_at(Analyzer *anz, NodeRef ref) {
+    return &anz->ast->exprs[ref];
+}
+
+/**
+ * @brief Searches for the symbol a name refers to, the innermost declaration
+ * up to `scope`.
+ *
+ * A body resolved in parallel searches it's own table of locals first, then
+ * the shared top level symbols, of which only those declared up to the
+ * function being resolved are visible.
+ *
+ * @param anz Pointer to the analyzer.
+ * @param name The name.
+ * @param scope The starting scope level.
+ * @return Pointer to the found symbol or NULL if not found.
+ */
+static Symbol *lookup(Analyzer *anz, const Atom *name, int scope) {
+    Symbol *sym = search_symbol(anz->symtab, name, scope);
+    if (sym || !anz->globals) return sym;
+
+    sym = search_symbol(anz->globals, name, 0);
+    return sym && sym->order <= anz->order ? sym : NULL;
+}
+
 /**
  * @brief Checks if two symbols have the same type.
  *
  * @param a First symbol.
  * @param b Second symbol.
- * @return true if both are of type SG_TYPE and their names match.
+ * @return true if both are the same type symbol.
  */
 static bool is_same_type(Symbol *t1, Symbol *t2) {
-    return (t1->group == SG_TYPE && t2->group == SG_TYPE) && (strcmp(t1->name, t2->name) == 0);
+    return t1 == t2 && t1->group == SG_TYPE;
 }
 
 /**
  * @brief Determines if the given symbol represents an arithmetic type.
  *
  * @param type Pointer to the symbol.
- * @return true if the symbol's name is "int", "float", or "char".
+ * @return true if the symbol is the "int", "float", or "char" type.
  */
 static bool is_arithmetic(Symbol *type) {
-    return type->group == SG_TYPE &&
-           ((strcmp(type->name, "int") == 0 || strcmp(type->name, "float") == 0 ||
-             strcmp(type->name, "char") == 0));
+    return type->builtin == BT_INT || type->builtin == BT_FLOAT || type->builtin == BT_CHAR;
+}
+
+/**
+ * @brief Determines if the given symbol represents an integer type.
+ *
+ * @param type Pointer to the symbol.
+ * @return true if the symbol is the "int" or "char" type.
+ */
+static bool is_integer(Symbol *type) {
+    return type->builtin == BT_INT || type->builtin == BT_CHAR;
 }
 
 /**
@@ -81,10 +145,10 @@ static bool is_pointer(Symbol *type) {
  * @brief Determines if the given symbol represents a boolean type.
  *
  * @param type Pointer to the symbol.
- * @return true if the symbol's name is "bool".
+ * @return true if the symbol is the "bool" type.
  */
 static bool is_boolean(Symbol *type) {
-    return type->group == SG_TYPE && strcmp(type->name, "bool") == 0;
+    return type->builtin == BT_BOOL;
 }
 
 /**
@@ -107,7 +171,7 @@ static bool is_comparable(Symbol *t1, Symbol *t2) {
  * @return Pointer to the symbol for "bool".
  */
 static Symbol *get_bool_type(Analyzer *anz) {
-    return search_symbol(anz->symtab, "bool", 0);
+    return anz->builtins[BT_BOOL];
 }
 
 /**
@@ -121,11 +185,11 @@ static Symbol *get_bool_type(Analyzer *anz) {
  * @return Pointer to the promoted type symbol.
  */
 static Symbol *numeric_promotion(Analyzer *a, Symbol *s1, Symbol *s2) {
-    if (strcmp(s1->name, "float") == 0 || strcmp(s2->name, "float") == 0) {
-        return search_symbol(a->symtab, "float", 0);
+    if (s1->builtin == BT_FLOAT || s2->builtin == BT_FLOAT) {
+        return a->builtins[BT_FLOAT];
     }
 
-    return search_symbol(a->symtab, "int", 0);
+    return a->builtins[BT_INT];
 }
 
 /**
@@ -157,130 +221,155 @@ static bool is_compatible(Symbol *s1, Symbol *s2) {
 /**
  * @brief Checks for a variable redeclaration in the current scope.
  *
- * Exits the program if a duplicate is found.
+ * Reports an error if a duplicate is found.
  *
- * @param table Pointer to the symbol table.
+ * @param anz Pointer to the analyzer.
  * @param name The variable name.
  * @param line Source code line number.
+ * @return false if the name is already declared.
  */
-void check_vardecl(SymTab *table, const char *name, int line) {
-    Symbol *sym = search_symbol(table, name, table->scope);
+bool check_vardecl(Analyzer *anz, const Atom *name, int line) {
+    Symbol *sym = search_scope(anz->symtab, name);
     if (sym) {
-        fprintf(stderr, "Error (line %d): Redeclaration of '%s'\n", line, name);
-        exit(1);
+        report_error(anz->ctx, line, 0, "Redeclaration of '%s'", name->str);
+        anz->err = true;
+        return false;
     }
+    return true;
 }
 
 /**
  * @brief Checks that the assignment between two symbols is valid.
  *
- * Exits the program if the types are not the same.
+ * Reports an error if the types are not the same.
  *
- * @param table Pointer to the symbol table.
+ * @param anz Pointer to the analyzer.
  * @param lhs Left-hand side symbol.
  * @param rhs Right-hand side symbol.
  * @param line Source code line number.
+ * @return false if the types differ.
  */
-void is_assignable(SymTab *table, Symbol *lhs, Symbol *rhs, int line) {
+bool is_assignable(Analyzer *anz, Symbol *lhs, Symbol *rhs, int line) {
     if (!is_same_type(lhs->type, rhs->type)) {
-        fprintf(
-            stderr, "Error (line %d): Cannot assign %s to %s\n", line, rhs->type->name,
-            lhs->type->name
+        report_error(
+            anz->ctx, line, 0, "Cannot assign %s to %s", rhs->type->name->str, lhs->type->name->str
         );
-        exit(1);
+        anz->err = true;
+        return false;
     }
+    return true;
 }
 
 /**
- * @brief Searches for a variable in the symbol table using unique naming.
+ * @brief Searches for the variable or parameter a name refers to.
  *
- * For each scope from the given scope down to 0, constructs a unique name (e.g., a.0, a.1)
- * and searches for the corresponding symbol.
+ * The innermost declaration of the name up to the given scope shadows the
+ * others, a function or type of that name is not a variable.
  *
  * @param table Pointer to the symbol table.
- * @param name The base variable name.
+ * @param name The variable name.
  * @param scope The starting scope level.
  * @return Pointer to the found symbol or NULL if not found.
  */
-Symbol *resolve_variable(SymTab *table, char *name, int scope) {
-    for (int s = scope; s >= 0; s--) {
-        char *uname = sym_uname(name, s);
-        Symbol *sym = search_symbol(table, uname, s);
-        free(uname);
-        if (sym) return sym;
-    }
-    return NULL;
+Symbol *resolve_variable(SymTab *table, const Atom *name, int scope) {
+    Symbol *sym = search_symbol(table, name, scope);
+    return sym && (sym->group == SG_VAR || sym->group == SG_PARAM) ? sym : NULL;
 }
 
+/*********************************************
+ * Core Analyzer Functions
+ *********************************************/
+
 /**
- * @brief Enters a new scope.
- *
- * Increments the scope level in the symbol table.
+ * @brief Abandons the analysis, `resolve_program` returns `CERR_NOMEM`.
  *
- * @param table Pointer to the symbol table.
+ * @param anz Pointer to the analyzer.
  */
-void scope_enter(SymTab *table) {
-    table->scope++;
+static _Noreturn void out_of_memory(Analyzer *anz) {
+    fail_context(anz->ctx, CERR_NOMEM, "out of memory while analyzing");
+    longjmp(anz->fail, 1);
 }
 
 /**
- * @brief Exits the current scope.
- *
- * Removes all symbols declared in the current scope and decrements the scope level.
+ * @brief Creates a symbol and adds it to the symbol table.
  *
- * @param table Pointer to the symbol table.
+ * @param anz Pointer to the analyzer.
+ * @param name Symbol name.
+ * @param group Symbol group.
+ * @param scope Scope level.
+ * @param type Pointer to the type symbol.
+ * @return Pointer to the added symbol.
  */
-void scope_exit(SymTab *table) {
-    // TODO: Mark inactive if needed
-    table->scope--;
+static Symbol *declare(Analyzer *anz, const Atom *name, SymGrp group, int scope, Symbol *type) {
+    Symbol *sym = make_symbol(name, group, SA_DEC, 0, scope, type);
+    if (!sym) out_of_memory(anz);
+
+    sym->order = anz->order;
+    if (!add_symbol(anz->symtab, sym)) {
+        free(sym);
+        out_of_memory(anz);
+    }
+    return sym;
 }
 
-/*********************************************
- * Core Analyzer Functions
- *********************************************/
-
 /**
  * @brief Creates and initializes a new analyzer.
  *
  * Allocates memory for an Analyzer and initializes its symbol table.
  *
- * @return Pointer to the newly created Analyzer.
+ * @param ctx Context that receives semantic errors.
+ * @return Pointer to the newly created Analyzer, NULL if memory ran out.
  */
-Analyzer *make_analyzer() {
-    Analyzer *anz = malloc(sizeof(Analyzer));
-    if (!anz) errexit("make_analyzer allocation failed");
+Analyzer *make_analyzer(CompilerContext *ctx) {
+    Analyzer *anz = mem_calloc(1, sizeof(Analyzer));
+    if (!anz) {
+        fail_context(ctx, CERR_NOMEM, "analyzer allocation failed");
+        return NULL;
+    }
 
-    anz->symtab = make_symtab();
+    anz->ctx    = ctx;
+    anz->symtab = make_symtab(ctx);
+    anz->ast    = NULL;
     anz->line   = 0;
     anz->err    = false;
+    anz->sym    = NULL;
 
-    init_symtab(anz->symtab);
+    if (!anz->symtab || !init_symtab(anz->symtab, anz->builtins)) {
+        fail_context(ctx, CERR_NOMEM, "analyzer allocation failed");
+        purge_analyzer(anz);
+        return NULL;
+    }
     return anz;
 }
 
 /**
  * @brief Analyzes the entire program.
  *
- * Expects the root node to be of type NODE_PROGRAM and processes all child nodes.
+ * Processes every top-level declaration of the program.
  *
  * @param anz Pointer to the Analyzer.
- * @param node Pointer to the root node.
+ * @param ast Pointer to the flat AST of the program.
+ * @return `CERR_SEMANTIC` if errors were reported, `CERR_NOMEM` if memory ran out.
  */
-void resolve_program(Analyzer *anz, Node *node) {
-    if (node->type != NODE_PROGRAM) errexit("Expected program node");
+CompErr resolve_program(Analyzer *anz, const FlatAst *ast) {
+    if (setjmp(anz->fail)) return CERR_NOMEM;
 
-    ProgNode *prog = (ProgNode *)node;
-    for (int i = 0; i < prog->icount; i++) {
-        anz->line = prog->items[i]->line;
-        resolve_node(anz, prog->items[i]);
+    anz->ast = ast;
+
+    const NodeRef *decls = flat_items(ast, ast->program);
+    for (uint32_t i = 0; i < flat_count(ast, ast->program); i++) {
+        const FlatDecl *decl = decl_at(anz, decls[i]);
+        anz->line            = decl->line;
+        anz->order           = i + 1;
+        resolve_decl(anz, decl);
     }
 
+    if (anz->ctx->err == CERR_NOMEM) return CERR_NOMEM;
     if (anz->err) {
-        fprintf(stderr, "Compilation failed with semantic errors\n");
-        exit(1);
+        set_error(anz->ctx, CERR_SEMANTIC);
+        return CERR_SEMANTIC;
     }
-
-    printf("Compilation successful.\n");
+    return CERR_OK;
 }
 
 /*********************************************
@@ -288,23 +377,73 @@ void resolve_program(Analyzer *anz, Node *node) {
  *********************************************/
 
 /**
- * @brief Analyzes a generic AST node.
+ * @brief Analyzes a block item.
  *
- * Dispatches analysis based on the node type.
+ * Dispatches analysis based on the item's statement tag.
  *
  * @param anz Pointer to the Analyzer.
- * @param node Pointer to the node.
+ * @param item Declaration or `ITEM_STMT` tagged statement reference.
  */
-static void resolve_node(Analyzer *anz, Node *node) {
-    switch (node->type) {
-    case NODE_VAR_DECL:  resolve_var_decl(anz, (VarNode *)node); break;
-    case NODE_FUNC_DECL: resolve_func(anz, (FuncNode *)node); break;
-    case NODE_BLOCK:     resolve_block(anz, (BlockNode *)node); break;
-    case NODE_STATEMENT: resolve_statement(anz, (StmtNode *)node); break;
-    default:             fprintf(stderr, "Warning: Unhandled node type %d\n", node->type);
+static void resolve_item(Analyzer *anz, NodeRef item) {
+    if (item & ITEM_STMT) {
+        resolve_statement(anz, stmt_at(anz, item & ~ITEM_STMT));
+    } else {
+        resolve_decl(anz, decl_at(anz, item));
     }
 }
 
+/**
+ * @brief Analyzes a declaration.
+ *
+ * Dispatches to function or variable analysis based on the declared type.
+ *
+ * @param anz Pointer to the Analyzer.
+ * @param decl Pointer to the declaration node.
+ */
+static void resolve_decl(Analyzer *anz, const FlatDecl *decl) {
+    anz->line = decl->line;
+
+    if (type_at(anz, decl->type)->kind == TY_FUNC) {
+        resolve_func(anz, decl);
+    } else {
+        resolve_var_decl(anz, decl);
+    }
+}
+
+/**
+ * @brief Finds the builtin type symbol of a type kind.
+ *
+ * @param anz Pointer to the Analyzer.
+ * @param kind Type kind.
+ * @return Pointer to the type symbol, or NULL if the kind is not supported.
+ */
+static Symbol *builtin_type(Analyzer *anz, TypeKind kind) {
+    switch (kind) {
+    case TY_INT:    return anz->builtins[BT_INT];
+    case TY_FLOAT:  return anz->builtins[BT_FLOAT];
+    case TY_CHAR:   return anz->builtins[BT_CHAR];
+    case TY_STRING: return anz->builtins[BT_STRING];
+    case TY_VOID:   return anz->builtins[BT_VOID];
+    default:        return NULL;
+    }
+}
+
+/**
+ * @brief Resolves a declared type to its type symbol.
+ *
+ * @param anz Pointer to the Analyzer.
+ * @param type Pointer to the type node.
+ * @return Pointer to the type symbol, or NULL if the type is not supported.
+ */
+static Symbol *resolve_type(Analyzer *anz, const FlatType *type) {
+    Symbol *sym = builtin_type(anz, type->kind);
+    if (!sym) {
+        report_error(anz->ctx, anz->line, 0, "Unsupported type");
+        anz->err = true;
+    }
+    return sym;
+}
+
 /*********************************************
  * Variable Declaration
  *********************************************/
@@ -318,45 +457,36 @@ static void resolve_node(Analyzer *anz, Node *node) {
  * @param anz Pointer to the Analyzer.
  * @param var Pointer to the variable declaration node.
  */
-static void resolve_var_decl(Analyzer *anz, VarNode *var) {
-    Symbol *vtype = search_symbol(anz->symtab, var->dtype, 0);
-    if (!anz) {
-        fprintf(stderr, "Error (line %d): Unknown type '%s'\n", var->base.line, var->dtype);
-        anz->err = true;
-        return;
-    }
-
-    printf(
-        "Variable (%s) resolves to type (%s) (scope %d)\n", var->name, vtype->name,
-        anz->symtab->scope
-    );
+static void resolve_var_decl(Analyzer *anz, const FlatDecl *var) {
+    Symbol *vtype = resolve_type(anz, type_at(anz, var->type));
+    if (!vtype) return;
 
-    char *name  = sym_uname(var->name, anz->symtab->scope);
-    Symbol *dup = search_symbol(anz->symtab, name, anz->symtab->scope);
-    if (dup) {
+    if (anz->ctx->trace) {
         fprintf(
-            stderr, "Error (line %d): Redeclaration of variable '%s'\n", var->base.line, var->name
+            anz->ctx->trace, "Variable (%s) resolves to type (%s) (scope %d)\n", var->name->str,
+            vtype->name->str, anz->symtab->scope
         );
+    }
+
+    Symbol *dup = search_scope(anz->symtab, var->name);
+    if (dup) {
+        report_error(anz->ctx, var->line, 0, "Redeclaration of variable '%s'", var->name->str);
         anz->err = true;
         return;
     }
 
-    Symbol *sym = make_symbol(name, SG_VAR, SA_DEC, 0, anz->symtab->scope, vtype);
-    add_symbol(anz->symtab, sym);
+    declare(anz, var->name, SG_VAR, anz->symtab->scope, vtype);
 
-    if (var->init) {
-        Symbol *init_type = resolve_expression(anz, var->init);
+    if (var->var.init != NO_NODE) {
+        Symbol *init_type = resolve_expression(anz, expr_at(anz, var->var.init));
         if (!init_type) {
-            fprintf(
-                stderr, "Error (line %d): Invalid initializer for '%s'\n", var->base.line, var->name
-            );
+            report_error(anz->ctx, var->line, 0, "Invalid initializer for '%s'", var->name->str);
             anz->err = true;
             return;
         }
-        if (!is_compatible(vtype, init_type)) {
-            fprintf(
-                stderr, "Error (line %d): Invalid initializer type for '%s'\n", var->base.line,
-                var->name
+        if (!is_compatible(vtype, init_type->type)) {
+            report_error(
+                anz->ctx, var->line, 0, "Invalid initializer type for '%s'", var->name->str
             );
             anz->err = true;
         }
@@ -370,49 +500,96 @@ static void resolve_var_decl(Analyzer *anz, VarNode *var) {
 /**
  * @brief Analyzes a function declaration.
  *
- * Resolves the return type, checks for duplicates, processes parameters,
- * and analyzes the function body.
+ * Declares the function with it's signature, then processes parameters and
+ * analyzes the function body.
  *
  * @param anz Pointer to the Analyzer.
  * @param fn Pointer to the function declaration node.
  */
-static void resolve_func(Analyzer *anz, FuncNode *fn) {
-    Symbol *rtype = search_symbol(anz->symtab, fn->dtype, 0);
-    if (!rtype) {
-        fprintf(stderr, "Error (line %d): Unknown return type '%s'\n", fn->base.line, fn->dtype);
-        anz->err = true;
-        return;
-    }
+static void resolve_func(Analyzer *anz, const FlatDecl *fn) {
+    Symbol *fsym = declare_func(anz, fn);
+    if (fsym) resolve_body(anz, fn, fsym);
+}
+
+/**
+ * @brief Declares a function and it's signature.
+ *
+ * Resolves the return type, checks for duplicates and collects the parameter
+ * types, so calls can be checked before the body is analyzed.
+ *
+ * @param anz Pointer to the Analyzer.
+ * @param fn Pointer to the function declaration node.
+ * @return Pointer to the function symbol, NULL if the function is rejected.
+ */
+static Symbol *declare_func(Analyzer *anz, const FlatDecl *fn) {
+    Symbol *rtype = resolve_type(anz, type_at(anz, type_at(anz, fn->type)->func.ret));
+    if (!rtype) return NULL;
 
     Symbol *existing = search_symbol(anz->symtab, fn->name, anz->symtab->scope);
     if (existing) {
-        fprintf(
-            stderr, "Error (line %d): Redeclaration of function '%s'\n", fn->base.line, fn->name
-        );
+        report_error(anz->ctx, fn->line, 0, "Redeclaration of function '%s'", fn->name->str);
         anz->err = true;
-        return;
+        return NULL;
     }
 
-    Symbol *fsym = make_symbol(fn->name, SG_FUNC, SA_DEC, 0, 0, rtype);
-    fsym->params = NULL; // Initialize parameters array
-    fsym->pcount = 0;    // Initialize parameter count
-    add_symbol(anz->symtab, fsym);
+    Symbol *fsym = declare(anz, fn->name, SG_FUNC, 0, rtype);
+    sign_func(anz, fsym, fn);
+    return fsym;
+}
+
+/**
+ * @brief Collects the parameter types of a function.
+ *
+ * Leaves out the parameters `resolve_param` rejects, those of an unsupported
+ * type and those named like an earlier one, without reporting them.
+ *
+ * @param anz Pointer to the Analyzer.
+ * @param fsym Pointer to the function symbol.
+ * @param fn Pointer to the function declaration node.
+ */
+static void sign_func(Analyzer *anz, Symbol *fsym, const FlatDecl *fn) {
+    const NodeRef *params = flat_items(anz->ast, fn->func.params);
+    uint32_t count        = flat_count(anz->ast, fn->func.params);
+    if (!count) return;
+
+    fsym->params = mem_malloc(count * sizeof(Symbol *));
+    if (!fsym->params) out_of_memory(anz);
+
+    for (uint32_t i = 0; i < count; i++) {
+        const FlatDecl *param = decl_at(anz, params[i]);
+        Symbol *ptype         = builtin_type(anz, type_at(anz, param->type)->kind);
+        if (!ptype) continue;
+
+        // The first valid parameter of a name is kept, later ones are duplicates
+        bool duplicate = false;
+        for (uint32_t k = 0; k < i && !duplicate; k++) {
+            const FlatDecl *prev = decl_at(anz, params[k]);
+            if (prev->name != param->name) continue;
+
+            duplicate = builtin_type(anz, type_at(anz, prev->type)->kind) != NULL;
+        }
+        if (!duplicate) fsym->params[fsym->pcount++] = ptype;
+    }
+}
 
+/**
+ * @brief Analyzes the parameters and the body of a declared function.
+ *
+ * @param anz Pointer to the Analyzer.
+ * @param fn Pointer to the function declaration node.
+ * @param fsym Pointer to the function symbol.
+ */
+static void resolve_body(Analyzer *anz, const FlatDecl *fn, Symbol *fsym) {
     anz->sym = fsym;
     scope_enter(anz->symtab);
 
-    for (int i = 0; i < fn->pcount; i++) {
-        if (fn->params[i]->type != NODE_VAR_DECL) {
-            fprintf(stderr, "Error (line %d): Invalid parameter syntax\n", fn->base.line);
-            anz->err = true;
-            continue;
-        }
-        VarNode *param = (VarNode *)fn->params[i];
-        resolve_param(anz, param);
+    const NodeRef *params = flat_items(anz->ast, fn->func.params);
+    for (uint32_t i = 0; i < flat_count(anz->ast, fn->func.params); i++) {
+        resolve_param(anz, decl_at(anz, params[i]));
     }
 
-    if (fn->body) {
-        resolve_block(anz, (BlockNode *)fn->body);
+    if (fn->func.body != NO_NODE) {
+        resolve_block(anz, block_at(anz, fn->func.body));
     }
 
     scope_exit(anz->symtab);
@@ -422,45 +599,32 @@ static void resolve_func(Analyzer *anz, FuncNode *fn) {
 /**
  * @brief Analyzes a function parameter.
  *
- * Resolves the parameter's type, generates a unique name, checks for duplicates,
- * and adds the parameter to the current scope.
+ * Resolves the parameter's type, checks for duplicates, and adds the
+ * parameter to the current scope. It's type is already part of the function's
+ * signature.
  *
  * @param anz Pointer to the Analyzer.
  * @param param Pointer to the parameter node.
  */
-static void resolve_param(Analyzer *anz, VarNode *param) {
-    Symbol *ptype = search_symbol(anz->symtab, param->dtype, 0);
-    if (!ptype) {
-        fprintf(
-            stderr, "Error (line %d): Unknown parameter type '%s'\n", param->base.line, param->dtype
-        );
-        anz->err = true;
-        return;
-    }
+static void resolve_param(Analyzer *anz, const FlatDecl *param) {
+    Symbol *ptype = resolve_type(anz, type_at(anz, param->type));
+    if (!ptype) return;
 
-    char *uname       = sym_uname(param->name, anz->symtab->scope);
-    Symbol *duplicate = search_symbol(anz->symtab, uname, anz->symtab->scope);
+    Symbol *duplicate = search_scope(anz->symtab, param->name);
     if (duplicate) {
-        fprintf(
-            stderr, "Error (line %d): Duplicate parameter '%s'\n", param->base.line, param->name
-        );
+        report_error(anz->ctx, param->line, 0, "Duplicate parameter '%s'", param->name->str);
         anz->err = true;
-        free(uname);
         return;
     }
 
-    // Add parameter type to the function's symbol
-    anz->sym->params = realloc(anz->sym->params, (anz->sym->pcount + 1) * sizeof(Symbol *));
-    anz->sym->params[anz->sym->pcount] = ptype;
-    anz->sym->pcount++;
-
-    Symbol *psym = make_symbol(uname, SG_PARAM, SA_DEC, 0, anz->symtab->scope, ptype);
-    add_symbol(anz->symtab, psym);
+    declare(anz, param->name, SG_PARAM, anz->symtab->scope, ptype);
 
-    free(uname);
-    printf(
-        "Resolved param type %s for '%s' (scope %d)\n", ptype->name, param->name, anz->symtab->scope
-    );
+    if (anz->ctx->trace) {
+        fprintf(
+            anz->ctx->trace, "Resolved param type %s for '%s' (scope %d)\n", ptype->name->str,
+            param->name->str, anz->symtab->scope
+        );
+    }
 }
 
 /*********************************************
@@ -475,50 +639,21 @@ static void resolve_param(Analyzer *anz, VarNode *param) {
  * @param anz Pointer to the Analyzer.
  * @param stmt Pointer to the statement node.
  */
-static void resolve_statement(Analyzer *anz, StmtNode *stmt) {
-    anz->line = stmt->base.line;
-
-    switch (stmt->type) {
-    case STMT_RETURN:     resolve_return(anz, stmt); break;
-    case STMT_EXPRESSION: resolve_expression(anz, stmt->u.simple.expr); break;
-    case STMT_ASSIGNMENT: resolve_assignment(anz, stmt); break;
-    case STMT_IF:         resolve_if(anz, stmt); break;
-    case STMT_FOR:        resolve_for(anz, stmt); break;
-    case STMT_WHILE:      resolve_while(anz, stmt); break;
-    case STMT_DO_WHILE:   resolve_do_while(anz, stmt); break;
-    case STMT_COMPOUND:   resolve_block(anz, (BlockNode *)stmt->u.simple.expr); break;
-    case STMT_CALL:       resolve_call_expr(anz, (ExprNode *)stmt->u.simple.expr); break;
+static void resolve_statement(Analyzer *anz, const FlatStmt *stmt) {
+    anz->line = stmt->line;
+
+    switch (stmt->kind) {
+    case STMT_RETURN:   resolve_return(anz, stmt); break;
+    case STMT_EXPR:     resolve_expression(anz, expr_at(anz, stmt->expr)); break;
+    case STMT_IF:       resolve_if(anz, stmt); break;
+    case STMT_FOR:      resolve_for(anz, stmt); break;
+    case STMT_WHILE:    resolve_while(anz, stmt); break;
+    case STMT_DO_WHILE: resolve_do_while(anz, stmt); break;
+    case STMT_COMPOUND: resolve_block(anz, block_at(anz, stmt->block)); break;
+    case STMT_BREAK:
+    case STMT_CONTINUE: break;
     default:
-        fprintf(stderr, "Unhandled statement type: %d\n", stmt->type);
-        errexit("Unsupported statement");
-    }
-}
-
-/**
- * @brief Analyzes an assignment statement.
- *
- * Verifies that the left-hand side is declared and that the right-hand side
- * is compatible with it.
- *
- * @param anz Pointer to the Analyzer.
- * @param stmt Pointer to the assignment statement node.
- */
-static void resolve_assignment(Analyzer *anz, StmtNode *stmt) {
-    Symbol *lhs = resolve_variable(anz->symtab, stmt->u.assignment.lhs, anz->symtab->scope);
-    if (!lhs) {
-        fprintf(
-            stderr, "Error (line %d): Undeclared variable '%s'\n", anz->line, stmt->u.assignment.lhs
-        );
-        anz->err = true;
-        return;
-    }
-
-    Symbol *rhs = resolve_expression(anz, stmt->u.assignment.rhs);
-    if (!is_compatible(lhs->type, rhs->type)) {
-        fprintf(
-            stderr, "Error (line %d): Cannot assign %s to %s\n", anz->line, rhs->type->name,
-            lhs->type->name
-        );
+        report_error(anz->ctx, stmt->line, 0, "Unhandled statement type: %d", stmt->kind);
         anz->err = true;
     }
 }
@@ -529,13 +664,14 @@ static void resolve_assignment(Analyzer *anz, StmtNode *stmt) {
  * Enters a new scope, analyzes each statement in the block, and then exits the scope.
  *
  * @param anz Pointer to the Analyzer.
- * @param block Pointer to the BlockNode.
+ * @param block Pointer to the Block.
  */
-static void resolve_block(Analyzer *anz, BlockNode *block) {
+static void resolve_block(Analyzer *anz, const FlatBlock *block) {
     scope_enter(anz->symtab);
 
-    for (int i = 0; i < block->icount; i++) {
-        resolve_node(anz, block->items[i]);
+    const NodeRef *items = flat_items(anz->ast, block->items);
+    for (uint32_t i = 0; i < flat_count(anz->ast, block->items); i++) {
+        resolve_item(anz, items[i]);
     }
     scope_exit(anz->symtab);
 }
@@ -552,16 +688,16 @@ static void resolve_block(Analyzer *anz, BlockNode *block) {
  * @param anz Pointer to the Analyzer.
  * @param stmt Pointer to the if statement node.
  */
-static void resolve_if(Analyzer *anz, StmtNode *stmt) {
-    Symbol *cond = resolve_expression(anz, stmt->u.if_stmt.condition);
+static void resolve_if(Analyzer *anz, const FlatStmt *stmt) {
+    Symbol *cond = resolve_expression(anz, expr_at(anz, stmt->_if.cond));
 
-    if (!is_scalar(cond)) {
-        fprintf(stderr, "Error (line %d): If condition must be scalar type\n", stmt->base.line);
+    if (cond && !is_scalar(cond->type)) {
+        report_error(anz->ctx, stmt->line, 0, "If condition must be scalar type");
         anz->err = true;
     }
-    resolve_node(anz, stmt->u.if_stmt.then_stmt);
+    resolve_statement(anz, stmt_at(anz, stmt->_if.then));
 
-    if (stmt->u.if_stmt.else_stmt) resolve_node(anz, stmt->u.if_stmt.else_stmt);
+    if (stmt->_if.else_ != NO_NODE) resolve_statement(anz, stmt_at(anz, stmt->_if.else_));
 }
 
 /**
@@ -572,18 +708,22 @@ static void resolve_if(Analyzer *anz, StmtNode *stmt) {
  * @param anz Pointer to the Analyzer.
  * @param stmt Pointer to the for loop statement node.
  */
-static void resolve_for(Analyzer *anz, StmtNode *stmt) {
+static void resolve_for(Analyzer *anz, const FlatStmt *stmt) {
     scope_enter(anz->symtab);
 
-    if (stmt->u.for_stmt.init) resolve_node(anz, stmt->u.for_stmt.init);
+    if (stmt->_for.init != NO_NODE) resolve_decl(anz, decl_at(anz, stmt->_for.init));
 
-    if (stmt->u.for_stmt.condition) {
-        Symbol *cond = resolve_expression(anz, stmt->u.for_stmt.condition);
-        if (!is_scalar(cond)) {
-            fprintf(stderr, "Error (line %d): For condition must be scalar\n", stmt->base.line);
+    if (stmt->_for.cond != NO_NODE) {
+        Symbol *cond = resolve_expression(anz, expr_at(anz, stmt->_for.cond));
+        if (cond && !is_scalar(cond->type)) {
+            report_error(anz->ctx, stmt->line, 0, "For condition must be scalar");
+            anz->err = true;
         }
     }
-    resolve_node(anz, stmt->u.for_stmt.body);
+
+    if (stmt->_for.post != NO_NODE) resolve_expression(anz, expr_at(anz, stmt->_for.post));
+
+    resolve_statement(anz, stmt_at(anz, stmt->_for.body));
     scope_exit(anz->symtab);
 }
 
@@ -595,15 +735,13 @@ static void resolve_for(Analyzer *anz, StmtNode *stmt) {
  * @param anz Pointer to the Analyzer.
  * @param stmt Pointer to the do-while loop statement node.
  */
-static void resolve_do_while(Analyzer *anz, StmtNode *stmt) {
-    resolve_node(anz, stmt->u.while_stmt.body);
+static void resolve_do_while(Analyzer *anz, const FlatStmt *stmt) {
+    resolve_statement(anz, stmt_at(anz, stmt->_while.body));
 
-    Symbol *cond = resolve_expression(anz, stmt->u.while_stmt.condition);
+    Symbol *cond = resolve_expression(anz, expr_at(anz, stmt->_while.cond));
 
-    if (!is_scalar(cond)) {
-        fprintf(
-            stderr, "Error (line %d): Do-while condition must be scalar type\n", stmt->base.line
-        );
+    if (cond && !is_scalar(cond->type)) {
+        report_error(anz->ctx, stmt->line, 0, "Do-while condition must be scalar type");
         anz->err = true;
     }
 }
@@ -615,61 +753,43 @@ static void resolve_do_while(Analyzer *anz, StmtNode *stmt) {
 /**
  * @brief Analyzes an expression.
  *
- * Dispatches to the appropriate expression analysis function based on the node type.
+ * Dispatches to specialized functions based on the expression type.
  *
  * @param anz Pointer to the Analyzer.
- * @param node Pointer to the expression node.
+ * @param expr Pointer to the expression node.
  * @return Pointer to the symbol representing the expression type.
  */
-static Symbol *resolve_expression(Analyzer *anz, Node *node) {
-    switch (node->type) {
-    case NODE_EXPRESSION: return resolve_expr_node(anz, (ExprNode *)node);
-    default:              fprintf(stderr, "Unexpected expression node type: %d\n", node->type); return NULL;
+static Symbol *resolve_expression(Analyzer *anz, const FlatExpr *expr) {
+    switch (expr->kind) {
+    case EXPR_CONST:   return resolve_const_expr(anz, expr);
+    case EXPR_VAR:     return resolve_var_expr(anz, expr);
+    case EXPR_UNARY:   return resolve_unary_expr(anz, expr);
+    case EXPR_BINARY:  return resolve_binary_expr(anz, expr);
+    case EXPR_ASSIGN:  return resolve_assign_expr(anz, expr);
+    case EXPR_TERNARY: return resolve_conditional_expr(anz, expr);
+    case EXPR_CALL:    return resolve_call_expr(anz, expr);
+    default:
+        report_error(anz->ctx, expr->line, 0, "Unhandled expression type: %d", expr->kind);
+        anz->err = true;
+        return NULL;
     }
 }
 
 /**
- * @brief Analyzes a generic expression node.
- *
- * Dispatches to specialized functions based on the expression type.
+ * @brief Analyzes a constant expression.
  *
  * @param anz Pointer to the Analyzer.
- * @param expr Pointer to the expression node.
- * @return Pointer to the symbol representing the expression type.
+ * @param expr Pointer to the constant expression node.
+ * @return Pointer to the type symbol of the constant.
  */
-static Symbol *resolve_expr_node(Analyzer *anz, ExprNode *expr) {
-    switch (expr->type) {
-    case EXPR_CONSTANT: {
-        const char *dtype = NULL;
-        Symbol *dsym      = NULL;
-
-        switch (expr->u.con.ctype) {
-        case CT_INT:    dtype = "int"; break;
-        case CT_FLOAT:  dtype = "float"; break;
-        case CT_CHAR:   dtype = "char"; break;
-        case CT_STRING: dtype = "string"; break;
-        default:
-            fprintf(
-                stderr, "Unknown constant type: %d at line %d", expr->u.con.ctype, expr->base.line
-            );
-            return NULL;
-        }
-
-        dsym = search_symbol(anz->symtab, dtype, 0);
-        if (!dsym) {
-            fprintf(stderr, "Undefined type: %s at line %d", dtype, expr->base.line);
-            return NULL;
-        }
-
-        return dsym;
-    }
-    case EXPR_VAR:         return resolve_var_expr(anz, expr);
-    case EXPR_UNARY:       return resolve_unary_expr(anz, expr);
-    case EXPR_BINARY:      return resolve_binary_expr(anz, expr);
-    case EXPR_CONDITIONAL: return resolve_conditional_expr(anz, expr);
-    case EXPR_CALL:        return resolve_call_expr(anz, expr);
+static Symbol *resolve_const_expr(Analyzer *anz, const FlatExpr *expr) {
+    switch (expr->op) {
+    case CONST_INT:   return anz->builtins[BT_INT];
+    case CONST_FLOAT: return anz->builtins[BT_FLOAT];
+    case CONST_STR:   return anz->builtins[BT_STRING];
     default:
-        fprintf(stderr, "Unhandled expression type: %d at line %d", expr->type, expr->base.line);
+        report_error(anz->ctx, expr->line, 0, "Unknown constant type: %d", expr->op);
+        anz->err = true;
         return NULL;
     }
 }
@@ -677,16 +797,17 @@ static Symbol *resolve_expr_node(Analyzer *anz, ExprNode *expr) {
 /**
  * @brief Analyzes a variable expression.
  *
- * Looks up the variable using the unique naming scheme across scopes.
+ * Looks up the innermost declaration of the variable.
  *
  * @param anz Pointer to the Analyzer.
  * @param expr Pointer to the variable expression node.
  * @return Pointer to the symbol for the variable.
  */
-static Symbol *resolve_var_expr(Analyzer *anz, ExprNode *expr) {
-    Symbol *sym = resolve_variable(anz->symtab, expr->u.name, anz->symtab->scope);
+static Symbol *resolve_var_expr(Analyzer *anz, const FlatExpr *expr) {
+    Symbol *sym = lookup(anz, expr->name, anz->symtab->scope);
+    if (sym && sym->group != SG_VAR && sym->group != SG_PARAM) sym = NULL; // Not a variable
     if (!sym) {
-        fprintf(stderr, "Error (line %d): Undeclared variable '%s'\n", anz->line, expr->u.name);
+        report_error(anz->ctx, anz->line, 0, "Undeclared variable '%s'", expr->name->str);
         anz->err = true;
     }
     return sym;
@@ -701,13 +822,14 @@ static Symbol *resolve_var_expr(Analyzer *anz, ExprNode *expr) {
  * @param expr Pointer to the unary expression node.
  * @return Pointer to the resulting symbol type.
  */
-static Symbol *resolve_unary_expr(Analyzer *anz, ExprNode *expr) {
-    Symbol *operand = resolve_expression(anz, expr->u.unary.operand);
-
-    switch (expr->u.unary.op) {
-    case UN_NOT:
-        if (!is_boolean(operand)) {
-            fprintf(stderr, "Error (line %d): Logical NOT requires boolean\n", anz->line);
+static Symbol *resolve_unary_expr(Analyzer *anz, const FlatExpr *expr) {
+    Symbol *operand = resolve_expression(anz, expr_at(anz, expr->operand));
+    if (!operand) return NULL;
+
+    switch (expr->op) {
+    case UOP_NOT:
+        if (!is_boolean(operand->type)) {
+            report_error(anz->ctx, anz->line, 0, "Logical NOT requires boolean");
             anz->err = true;
         }
         return operand;
@@ -725,68 +847,61 @@ static Symbol *resolve_unary_expr(Analyzer *anz, ExprNode *expr) {
  * @param expr Pointer to the binary expression node.
  * @return Pointer to the symbol representing the result type.
  */
-static Symbol *resolve_binary_expr(Analyzer *anz, ExprNode *expr) {
-    Symbol *lsym = resolve_expression(anz, expr->u.binary.left);
-    Symbol *rsym = resolve_expression(anz, expr->u.binary.right);
+static Symbol *resolve_binary_expr(Analyzer *anz, const FlatExpr *expr) {
+    Symbol *lsym = resolve_expression(anz, expr_at(anz, expr->binary.left));
+    Symbol *rsym = resolve_expression(anz, expr_at(anz, expr->binary.right));
 
     if (!lsym || !rsym || !lsym->type || !rsym->type) {
         anz->err = true;
         return NULL;
     }
 
-    switch (expr->u.binary.op) {
-    case BIN_GT:
-    case BIN_LT:
+    switch (expr->op) {
+    case BOP_GT:
+    case BOP_LT:
         if (!is_comparable(lsym->type, rsym->type)) {
-            fprintf(
-                stderr, "Error (line %d): Cannot compare %s and %s\n", expr->base.line,
-                lsym->type->name, rsym->type->name
+            report_error(
+                anz->ctx, expr->line, 0, "Cannot compare %s and %s", lsym->type->name->str,
+                rsym->type->name->str
             );
             anz->err = true;
         }
         return get_bool_type(anz);
-    case BIN_LTEQ:
-    case BIN_GTEQ:
-    case BIN_EQ:
-    case BIN_NEQ:
+    case BOP_LTEQ:
+    case BOP_GTEQ:
+    case BOP_EQ:
+    case BOP_NEQ:
         if (!is_comparable(lsym->type, rsym->type)) {
-            fprintf(
-                stderr, "Error (line %d): Cannot compare %s and %s\n", expr->base.line,
-                lsym ? lsym->name : "<?>", rsym ? rsym->name : "<?>"
+            report_error(
+                anz->ctx, expr->line, 0, "Cannot compare %s and %s", lsym->name->str,
+                rsym->name->str
             );
             anz->err = true;
         }
         return get_bool_type(anz);
-    case BIN_ADD:
-    case BIN_SUB:
-    case BIN_MUL:
-    case BIN_DIV:
-    case BIN_MOD: {
+    case BOP_ADD:
+    case BOP_SUB:
+    case BOP_MUL:
+    case BOP_DIV:
+    case BOP_MOD: {
         if (!is_arithmetic(lsym->type) || !is_arithmetic(rsym->type)) {
-            fprintf(stderr, "Error (line %d): Invalid arithmetic operands\n", expr->base.line);
+            report_error(anz->ctx, expr->line, 0, "Invalid arithmetic operands");
             anz->err = true;
             return NULL;
         }
 
-        if (expr->u.binary.op == BIN_MOD) {
-            bool left_is_int =
-                (strcmp(lsym->type->name, "int") == 0 || strcmp(lsym->type->name, "char") == 0);
-            bool right_is_int =
-                (strcmp(rsym->type->name, "int") == 0 || strcmp(rsym->type->name, "char") == 0);
-
-            if (!left_is_int || !right_is_int) {
-                fprintf(
-                    stderr, "Error (line %d): '%%' requires integer operands\n", expr->base.line
-                );
+        if (expr->op == BOP_MOD) {
+            if (!is_integer(lsym->type) || !is_integer(rsym->type)) {
+                report_error(anz->ctx, expr->line, 0, "'%%' requires integer operands");
                 anz->err = true;
             }
         }
         return numeric_promotion(anz, lsym->type, rsym->type);
     }
-    case BIN_AND:
-    case BIN_OR:
+    case BOP_AND:
+    case BOP_OR:
         if (!is_boolean(lsym->type) || !is_boolean(rsym->type)) {
-            fprintf(stderr, "Error (line %d): Logical operators need booleans\n", expr->base.line);
+            report_error(anz->ctx, expr->line, 0, "Logical operators need booleans");
             anz->err = true;
         }
         return get_bool_type(anz);
@@ -794,6 +909,38 @@ static Symbol *resolve_binary_expr(Analyzer *anz, ExprNode *expr) {
     }
 }
 
+/**
+ * @brief Analyzes an assignment expression.
+ *
+ * Verifies that the left-hand side is a declared variable and that the
+ * right-hand side is compatible with it.
+ *
+ * @param anz Pointer to the Analyzer.
+ * @param expr Pointer to the assignment expression node.
+ * @return Pointer to the symbol of the assigned variable.
+ */
+static Symbol *resolve_assign_expr(Analyzer *anz, const FlatExpr *expr) {
+    const FlatExpr *target = expr_at(anz, expr->binary.left);
+    if (target->kind != EXPR_VAR) {
+        report_error(anz->ctx, expr->line, 0, "Invalid assignment target");
+        anz->err = true;
+        return NULL;
+    }
+
+    Symbol *lhs = resolve_var_expr(anz, target);
+    Symbol *rhs = resolve_expression(anz, expr_at(anz, expr->binary.right));
+    if (!lhs || !rhs) return NULL;
+
+    if (!is_compatible(lhs->type, rhs->type)) {
+        report_error(
+            anz->ctx, expr->line, 0, "Cannot assign %s to %s", rhs->type->name->str,
+            lhs->type->name->str
+        );
+        anz->err = true;
+    }
+    return lhs;
+}
+
 /**
  * @brief Analyzes a conditional (ternary) expression.
  *
@@ -804,23 +951,29 @@ static Symbol *resolve_binary_expr(Analyzer *anz, ExprNode *expr) {
  * @param expr Pointer to the conditional expression node.
  * @return Pointer to the symbol representing the resulting type.
  */
-static Symbol *resolve_conditional_expr(Analyzer *anz, ExprNode *expr) {
-    Symbol *cond_sym  = resolve_expression(anz, expr->u.conditional.condition);
-    Symbol *cond_type = cond_sym->type;
+static Symbol *resolve_conditional_expr(Analyzer *anz, const FlatExpr *expr) {
+    const NodeRef *ops = anz->ast->extra + expr->conditional; // Left, middle and right
 
+    Symbol *cond_sym = resolve_expression(anz, expr_at(anz, ops[0]));
+    if (!cond_sym) return NULL;
+
+    Symbol *cond_type = cond_sym->type;
     if (!is_scalar(cond_type)) {
-        fprintf(stderr, "Error (line %d): Ternary condition must be scalar\n", expr->base.line);
+        report_error(anz->ctx, expr->line, 0, "Ternary condition must be scalar");
         anz->err = true;
     }
-    Symbol *true_sym   = resolve_expression(anz, expr->u.conditional.true_expr);
-    Symbol *false_sym  = resolve_expression(anz, expr->u.conditional.false_expr);
+
+    Symbol *true_sym  = resolve_expression(anz, expr_at(anz, ops[1]));
+    Symbol *false_sym = resolve_expression(anz, expr_at(anz, ops[2]));
+    if (!true_sym || !false_sym) return NULL;
+
     Symbol *true_type  = true_sym->type;
     Symbol *false_type = false_sym->type;
 
     if (!is_compatible(true_type, false_type)) {
-        fprintf(
-            stderr, "Error (line %d): Ternary types mismatch (%s vs %s)\n", expr->base.line,
-            true_type->name, false_type->name
+        report_error(
+            anz->ctx, expr->line, 0, "Ternary types mismatch (%s vs %s)", true_type->name->str,
+            false_type->name->str
         );
         anz->err = true;
     }
@@ -836,36 +989,38 @@ static Symbol *resolve_conditional_expr(Analyzer *anz, ExprNode *expr) {
  * @param expr Pointer to the call expression node.
  * @return Pointer to the symbol representing the function's return type.
  */
-static Symbol *resolve_call_expr(Analyzer *anz, ExprNode *expr) {
-    ExprNode *exp = (ExprNode *)expr->u.call.callee;
-    if (!exp || exp->type != EXPR_VAR) {
-        fprintf(stderr, "Error (line %d): Invalid function call\n", anz->line);
+static Symbol *resolve_call_expr(Analyzer *anz, const FlatExpr *expr) {
+    const FlatExpr *exp = expr_at(anz, expr->call.func);
+    if (exp->kind != EXPR_VAR) {
+        report_error(anz->ctx, anz->line, 0, "Invalid function call");
         anz->err = true;
         return NULL;
     }
 
-    Symbol *callee = search_symbol(anz->symtab, exp->u.name, anz->symtab->scope);
+    const Atom *name    = exp->name;
+    Symbol *callee      = lookup(anz, name, anz->symtab->scope);
+    const NodeRef *args = flat_items(anz->ast, expr->call.args);
+    uint32_t arg_count  = flat_count(anz->ast, expr->call.args);
     if (!callee || callee->group != SG_FUNC) {
-        fprintf(stderr, "Error (line %d): Undeclared function '%s'\n", anz->line, exp->u.name);
+        report_error(anz->ctx, anz->line, 0, "Undeclared function '%s'", name->str);
         anz->err = true;
         return NULL;
     }
 
     // Check argument count
-    if (callee->pcount != expr->u.call.acount) {
-        fprintf(
-            stderr, "Error (line %d): Function '%s' expects %d arguments but got %d\n", anz->line,
-            exp->u.name, callee->pcount, expr->u.call.acount
+    if (callee->pcount != (int)arg_count) {
+        report_error(
+            anz->ctx, anz->line, 0, "Function '%s' expects %d arguments but got %u", name->str,
+            callee->pcount, arg_count
         );
         anz->err = true;
     }
 
     // Check each argument's type against the corresponding parameter
-    for (int i = 0; i < expr->u.call.acount; i++) {
-        if (i >= callee->pcount) break; // Avoid overflow if too many args
+    for (uint32_t i = 0; i < arg_count; i++) {
+        if ((int)i >= callee->pcount) break; // Avoid overflow if too many args
 
-        Node *arg      = expr->u.call.args[i];
-        Symbol *argsym = resolve_expression(anz, arg);
+        Symbol *argsym = resolve_expression(anz, expr_at(anz, args[i]));
 
         if (!argsym) {
             anz->err = true;
@@ -874,9 +1029,9 @@ static Symbol *resolve_call_expr(Analyzer *anz, ExprNode *expr) {
 
         Symbol *paramtype = callee->params[i];
         if (!is_compatible(paramtype, argsym->type)) {
-            fprintf(
-                stderr, "Error (line %d): Argument %d type mismatch (expected %s, got %s)\n",
-                anz->line, i + 1, paramtype->name, argsym->type->name
+            report_error(
+                anz->ctx, anz->line, 0, "Argument %u type mismatch (expected %s, got %s)", i + 1,
+                paramtype->name->str, argsym->type->name->str
             );
             anz->err = true;
         }
@@ -898,32 +1053,29 @@ static Symbol *resolve_call_expr(Analyzer *anz, ExprNode *expr) {
  * @param anz Pointer to the Analyzer.
  * @param stmt Pointer to the return statement node.
  */
-static void resolve_return(Analyzer *anz, StmtNode *stmt) {
+static void resolve_return(Analyzer *anz, const FlatStmt *stmt) {
     if (!anz->sym) {
-        fprintf(stderr, "Error (line %d): return statement outside function\n", stmt->base.line);
+        report_error(anz->ctx, stmt->line, 0, "return statement outside function");
         anz->err = true;
         return;
     }
 
     Symbol *rtype = anz->sym->type;
-    Symbol *expr  = resolve_expression(anz, stmt->u.simple.expr);
+    Symbol *expr  = NULL;
+    if (stmt->expr != NO_NODE) expr = resolve_expression(anz, expr_at(anz, stmt->expr));
 
-    if (!rtype || !expr->type) {
+    if (!rtype || !expr || !expr->type) {
         anz->err = true;
         return;
     }
 
-    if (strcmp(rtype->name, "void") == 0) {
-        if (expr->type) {
-            fprintf(
-                stderr, "Error (line %d): Void function cannot return value\n", stmt->base.line
-            );
-            anz->err = true;
-        }
+    if (rtype->builtin == BT_VOID) {
+        report_error(anz->ctx, stmt->line, 0, "Void function cannot return value");
+        anz->err = true;
     } else if (!is_compatible(rtype, expr->type)) {
-        fprintf(
-            stderr, "Error (line %d): Return type mismatch (expected %s, got %s)\n",
-            stmt->base.line, rtype->name, expr->type->name
+        report_error(
+            anz->ctx, stmt->line, 0, "Return type mismatch (expected %s, got %s)", rtype->name->str,
+            expr->type->name->str
         );
         anz->err = true;
     }
@@ -941,14 +1093,373 @@ static void resolve_return(Analyzer *anz, StmtNode *stmt) {
  * @param anz Pointer to the Analyzer.
  * @param stmt Pointer to the while loop statement node.
  */
-static void resolve_while(Analyzer *anz, StmtNode *stmt) {
-    Symbol *cond = resolve_expression(anz, stmt->u.while_stmt.condition);
+static void resolve_while(Analyzer *anz, const FlatStmt *stmt) {
+    Symbol *cond = resolve_expression(anz, expr_at(anz, stmt->_while.cond));
 
-    if (!is_scalar(cond)) {
-        fprintf(stderr, "Error (line %d): While condition must be scalar type\n", stmt->base.line);
+    if (cond && !is_scalar(cond->type)) {
+        report_error(anz->ctx, stmt->line, 0, "While condition must be scalar type");
         anz->err = true;
     }
-    resolve_node(anz, stmt->u.while_stmt.body);
+    resolve_statement(anz, stmt_at(anz, stmt->_while.body));
+}
+
+/*********************************************
+ * Parallel Analysis
+ *********************************************/
+
+// Diagnostics and trace of one pass or thread, kept apart until they are merged
+typedef struct {
+    CompilerContext ctx; // Receives the diagnostics, `ctx.trace` buffers into `trace`
+    char *trace;         // Buffered trace, complete once `ctx.trace` is closed
+    size_t tsize;
+} Output;
+
+// Function body left to the parallel pass, and where its output went
+typedef struct {
+    const FlatDecl *fn;
+    Symbol *sym;     // Function symbol, declared by the serial pass
+    unsigned order;  // Top level declaration of the function
+    unsigned before; // Diagnostics of the serial pass reported before the body
+    long traced;     // Trace bytes of the serial pass written before the body
+    int out;         // Worker that resolved the body, -1 if none did
+    unsigned from;   // First diagnostic of the body in the worker's output
+    unsigned to;     // Diagnostic after the body's last one
+    long tfrom;      // First trace byte of the body in the worker's output
+    long tto;        // Trace byte after the body's last one
+} Body;
+
+// Bodies shared by the workers, each one takes the next body nobody has taken
+typedef struct {
+    Body *bodies;
+    unsigned count;
+    atomic_uint next;
+} BodyQueue;
+
+// Thread of the parallel pass
+typedef struct {
+    Analyzer anz;     // Copy of the main analyzer with a table of locals of its own
+    Output out;       // Output of every body the worker resolves
+    BodyQueue *queue; // Bodies to resolve
+    int id;           // Index of the worker
+    double cpu;       // CPU milliseconds the worker spent
+    MemStats mem;     // Allocations the worker made
+} Worker;
+
+/**
+ * @brief Prepares an empty output, tracing into memory if `ctx` traces.
+ *
+ * @param out Pointer to the output.
+ * @param ctx Context the output is merged into.
+ * @return false if memory ran out.
+ */
+static bool open_output(Output *out, const CompilerContext *ctx) {
+    *out                 = (Output){0};
+    out->ctx.diags.limit = ctx->diags.limit;
+    if (!ctx->trace) return true;
+
+    out->ctx.trace = open_memstream(&out->trace, &out->tsize);
+    return out->ctx.trace != NULL;
+}
+
+/**
+ * @brief Counts the trace bytes written to an open output so far.
+ *
+ * @param out Pointer to the output.
+ * @return
+ */
+static long traced(Output *out) {
+    return out->ctx.trace ? ftell(out->ctx.trace) : 0;
+}
+
+/**
+ * @brief Completes the buffered trace of an output.
+ *
+ * @param out Pointer to the output.
+ */
+static void close_output(Output *out) {
+    if (out->ctx.trace) fclose(out->ctx.trace);
+    out->ctx.trace = NULL;
+}
+
+/**
+ * @brief Frees the diagnostics and the trace of an output.
+ *
+ * @param out Pointer to the output.
+ */
+static void purge_output(Output *out) {
+    close_output(out);
+    purge_diags(&out->ctx.diags);
+    free(out->trace);
+}
+
+/**
+ * @brief Reports a range of an output's diagnostics to `ctx` and writes a
+ * range of its trace to `ctx->trace`.
+ *
+ * @param ctx Context merged into.
+ * @param out Pointer to a closed output.
+ * @param from First diagnostic.
+ * @param to Diagnostic after the last one.
+ * @param tfrom First trace byte.
+ * @param tto Trace byte after the last one.
+ */
+static void emit_output(
+    CompilerContext *ctx, const Output *out, unsigned from, unsigned to, long tfrom, long tto
+) {
+    for (unsigned i = from; i < to; i++) {
+        const Diag *diag = &out->ctx.diags.items[i];
+        report_error(ctx, diag->line, diag->col, "%s", diag->msg);
+    }
+    if (ctx->trace && tto > tfrom) fwrite(out->trace + tfrom, 1, tto - tfrom, ctx->trace);
+}
+
+/**
+ * @brief Counts the top level functions, whose bodies the parallel pass resolves.
+ *
+ * A function declared anywhere else is declared globally by the body it is
+ * in, so the bodies after it would depend on that one.
+ *
+ * @param ast Pointer to the flat AST of the program.
+ * @return 0 if a function is declared below the top level.
+ */
+static unsigned count_funcs(const FlatAst *ast) {
+    unsigned all = 0;
+    for (uint32_t i = 0; i < ast->decl_count; i++) {
+        NodeRef type = ast->decls[i].type;
+        all += type != NO_NODE && ast->types[type].kind == TY_FUNC;
+    }
+
+    unsigned top         = 0;
+    const NodeRef *decls = flat_items(ast, ast->program);
+    for (uint32_t i = 0; i < flat_count(ast, ast->program); i++) {
+        NodeRef type = ast->decls[decls[i]].type;
+        top += type != NO_NODE && ast->types[type].kind == TY_FUNC;
+    }
+    return all == top ? top : 0;
+}
+
+/**
+ * @brief Prepares a worker of the parallel pass.
+ *
+ * @param w Pointer to the worker.
+ * @param anz Pointer to the main analyzer, whose table holds the top level symbols.
+ * @param queue Bodies to resolve.
+ * @param id Index of the worker.
+ * @return false if memory ran out.
+ */
+static bool make_worker(Worker *w, const Analyzer *anz, BodyQueue *queue, int id) {
+    w->anz         = *anz;
+    w->anz.ctx     = &w->out.ctx;
+    w->anz.symtab  = NULL;
+    w->anz.globals = anz->symtab;
+    w->anz.err     = false;
+    w->anz.sym     = NULL;
+    w->queue       = queue;
+    w->id          = id;
+    if (!open_output(&w->out, anz->ctx)) return false;
+
+    w->anz.symtab = make_symtab(&w->out.ctx);
+    return w->anz.symtab != NULL;
+}
+
+/**
+ * @brief Frees the workers with their tables and outputs.
+ *
+ * @param pool Workers.
+ * @param count Number of workers.
+ */
+static void purge_workers(Worker *pool, int count) {
+    for (int k = 0; pool && k < count; k++) {
+        purge_symtab(pool[k].anz.symtab);
+        purge_output(&pool[k].out);
+    }
+    free(pool);
+}
+
+/**
+ * @brief Serial pass of `resolve_parallel`. Resolves the top level declarations
+ * and declares the functions, their bodies are queued in declaration order.
+ *
+ * @param anz Pointer to the main analyzer.
+ * @param queue Receives the function bodies.
+ * @param out Output the analyzer reports to, positions in it are recorded with
+ * every body.
+ * @return false if memory ran out.
+ */
+static bool declare_globals(Analyzer *anz, BodyQueue *queue, Output *out) {
+    if (setjmp(anz->fail)) return false;
+
+    const NodeRef *decls = flat_items(anz->ast, anz->ast->program);
+    for (uint32_t i = 0; i < flat_count(anz->ast, anz->ast->program); i++) {
+        const FlatDecl *decl = decl_at(anz, decls[i]);
+        anz->line            = decl->line;
+        anz->order           = i + 1;
+
+        if (type_at(anz, decl->type)->kind != TY_FUNC) {
+            resolve_var_decl(anz, decl);
+            continue;
+        }
+
+        Symbol *fsym = declare_func(anz, decl);
+        if (!fsym) continue;
+
+        queue->bodies[queue->count++] = (Body){
+            .fn     = decl,
+            .sym    = fsym,
+            .order  = anz->order,
+            .before = out->ctx.diags.count,
+            .traced = traced(out),
+            .out    = -1,
+        };
+    }
+    return true;
+}
+
+/**
+ * @brief Resolves one queued body.
+ *
+ * @param anz Pointer to the worker's analyzer.
+ * @param body Pointer to the body.
+ * @return false if memory ran out, the body is abandoned then.
+ */
+static bool resolve_queued(Analyzer *anz, const Body *body) {
+    if (setjmp(anz->fail)) return false;
+
+    anz->line  = body->fn->line;
+    anz->order = body->order;
+    resolve_body(anz, body->fn, body->sym);
+    return true;
+}
+
+/**
+ * @brief Worker thread, resolves bodies from the queue until none are left or
+ * memory runs out. What it cost is recorded for the thread that joins it.
+ *
+ * @param arg Worker.
+ * @return
+ */
+static void *resolve_bodies(void *arg) {
+    Worker *w        = arg;
+    BodyQueue *queue = w->queue;
+    double cpu       = thread_cpu();
+    MemStats mem     = mem_stats();
+
+    for (;;) {
+        unsigned i = atomic_fetch_add(&queue->next, 1);
+        if (i >= queue->count) break;
+
+        Body *body  = &queue->bodies[i];
+        body->out   = w->id;
+        body->from  = w->out.ctx.diags.count;
+        body->tfrom = traced(&w->out);
+
+        bool done = resolve_queued(&w->anz, body);
+        body->to  = w->out.ctx.diags.count;
+        body->tto = traced(&w->out);
+        if (!done) break;
+    }
+
+    w->cpu = thread_cpu() - cpu;
+    w->mem = mem_since(mem);
+    return NULL;
+}
+
+/**
+ * @brief Runs every worker, the first one on the calling thread. Workers whose
+ * thread could not be created leave their bodies to the others. The CPU time
+ * and allocations of the other threads are added to the calling thread's.
+ *
+ * @param pool Workers.
+ * @param count Number of workers.
+ */
+static void run_workers(Worker *pool, int count) {
+    pthread_t threads[MAX_WORKERS];
+    bool started[MAX_WORKERS];
+
+    for (int k = 1; k < count; k++) {
+        started[k] = pthread_create(&threads[k], NULL, resolve_bodies, &pool[k]) == 0;
+    }
+    resolve_bodies(&pool[0]);
+    for (int k = 1; k < count; k++) {
+        if (!started[k] || pthread_join(threads[k], NULL) != 0) continue;
+
+        absorb_cpu(pool[k].cpu);
+        mem_absorb(&pool[k].mem);
+    }
+}
+
+CompErr resolve_parallel(Analyzer *anz, const FlatAst *ast, int workers) {
+    unsigned funcs = count_funcs(ast);
+
+    if (workers < 2 || ast->stmt_count < MIN_STMTS) return resolve_program(anz, ast);
+    if (workers > MAX_WORKERS) workers = MAX_WORKERS;
+    if ((unsigned)workers > funcs) workers = funcs;
+    if (workers < 2) return resolve_program(anz, ast);
+
+    anz->ast = ast;
+
+    CompilerContext *ctx = anz->ctx;
+    BodyQueue queue      = {.bodies = mem_calloc(funcs, sizeof(Body))};
+    Worker *pool         = mem_calloc(workers, sizeof(Worker));
+    Output first         = {0}; // Output of the serial pass
+    atomic_init(&queue.next, 0);
+
+    bool ready = queue.bodies && pool && open_output(&first, ctx);
+    for (int k = 0; ready && k < workers; k++) {
+        ready = make_worker(&pool[k], anz, &queue, k);
+    }
+    if (!ready) {
+        purge_workers(pool, workers);
+        purge_output(&first);
+        free(queue.bodies);
+        return resolve_program(anz, ast);
+    }
+
+    anz->ctx      = &first.ctx;
+    bool declared = declare_globals(anz, &queue, &first);
+    anz->ctx      = ctx;
+
+    if (declared) run_workers(pool, workers);
+
+    // Merge, the output of each body goes where the serial pass left it
+    close_output(&first);
+    for (int k = 0; k < workers; k++) close_output(&pool[k].out);
+
+    unsigned at = 0;
+    long tat    = 0;
+    for (unsigned i = 0; i < queue.count; i++) {
+        const Body *body = &queue.bodies[i];
+        emit_output(ctx, &first, at, body->before, tat, body->traced);
+        at  = body->before;
+        tat = body->traced;
+
+        if (body->out >= 0) {
+            const Output *out = &pool[body->out].out;
+            emit_output(ctx, out, body->from, body->to, body->tfrom, body->tto);
+        }
+    }
+    emit_output(ctx, &first, at, first.ctx.diags.count, tat, first.tsize);
+
+    // A worker that dropped diagnostics had more than the merged list keeps
+    bool nomem = !declared || first.ctx.err == CERR_NOMEM;
+    ctx->diags.dropped |= first.ctx.diags.dropped;
+    for (int k = 0; k < workers; k++) {
+        nomem    = nomem || pool[k].out.ctx.err == CERR_NOMEM;
+        anz->err = anz->err || pool[k].anz.err;
+        ctx->diags.dropped |= pool[k].out.ctx.diags.dropped;
+    }
+
+    purge_workers(pool, workers);
+    purge_output(&first);
+    free(queue.bodies);
+
+    if (nomem) set_error(ctx, CERR_NOMEM);
+    if (ctx->err == CERR_NOMEM) return CERR_NOMEM;
+    if (anz->err) {
+        set_error(ctx, CERR_SEMANTIC);
+        return CERR_SEMANTIC;
+    }
+    return CERR_OK;
 }
 
 /*********************************************
@@ -1,19 +1,42 @@
 #ifndef _ANALYZER_H
 #define _ANALYZER_H
 
-#include "parser.h"
+#include <setjmp.h>
+
+#include "flat.h"
 #include "symbol.h"
 
 typedef struct Analyzer {
-    SymTab *symtab; // Symbol table
-    int line;       // Current line in the source
-    bool err;       // Error flag
-    Symbol *sym;    // Current symbol
+    CompilerContext *ctx; // Receives semantic errors
+    SymTab *symtab;       // Symbol table
+    SymTab *globals;      // Shared read-only top level symbols while resolving a body in parallel
+    const FlatAst *ast;   // Program being resolved
+    int line;             // Current line in the source
+    unsigned order;       // Top level declaration being resolved, counted from 1
+    bool err;             // Error flag
+    Symbol *sym;          // Current symbol
+    jmp_buf fail;         // Where running out of memory abandons the analysis
+
+    Symbol *builtins[BT_COUNT]; // Builtin type symbols by kind, from `init_symtab`
 } Analyzer;
 
-Analyzer *make_analyzer();
-Symbol *resolve_variable(SymTab *table, char *name, int scope);
-void resolve_program(Analyzer *analyzer, Node *node);
+Analyzer *make_analyzer(CompilerContext *ctx);
+Symbol *resolve_variable(SymTab *table, const Atom *name, int scope);
+CompErr resolve_program(Analyzer *analyzer, const FlatAst *ast);
+
+/**
+ * @brief Resolves the program on up to `workers` threads, same result as
+ * `resolve_program`. A serial pass declares the top level symbols and function
+ * signatures, then the function bodies are resolved in parallel, each thread
+ * with a table of its own for the locals. Diagnostics and trace are merged in
+ * declaration order. Small programs, and programs declaring functions below
+ * the top level, are resolved serially.
+ * @param analyzer
+ * @param ast
+ * @param workers Thread count, including the calling thread.
+ * @return
+ */
+CompErr resolve_parallel(Analyzer *analyzer, const FlatAst *ast, int workers);
 void purge_analyzer(Analyzer *analyzer);
 
 #endif
@@ -0,0 +1,82 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "memstat.h"
+#include "arena.h"
+
+#define BLOCK_SIZE  65536                 // Arena block size in bytes
+#define ARENA_ALIGN _Alignof(max_align_t) // Alignment of every allocation
+
+// Arena storage block, allocations are packed one after another
+struct ArenaBlock {
+    ArenaBlock *next;
+    size_t used;
+    size_t size;
+    _Alignas(max_align_t) char data[];
+};
+
+static size_t align_up(size_t size) {
+    return (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+/**
+ * @brief Adds a block with room for at least `need` bytes. Oversized blocks are
+ * linked behind the current one so it keeps being filled.
+ * @param arena
+ * @param need
+ * @return NULL if memory ran out.
+ */
+static ArenaBlock *add_block(Arena *arena, size_t need) {
+    size_t size = need > BLOCK_SIZE ? need : BLOCK_SIZE;
+
+    ArenaBlock *blk = mem_malloc(sizeof(ArenaBlock) + size);
+    if (!blk) return NULL;
+
+    blk->size = size;
+    blk->used = 0;
+    arena->reserved += size;
+
+    if (size > BLOCK_SIZE && arena->blocks) {
+        blk->next           = arena->blocks->next;
+        arena->blocks->next = blk;
+    } else {
+        blk->next     = arena->blocks;
+        arena->blocks = blk;
+    }
+    return blk;
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+    size_t need     = align_up(size);
+    ArenaBlock *blk = arena->blocks;
+
+    if (!blk || blk->used + need > blk->size) {
+        blk = add_block(arena, need);
+        if (!blk) return NULL;
+    }
+
+    void *ptr = blk->data + blk->used;
+    blk->used += need;
+    arena->used += need;
+    return ptr;
+}
+
+char *arena_strndup(Arena *arena, const char *str, size_t len) {
+    char *copy = arena_alloc(arena, len + 1);
+    if (!copy) return NULL;
+
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+void purge_arena(Arena *arena) {
+    ArenaBlock *blk = arena->blocks;
+    while (blk) {
+        ArenaBlock *next = blk->next;
+        free(blk);
+        blk = next;
+    }
+
+    *arena = (Arena){0};
+}
@@ -0,0 +1,40 @@
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <stddef.h>
+
+typedef struct ArenaBlock ArenaBlock;
+
+// Bump-pointer allocator. Objects are never freed one by one, the whole arena
+// is released at once by `purge_arena`. A zeroed arena is ready to use.
+typedef struct {
+    ArenaBlock *blocks; // Storage blocks, the one being filled first
+    size_t used;        // Bytes handed out, including alignment padding
+    size_t reserved;    // Bytes held by all blocks
+} Arena;
+
+/**
+ * @brief Allocates `size` bytes aligned for any object type.
+ * @param arena
+ * @param size
+ * @return Uninitialized storage, valid until the arena is purged. NULL if
+ * memory ran out.
+ */
+void *arena_alloc(Arena *arena, size_t size);
+
+/**
+ * @brief Copies `len` characters into the arena and null terminates them.
+ * @param arena
+ * @param str
+ * @param len
+ * @return NULL if memory ran out.
+ */
+char *arena_strndup(Arena *arena, const char *str, size_t len);
+
+/**
+ * @brief Frees every block. Previously returned pointers become invalid.
+ * @param arena
+ */
+void purge_arena(Arena *arena);
+
+#endif
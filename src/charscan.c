@@ -0,0 +1,189 @@
+#include <pthread.h>
+#include <stdbool.h>
+
+#include "charscan.h"
+
+#if defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define CHARSCAN_X86
+#endif
+
+/*********************************************
+ * Scalar
+ *********************************************/
+
+static bool isblankc(char c) {
+    return c == ' ' || c == '\t';
+}
+
+static bool isidentc(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+static size_t span_blank_scalar(const char *str, const char *end) {
+    const char *p = str;
+    while (p < end && isblankc(*p)) p++;
+    return p - str;
+}
+
+static size_t span_ident_scalar(const char *str, const char *end) {
+    const char *p = str;
+    while (p < end && isidentc(*p)) p++;
+    return p - str;
+}
+
+static size_t find_either_scalar(const char *str, const char *end, char a, char b) {
+    const char *p = str;
+    while (p < end && *p != a && *p != b) p++;
+    return p - str;
+}
+
+#ifdef CHARSCAN_X86
+
+/*********************************************
+ * SSE2, 16 bytes per step
+ *********************************************/
+
+// Bytes in `lo..lo+n-1`, with a signed compare on values biased by -128
+static __m128i inrange_sse2(__m128i v, char lo, char n) {
+    __m128i t = _mm_add_epi8(_mm_sub_epi8(v, _mm_set1_epi8(lo)), _mm_set1_epi8(-128));
+    return _mm_cmplt_epi8(t, _mm_set1_epi8(-128 + n));
+}
+
+static __m128i isident_sse2(__m128i v) {
+    __m128i alpha = inrange_sse2(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 26);
+    __m128i digit = inrange_sse2(v, '0', 10);
+    __m128i under = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+    return _mm_or_si128(_mm_or_si128(alpha, digit), under);
+}
+
+static size_t span_blank_sse2(const char *str, const char *end) {
+    const char *p = str;
+    for (; p + 16 <= end; p += 16) {
+        __m128i v     = _mm_loadu_si128((const __m128i *)p);
+        __m128i hit   = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                                     _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+        unsigned miss = ~_mm_movemask_epi8(hit) & 0xFFFF;
+        if (miss) return p - str + __builtin_ctz(miss);
+    }
+    return p - str + span_blank_scalar(p, end);
+}
+
+static size_t span_ident_sse2(const char *str, const char *end) {
+    const char *p = str;
+    for (; p + 16 <= end; p += 16) {
+        __m128i v     = _mm_loadu_si128((const __m128i *)p);
+        unsigned miss = ~_mm_movemask_epi8(isident_sse2(v)) & 0xFFFF;
+        if (miss) return p - str + __builtin_ctz(miss);
+    }
+    return p - str + span_ident_scalar(p, end);
+}
+
+static size_t find_either_sse2(const char *str, const char *end, char a, char b) {
+    const char *p = str;
+    for (; p + 16 <= end; p += 16) {
+        __m128i v    = _mm_loadu_si128((const __m128i *)p);
+        __m128i hit  = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(a)),
+                                    _mm_cmpeq_epi8(v, _mm_set1_epi8(b)));
+        unsigned msk = _mm_movemask_epi8(hit);
+        if (msk) return p - str + __builtin_ctz(msk);
+    }
+    return p - str + find_either_scalar(p, end, a, b);
+}
+
+/*********************************************
+ * AVX2, 32 bytes per step
+ *********************************************/
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static __m256i inrange_avx2(__m256i v, char lo, char n) {
+    __m256i t = _mm256_add_epi8(_mm256_sub_epi8(v, _mm256_set1_epi8(lo)), _mm256_set1_epi8(-128));
+    return _mm256_cmpgt_epi8(_mm256_set1_epi8(-128 + n), t);
+}
+
+AVX2 static __m256i isident_avx2(__m256i v) {
+    __m256i alpha = inrange_avx2(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 26);
+    __m256i digit = inrange_avx2(v, '0', 10);
+    __m256i under = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'));
+    return _mm256_or_si256(_mm256_or_si256(alpha, digit), under);
+}
+
+AVX2 static size_t span_blank_avx2(const char *str, const char *end) {
+    const char *p = str;
+    for (; p + 32 <= end; p += 32) {
+        __m256i v     = _mm256_loadu_si256((const __m256i *)p);
+        __m256i hit   = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                                        _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+        unsigned miss = ~(unsigned)_mm256_movemask_epi8(hit);
+        if (miss) return p - str + __builtin_ctz(miss);
+    }
+    return p - str + span_blank_sse2(p, end);
+}
+
+AVX2 static size_t span_ident_avx2(const char *str, const char *end) {
+    const char *p = str;
+    for (; p + 32 <= end; p += 32) {
+        __m256i v     = _mm256_loadu_si256((const __m256i *)p);
+        unsigned miss = ~(unsigned)_mm256_movemask_epi8(isident_avx2(v));
+        if (miss) return p - str + __builtin_ctz(miss);
+    }
+    return p - str + span_ident_sse2(p, end);
+}
+
+AVX2 static size_t find_either_avx2(const char *str, const char *end, char a, char b) {
+    const char *p = str;
+    for (; p + 32 <= end; p += 32) {
+        __m256i v    = _mm256_loadu_si256((const __m256i *)p);
+        __m256i hit  = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(a)),
+                                       _mm256_cmpeq_epi8(v, _mm256_set1_epi8(b)));
+        unsigned msk = _mm256_movemask_epi8(hit);
+        if (msk) return p - str + __builtin_ctz(msk);
+    }
+    return p - str + find_either_sse2(p, end, a, b);
+}
+
+#endif
+
+/*********************************************
+ * Dispatch
+ *********************************************/
+
+typedef struct {
+    size_t (*blank)(const char *str, const char *end);
+    size_t (*ident)(const char *str, const char *end);
+    size_t (*either)(const char *str, const char *end, char a, char b);
+} CharScan;
+
+#ifdef CHARSCAN_X86
+static CharScan impl = {span_blank_sse2, span_ident_sse2, find_either_sse2};
+#else
+static CharScan impl = {span_blank_scalar, span_ident_scalar, find_either_scalar};
+#endif
+
+static pthread_once_t impl_once = PTHREAD_ONCE_INIT;
+
+static void select_impl() {
+#ifdef CHARSCAN_X86
+    if (__builtin_cpu_supports("avx2")) {
+        impl = (CharScan){span_blank_avx2, span_ident_avx2, find_either_avx2};
+    }
+#endif
+}
+
+// Selected once, lexers on other threads may already be scanning with `impl`
+void init_charscan() {
+    pthread_once(&impl_once, select_impl);
+}
+
+size_t span_blank(const char *str, const char *end) {
+    return impl.blank(str, end);
+}
+
+size_t span_ident(const char *str, const char *end) {
+    return impl.ident(str, end);
+}
+
+size_t find_either(const char *str, const char *end, char a, char b) {
+    return impl.either(str, end, a, b);
+}
@@ -0,0 +1,43 @@
+#ifndef _CHARSCAN_H
+#define _CHARSCAN_H
+
+#include <stddef.h>
+
+// Character-class scanning over `[str, end)`. Each function returns the
+// number of leading bytes that belong to the class, so a run is skipped in
+// one call. On x86 runs are matched 16 (SSE2) or 32 (AVX2) bytes at a time,
+// elsewhere a byte at a time. Vector loads never read at or past `end`.
+
+/**
+ * @brief Selects the widest implementation the running CPU supports.
+ * Called by `make_lexer`, only the first call from any thread selects.
+ */
+void init_charscan();
+
+/**
+ * @brief Length of the leading run of blanks (space, tab).
+ * @param str
+ * @param end
+ * @return
+ */
+size_t span_blank(const char *str, const char *end);
+
+/**
+ * @brief Length of the leading run of identifier characters ([A-Za-z0-9_]).
+ * @param str
+ * @param end
+ * @return
+ */
+size_t span_ident(const char *str, const char *end);
+
+/**
+ * @brief Offset of the first `a` or `b`, or `end - str` if neither occurs.
+ * @param str
+ * @param end
+ * @param a
+ * @param b
+ * @return
+ */
+size_t find_either(const char *str, const char *end, char a, char b);
+
+#endif
@@ -0,0 +1,64 @@
+#include <stdlib.h>
+
+#include "memstat.h"
+#include "context.h"
+
+#define MAX_ERRORS 20 // Default limit of diagnostics kept, later ones are dropped
+
+CompilerContext *make_context() {
+    CompilerContext *ctx = mem_calloc(1, sizeof(CompilerContext));
+    if (!ctx) return NULL;
+
+    ctx->diags.limit = MAX_ERRORS;
+    ctx->trace       = stdout;
+    return ctx;
+}
+
+void purge_context(CompilerContext *ctx) {
+    if (ctx) {
+        purge_interner(&ctx->interner);
+        purge_types(&ctx->types);
+        purge_diags(&ctx->diags);
+        free(ctx);
+    }
+}
+
+void set_error(CompilerContext *ctx, CompErr err) {
+    if (ctx->err == CERR_OK) ctx->err = err;
+}
+
+/**
+ * @brief Adds a diagnostic, a full list drops it silently.
+ * @param ctx
+ * @param line
+ * @param col
+ * @param fmt
+ * @param args
+ */
+static void add_error(CompilerContext *ctx, int line, int col, const char *fmt, va_list args) {
+    if (!vadd_diag(&ctx->diags, line, col, fmt, args) && !diags_full(&ctx->diags)) {
+        set_error(ctx, CERR_NOMEM);
+    }
+}
+
+void report_error(CompilerContext *ctx, int line, int col, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    add_error(ctx, line, col, fmt, args);
+    va_end(args);
+}
+
+void fail_context(CompilerContext *ctx, CompErr err, const char *fmt, ...) {
+    set_error(ctx, err);
+
+    // Kept past the limit, it explains why the compilation stopped
+    unsigned limit   = ctx->diags.limit;
+    ctx->diags.limit = 0;
+
+    va_list args;
+    va_start(args, fmt);
+    vadd_diag(&ctx->diags, 0, 0, fmt, args);
+    va_end(args);
+
+    ctx->diags.limit = limit;
+}
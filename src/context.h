@@ -0,0 +1,69 @@
+#ifndef _CONTEXT_H
+#define _CONTEXT_H
+
+#include "diag.h"
+#include "intern.h"
+#include "types.h"
+
+// Compilation error, the first one reported is kept
+typedef enum {
+    CERR_OK,       // Ok
+    CERR_IO,       // Source could not be opened or read
+    CERR_NOMEM,    // Memory ran out
+    CERR_SYNTAX,   // Parser reported errors
+    CERR_SEMANTIC, // Analyzer reported errors
+    CERR_IR,       // Program could not be lowered, or its IR is invalid
+} CompErr;
+
+// State of one compilation. Everything the phases share lives here instead of
+// in globals, so independent compilations can run concurrently, one context
+// per thread. Atoms from one context must not be mixed with another's.
+typedef struct CompilerContext {
+    Interner interner; // Names of every phase
+    TypeTable types;   // Canonical types of every phase
+    DiagList diags;    // Diagnostics of every phase, in report order
+    CompErr err;       // First error, `CERR_OK` while there is none
+    FILE *trace;       // Analyzer progress output, NULL for none
+} CompilerContext;
+
+/**
+ * @brief Creates an empty context that traces to stdout.
+ * @return NULL if memory ran out.
+ */
+CompilerContext *make_context();
+
+/**
+ * @brief Frees the context with every atom, type and diagnostic it holds.
+ * @param ctx
+ */
+void purge_context(CompilerContext *ctx);
+
+/**
+ * @brief Records `err` unless an earlier error is already recorded.
+ * @param ctx
+ * @param err
+ */
+void set_error(CompilerContext *ctx, CompErr err);
+
+/**
+ * @brief Records a diagnostic at a source position, a line or column of 0
+ * leaves it out. Running out of memory for it is recorded as `CERR_NOMEM`.
+ * @param ctx
+ * @param line
+ * @param col
+ * @param fmt printf style format of the message.
+ */
+void report_error(CompilerContext *ctx, int line, int col, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+/**
+ * @brief Records `err` together with a diagnostic without position, for
+ * failures that end a phase early.
+ * @param ctx
+ * @param err
+ * @param fmt printf style format of the message.
+ */
+void fail_context(CompilerContext *ctx, CompErr err, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+#endif
@@ -0,0 +1,70 @@
+#include <stdlib.h>
+
+#include "memstat.h"
+#include "diag.h"
+
+#define MSG_SIZE 256 // Longest diagnostic message, longer ones are truncated
+
+bool vadd_diag(DiagList *list, int line, int col, const char *fmt, va_list args) {
+    if (diags_full(list)) {
+        list->dropped = true;
+        return false;
+    }
+
+    if (list->count == list->capacity) {
+        unsigned capacity = list->capacity ? list->capacity * 2 : 16;
+        Diag *items       = mem_realloc(list->items, capacity * sizeof(Diag));
+        if (!items) return false;
+
+        list->items    = items;
+        list->capacity = capacity;
+    }
+
+    char *msg = mem_malloc(MSG_SIZE);
+    if (!msg) return false;
+
+    vsnprintf(msg, MSG_SIZE, fmt, args);
+
+    list->items[list->count++] = (Diag){.line = line, .col = col, .msg = msg};
+    return true;
+}
+
+bool add_diag(DiagList *list, int line, int col, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    bool added = vadd_diag(list, line, col, fmt, args);
+    va_end(args);
+    return added;
+}
+
+bool diags_full(const DiagList *list) {
+    return list->limit && list->count >= list->limit;
+}
+
+void print_diags(const DiagList *list, FILE *out) {
+    for (unsigned i = 0; i < list->count; i++) {
+        const Diag *diag = &list->items[i];
+        if (diag->col) {
+            fprintf(out, "Error (line %d, col %d): %s\n", diag->line, diag->col, diag->msg);
+        } else if (diag->line) {
+            fprintf(out, "Error (line %d): %s\n", diag->line, diag->msg);
+        } else {
+            fprintf(out, "Error: %s\n", diag->msg);
+        }
+    }
+
+    if (list->dropped) {
+        fprintf(out, "Error: too many errors, only the first %u are shown\n", list->limit);
+    }
+}
+
+void purge_diags(DiagList *list) {
+    for (unsigned i = 0; i < list->count; i++) {
+        free(list->items[i].msg);
+    }
+    free(list->items);
+
+    list->items    = NULL;
+    list->count    = 0;
+    list->capacity = 0;
+}
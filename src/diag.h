@@ -0,0 +1,68 @@
+#ifndef _DIAG_H
+#define _DIAG_H
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// Diagnostic message and the source position it refers to
+typedef struct {
+    int line;  // 0 for diagnostics without a position
+    int col;   // 0 when only the line is known
+    char *msg; // Formatted message, owned by the list
+} Diag;
+
+// Diagnostics in the order they were reported
+typedef struct {
+    Diag *items;
+    unsigned count;
+    unsigned capacity;
+    unsigned limit; // Most diagnostics kept, 0 for no limit
+    bool dropped;   // A diagnostic was rejected at the limit, or never reported
+} DiagList;
+
+/**
+ * @brief Records a diagnostic unless the list is full.
+ * @param list
+ * @param line
+ * @param col
+ * @param fmt printf style format of the message.
+ * @return false when the diagnostic was dropped, because the list is full or
+ * memory ran out.
+ */
+bool add_diag(DiagList *list, int line, int col, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+/**
+ * @brief `add_diag` taking the message arguments as a `va_list`.
+ * @param list
+ * @param line
+ * @param col
+ * @param fmt
+ * @param args
+ * @return
+ */
+bool vadd_diag(DiagList *list, int line, int col, const char *fmt, va_list args);
+
+/**
+ * @brief Checks whether the list has reached its limit.
+ * @param list
+ * @return
+ */
+bool diags_full(const DiagList *list);
+
+/**
+ * @brief Prints every diagnostic, one per line, then a note if any were
+ * dropped at the limit.
+ * @param list
+ * @param out
+ */
+void print_diags(const DiagList *list, FILE *out);
+
+/**
+ * @brief Frees every diagnostic, the list stays usable.
+ * @param list
+ */
+void purge_diags(DiagList *list);
+
+#endif
@@ -0,0 +1,522 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "memstat.h"
+#include "flat.h"
+
+#define INITIAL_POOL 64 // Initial pool capacity in entries
+
+/*********************************************
+ * Pool Management
+ *********************************************/
+
+/**
+ * @brief Makes room for `n` more entries in a pool holding `count` entries.
+ * Running out of memory abandons the conversion.
+ * @param ast
+ * @param items
+ * @param count
+ * @param cap Pool capacity, updated when the pool grows.
+ * @param size Entry size.
+ * @param n
+ * @return The pool, possibly moved.
+ */
+static void *grow_pool(
+    FlatAst *ast, void *items, uint32_t count, uint32_t *cap, size_t size, uint32_t n
+) {
+    if (count + n <= *cap) return items;
+
+    uint32_t want = *cap ? *cap : INITIAL_POOL;
+    while (want < count + n) want *= 2;
+
+    items = mem_realloc(items, want * size);
+    if (!items) longjmp(*ast->fail, 1);
+
+    *cap = want;
+    return items;
+}
+
+static NodeRef new_type(FlatAst *ast) {
+    ast->types = grow_pool(ast, ast->types, ast->type_count, &ast->type_cap, sizeof(FlatType), 1);
+    return ast->type_count++;
+}
+
+static NodeRef new_decl(FlatAst *ast) {
+    ast->decls = grow_pool(ast, ast->decls, ast->decl_count, &ast->decl_cap, sizeof(FlatDecl), 1);
+    return ast->decl_count++;
+}
+
+static NodeRef new_block(FlatAst *ast) {
+    ast->blocks =
+        grow_pool(ast, ast->blocks, ast->block_count, &ast->block_cap, sizeof(FlatBlock), 1);
+    return ast->block_count++;
+}
+
+static NodeRef new_stmt(FlatAst *ast) {
+    ast->stmts = grow_pool(ast, ast->stmts, ast->stmt_count, &ast->stmt_cap, sizeof(FlatStmt), 1);
+    return ast->stmt_count++;
+}
+
+static NodeRef new_expr(FlatAst *ast) {
+    ast->exprs = grow_pool(ast, ast->exprs, ast->expr_count, &ast->expr_cap, sizeof(FlatExpr), 1);
+    return ast->expr_count++;
+}
+
+/**
+ * @brief Reserves `n` consecutive `extra` entries.
+ * @param ast
+ * @param n
+ * @return Index of the first entry.
+ */
+static uint32_t new_extra(FlatAst *ast, uint32_t n) {
+    ast->extra = grow_pool(ast, ast->extra, ast->extra_count, &ast->extra_cap, sizeof(uint32_t), n);
+
+    uint32_t at = ast->extra_count;
+    ast->extra_count += n;
+    return at;
+}
+
+/**
+ * @brief Reserves a child list of `count` entries, filled in by the caller.
+ * @param ast
+ * @param count
+ * @return List index, 0 for an empty list.
+ */
+static uint32_t new_list(FlatAst *ast, uint32_t count) {
+    if (!count) return 0;
+
+    uint32_t list    = new_extra(ast, count + 1);
+    ast->extra[list] = count;
+    return list;
+}
+
+/*********************************************
+ * Conversion
+ *
+ * Children are converted before their parent's entry is written, and pools
+ * may move while they are, so entries are addressed by index throughout.
+ *********************************************/
+
+static void flatten_types(FlatAst *ast, const TypeTable *tt);
+static NodeRef flatten_type(FlatAst *ast, const Type *type);
+static NodeRef flatten_decl(FlatAst *ast, const Decl *decl);
+static NodeRef flatten_block(FlatAst *ast, const Block *block);
+static NodeRef flatten_stmt(FlatAst *ast, const Stmt *stmt);
+static NodeRef flatten_expr(FlatAst *ast, const Expr *expr);
+static NodeRef flatten_optexpr(FlatAst *ast, const Expr *expr);
+static NodeRef flatten_optstmt(FlatAst *ast, const Stmt *stmt);
+
+FlatAst *flatten_program(CompilerContext *ctx, const Program *prog) {
+    FlatAst *ast = mem_calloc(1, sizeof(FlatAst));
+    if (!ast) {
+        fail_context(ctx, CERR_NOMEM, "flat AST allocation failed");
+        return NULL;
+    }
+
+    jmp_buf fail;
+    if (setjmp(fail)) {
+        fail_context(ctx, CERR_NOMEM, "flat AST allocation failed");
+        purge_flat(ast);
+        return NULL;
+    }
+    ast->fail = &fail;
+
+    uint32_t empty    = new_extra(ast, 1); // List 0, the empty list
+    ast->extra[empty] = 0;
+
+    flatten_types(ast, &ctx->types);
+
+    ast->program = new_list(ast, prog->decl_count);
+    for (unsigned i = 0; i < prog->decl_count; i++) {
+        NodeRef decl                     = flatten_decl(ast, prog->decls[i]);
+        ast->extra[ast->program + 1 + i] = decl;
+    }
+
+    ast->fail = NULL;
+    return ast;
+}
+
+/**
+ * @brief Converts every canonical type, in id order. The parts of a type have
+ * smaller ids, so they are converted before it.
+ * @param ast
+ * @param tt
+ */
+static void flatten_types(FlatAst *ast, const TypeTable *tt) {
+    for (unsigned i = 0; i < tt->count; i++) {
+        const Type *type = tt->types[i];
+        FlatType ft      = {.kind = type->type_kind};
+
+        switch (type->type_kind) {
+        case TY_PTR: ft.ref = type->ptr.ref->id; break;
+        case TY_FUNC:
+            ft.func.ret    = type->func.ret->id;
+            ft.func.params = new_list(ast, type->func.param_count);
+            for (unsigned k = 0; k < type->func.param_count; k++) {
+                ast->extra[ft.func.params + 1 + k] = type->func.params[k]->id;
+            }
+            break;
+        default: break;
+        }
+
+        NodeRef idx     = new_type(ast);
+        ast->types[idx] = ft;
+    }
+}
+
+// Types were all converted up front, a type's entry is its id
+static NodeRef flatten_type(FlatAst *ast, const Type *type) {
+    (void)ast;
+    return type ? type->id : NO_NODE;
+}
+
+static NodeRef flatten_decl(FlatAst *ast, const Decl *decl) {
+    FlatDecl fd = {
+        .name  = decl->name,
+        .type  = flatten_type(ast, decl->type),
+        .line  = decl->base.line,
+        .class = decl->class,
+    };
+
+    if (decl->type && decl->type->type_kind == TY_FUNC) {
+        fd.func.params = new_list(ast, decl->func.param_count);
+        for (unsigned i = 0; i < decl->func.param_count; i++) {
+            NodeRef param                      = flatten_decl(ast, decl->func.params[i]);
+            ast->extra[fd.func.params + 1 + i] = param;
+        }
+        fd.func.body = decl->func.body ? flatten_block(ast, decl->func.body) : NO_NODE;
+    } else {
+        fd.var.init = flatten_optexpr(ast, decl->var.init);
+    }
+
+    NodeRef idx     = new_decl(ast);
+    ast->decls[idx] = fd;
+    return idx;
+}
+
+static NodeRef flatten_block(FlatAst *ast, const Block *block) {
+    uint32_t items = new_list(ast, block->item_count);
+
+    for (unsigned i = 0; i < block->item_count; i++) {
+        Node *node = block->items[i];
+        NodeRef item;
+
+        if (node->node_type == NODE_DECL) {
+            item = flatten_decl(ast, (const Decl *)node);
+        } else {
+            item = flatten_stmt(ast, (const Stmt *)node) | ITEM_STMT;
+        }
+        ast->extra[items + 1 + i] = item;
+    }
+
+    NodeRef idx      = new_block(ast);
+    ast->blocks[idx] = (FlatBlock){.line = block->base.line, .items = items};
+    return idx;
+}
+
+static NodeRef flatten_optexpr(FlatAst *ast, const Expr *expr) {
+    return expr ? flatten_expr(ast, expr) : NO_NODE;
+}
+
+static NodeRef flatten_optstmt(FlatAst *ast, const Stmt *stmt) {
+    return stmt ? flatten_stmt(ast, stmt) : NO_NODE;
+}
+
+static NodeRef flatten_stmt(FlatAst *ast, const Stmt *stmt) {
+    FlatStmt fs = {.kind = stmt->stmt_type, .line = stmt->base.line};
+
+    switch (stmt->stmt_type) {
+    case STMT_RETURN:   fs.expr = flatten_optexpr(ast, stmt->_return.expr); break;
+    case STMT_EXPR:     fs.expr = flatten_optexpr(ast, stmt->expr); break;
+    case STMT_COMPOUND: fs.block = flatten_block(ast, stmt->compound.block); break;
+    case STMT_IF:
+        fs._if.cond  = flatten_expr(ast, stmt->_if.cond);
+        fs._if.then  = flatten_stmt(ast, stmt->_if.then);
+        fs._if.else_ = flatten_optstmt(ast, stmt->_if.else_);
+        break;
+    case STMT_WHILE:
+    case STMT_DO_WHILE:
+        fs._while.cond = flatten_expr(ast, stmt->_while.cond);
+        fs._while.body = flatten_stmt(ast, stmt->_while.body);
+        break;
+    case STMT_FOR:
+        fs._for.init = stmt->_for.init ? flatten_decl(ast, stmt->_for.init) : NO_NODE;
+        fs._for.cond = flatten_optexpr(ast, stmt->_for.cond);
+        fs._for.post = flatten_optexpr(ast, stmt->_for.post);
+        fs._for.body = flatten_stmt(ast, stmt->_for.body);
+        break;
+    case STMT_BREAK:
+    case STMT_CONTINUE: break;
+    }
+
+    NodeRef idx     = new_stmt(ast);
+    ast->stmts[idx] = fs;
+    return idx;
+}
+
+static NodeRef flatten_expr(FlatAst *ast, const Expr *expr) {
+    FlatExpr fe = {.kind = expr->expr_type, .line = expr->base.line};
+
+    switch (expr->expr_type) {
+    case EXPR_CONST:
+        fe.op = expr->constant.const_type;
+        switch (expr->constant.const_type) {
+        case CONST_INT:   fe.ival = expr->constant.ival; break;
+        case CONST_FLOAT: fe.fval = expr->constant.fval; break;
+        case CONST_STR:   fe.sval = expr->constant.sval; break;
+        }
+        break;
+    case EXPR_VAR: fe.name = expr->variable.name; break;
+    case EXPR_UNARY:
+        fe.op      = expr->unary.op;
+        fe.operand = flatten_expr(ast, expr->unary.expr);
+        break;
+    case EXPR_BINARY:
+        fe.op           = expr->binary.op;
+        fe.binary.left  = flatten_expr(ast, expr->binary.left);
+        fe.binary.right = flatten_expr(ast, expr->binary.right);
+        break;
+    case EXPR_ASSIGN:
+        fe.binary.left  = flatten_expr(ast, expr->assignment.left);
+        fe.binary.right = flatten_expr(ast, expr->assignment.right);
+        break;
+    case EXPR_CALL:
+        fe.call.func = flatten_expr(ast, expr->call.func);
+        fe.call.args = new_list(ast, expr->call.arg_count);
+        for (unsigned i = 0; i < expr->call.arg_count; i++) {
+            NodeRef arg                      = flatten_expr(ast, expr->call.args[i]);
+            ast->extra[fe.call.args + 1 + i] = arg;
+        }
+        break;
+    case EXPR_TERNARY: {
+        uint32_t ops        = new_extra(ast, 3);
+        NodeRef left        = flatten_expr(ast, expr->conditional.left);
+        NodeRef middle      = flatten_expr(ast, expr->conditional.middle);
+        NodeRef right       = flatten_expr(ast, expr->conditional.right);
+        ast->extra[ops]     = left;
+        ast->extra[ops + 1] = middle;
+        ast->extra[ops + 2] = right;
+        fe.conditional      = ops;
+        break;
+    }
+    case EXPR_CAST:
+        fe.cast.type = flatten_type(ast, expr->cast.type);
+        fe.cast.expr = flatten_expr(ast, expr->cast.expr);
+        break;
+    }
+
+    NodeRef idx     = new_expr(ast);
+    ast->exprs[idx] = fe;
+    return idx;
+}
+
+/*********************************************
+ * Cleanup Functions
+ *********************************************/
+
+size_t flat_size(const FlatAst *ast) {
+    return ast->type_count * sizeof(FlatType) + ast->decl_count * sizeof(FlatDecl) +
+           ast->block_count * sizeof(FlatBlock) + ast->stmt_count * sizeof(FlatStmt) +
+           ast->expr_count * sizeof(FlatExpr) + ast->extra_count * sizeof(uint32_t);
+}
+
+void purge_flat(FlatAst *ast) {
+    if (ast) {
+        free(ast->types);
+        free(ast->decls);
+        free(ast->blocks);
+        free(ast->stmts);
+        free(ast->exprs);
+        free(ast->extra);
+        free(ast);
+    }
+}
+
+/*********************************************
+ * Printing, mirrors the pointer tree printer
+ *********************************************/
+
+static void print_item(const FlatAst *ast, NodeRef item, int indent);
+static void print_fdecl(const FlatAst *ast, NodeRef idx, int indent);
+static void print_ftype(const FlatAst *ast, NodeRef idx, int indent);
+static void print_fblock(const FlatAst *ast, NodeRef idx, int indent);
+static void print_fstmt(const FlatAst *ast, NodeRef idx, int indent);
+static void print_fexpr(const FlatAst *ast, NodeRef idx, int indent);
+
+static void print_indent(int indent) {
+    for (int i = 0; i < indent; i++) {
+        printf("  ");
+    }
+}
+
+void print_flat(const FlatAst *ast) {
+    printf("Program:\n");
+
+    const NodeRef *decls = flat_items(ast, ast->program);
+    for (uint32_t i = 0; i < flat_count(ast, ast->program); i++) {
+        print_fdecl(ast, decls[i], 1);
+    }
+}
+
+static void print_item(const FlatAst *ast, NodeRef item, int indent) {
+    if (item & ITEM_STMT) {
+        print_fstmt(ast, item & ~ITEM_STMT, indent);
+    } else {
+        print_fdecl(ast, item, indent);
+    }
+}
+
+static void print_fdecl(const FlatAst *ast, NodeRef idx, int indent) {
+    const FlatDecl *decl = &ast->decls[idx];
+    bool func            = decl->type != NO_NODE && ast->types[decl->type].kind == TY_FUNC;
+
+    print_indent(indent);
+    printf("Declaration: %s\n", decl->name ? decl->name->str : "(anonymous)");
+
+    print_indent(indent + 1);
+    printf("Type:\n");
+    print_ftype(ast, decl->type, indent + 2);
+
+    if (decl->type != NO_NODE && !func && decl->var.init != NO_NODE) {
+        print_indent(indent + 1);
+        printf("Initializer:\n");
+        print_fexpr(ast, decl->var.init, indent + 2);
+    }
+
+    if (func && flat_count(ast, decl->func.params) > 0) {
+        const NodeRef *params = flat_items(ast, decl->func.params);
+        uint32_t count        = flat_count(ast, decl->func.params);
+
+        print_indent(indent + 1);
+        printf("Parameters (%u):\n", count);
+        for (uint32_t i = 0; i < count; i++) {
+            if (ast->decls[params[i]].type != NO_NODE) {
+                print_fdecl(ast, params[i], indent + 2);
+            } else {
+                print_indent(indent + 2);
+                printf("INVALID PARAMETER\n");
+            }
+        }
+    }
+
+    if (func && decl->func.body != NO_NODE) {
+        print_indent(indent + 1);
+        printf("Body:\n");
+        print_fblock(ast, decl->func.body, indent + 2);
+    }
+}
+
+static void print_ftype(const FlatAst *ast, NodeRef idx, int indent) {
+    print_indent(indent);
+    if (idx == NO_NODE) {
+        printf("NULL TYPE\n");
+        return;
+    }
+
+    const FlatType *type = &ast->types[idx];
+    printf("%s", typekind_str(type->kind));
+
+    switch (type->kind) {
+    case TY_PTR:
+        printf(" to:\n");
+        print_ftype(ast, type->ref, indent + 1);
+        break;
+    case TY_FUNC:
+        printf(" returning:\n");
+        print_ftype(ast, type->func.ret, indent + 1);
+        if (flat_count(ast, type->func.params) > 0) {
+            const NodeRef *params = flat_items(ast, type->func.params);
+            uint32_t count        = flat_count(ast, type->func.params);
+
+            print_indent(indent);
+            printf("Parameters (%u):\n", count);
+            for (uint32_t i = 0; i < count; i++) {
+                print_ftype(ast, params[i], indent + 1);
+            }
+        }
+        break;
+    default: printf("\n");
+    }
+}
+
+static void print_fblock(const FlatAst *ast, NodeRef idx, int indent) {
+    const FlatBlock *block = &ast->blocks[idx];
+    const NodeRef *items   = flat_items(ast, block->items);
+    uint32_t count         = flat_count(ast, block->items);
+
+    print_indent(indent);
+    printf("Block (%u items):\n", count);
+    for (uint32_t i = 0; i < count; i++) {
+        print_item(ast, items[i], indent + 1);
+    }
+}
+
+static void print_fstmt(const FlatAst *ast, NodeRef idx, int indent) {
+    const FlatStmt *stmt = &ast->stmts[idx];
+
+    print_indent(indent);
+    printf("Statement (%s):\n", stmttype_str(stmt->kind));
+
+    switch (stmt->kind) {
+    case STMT_COMPOUND: print_fblock(ast, stmt->block, indent + 1); break;
+    case STMT_RETURN:
+        print_indent(indent + 1);
+        printf("Return:\n");
+        print_fexpr(ast, stmt->expr, indent + 2);
+        break;
+    case STMT_EXPR: print_fexpr(ast, stmt->expr, indent + 1); break;
+    }
+}
+
+static void print_fexpr(const FlatAst *ast, NodeRef idx, int indent) {
+    const FlatExpr *expr = &ast->exprs[idx];
+
+    print_indent(indent);
+    printf("Expression: ");
+
+    switch (expr->kind) {
+    case EXPR_CONST:
+        printf("%s: ", consttype_str(expr->op));
+        switch (expr->op) {
+        case CONST_INT:   printf("%d\n", expr->ival); break;
+        case CONST_FLOAT: printf("%.4f\n", expr->fval); break;
+        case CONST_STR:
+            if (expr->sval) {
+                printf("\"%s\"\n", expr->sval);
+            } else {
+                printf("(null string)\n");
+            }
+            break;
+        }
+        break;
+
+    case EXPR_VAR: printf("Variable: %s\n", expr->name->str); break;
+
+    case EXPR_UNARY:
+        printf("Unary %s:\n", unop_str(expr->op));
+        print_fexpr(ast, expr->operand, indent + 1);
+        break;
+
+    case EXPR_BINARY:
+        printf("Binary %s:\n", binop_str(expr->op));
+        print_fexpr(ast, expr->binary.left, indent + 1);
+        print_fexpr(ast, expr->binary.right, indent + 1);
+        break;
+
+    case EXPR_CALL: {
+        const NodeRef *args = flat_items(ast, expr->call.args);
+        uint32_t count      = flat_count(ast, expr->call.args);
+
+        printf("Call:\n");
+        print_indent(indent + 1);
+        printf("Function:\n");
+        print_fexpr(ast, expr->call.func, indent + 2);
+        print_indent(indent + 1);
+        printf("Arguments (%u):\n", count);
+        for (uint32_t i = 0; i < count; i++) {
+            print_fexpr(ast, args[i], indent + 2);
+        }
+        break;
+    }
+    }
+}
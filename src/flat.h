@@ -0,0 +1,173 @@
+#ifndef _FLAT_H
+#define _FLAT_H
+
+#include <setjmp.h>
+#include <stdint.h>
+
+#include "parser.h"
+
+/*
+ * Flat AST. Nodes of each kind live in one contiguous pool and refer to each
+ * other by 32-bit pool indices. Variable length child lists are stored in the
+ * shared `extra` array as a count followed by that many indices, and a node
+ * holds the `extra` index of its list. List 0 is always the empty list.
+ */
+
+typedef uint32_t NodeRef; // Index into the pool of the referenced node's kind
+
+#define NO_NODE   UINT32_MAX  // Absent optional child
+#define ITEM_STMT 0x80000000u // Block item tag, set on statements and clear on declarations
+
+// Type, entry `i` of the pool is the context's canonical type of id `i`, so
+// two type references are equal if and only if the types are
+typedef struct {
+    uint8_t kind; // `TypeKind`
+    union {
+        NodeRef ref; // TY_PTR: referenced type
+        struct {     // TY_FUNC
+            NodeRef ret;
+            uint32_t params; // List of parameter types
+        } func;
+    };
+} FlatType;
+
+typedef struct {
+    const Atom *name;
+    NodeRef type;
+    int line;
+    uint8_t class; // `StgClass`
+    union {
+        struct {             // Function declaration
+            uint32_t params; // List of parameter declarations
+            NodeRef body;    // Body block or `NO_NODE`
+        } func;
+        struct {           // Variable declaration
+            NodeRef init;  // Initializer or `NO_NODE`
+        } var;
+    };
+} FlatDecl;
+
+typedef struct {
+    int line;
+    uint32_t items; // List of declarations and `ITEM_STMT` tagged statements
+} FlatBlock;
+
+typedef struct {
+    uint8_t kind; // `StmtType`
+    int line;
+    union {
+        NodeRef expr;  // Return value or expression statement
+        NodeRef block; // Compound block
+        struct {
+            NodeRef cond;
+            NodeRef then;
+            NodeRef else_; // `NO_NODE` without an else branch
+        } _if;
+        struct { // While/Do-while
+            NodeRef cond;
+            NodeRef body;
+        } _while;
+        struct { // For, optional parts are `NO_NODE`, `init` is a declaration
+            NodeRef init;
+            NodeRef cond;
+            NodeRef post;
+            NodeRef body;
+        } _for;
+    };
+} FlatStmt;
+
+typedef struct {
+    uint8_t kind; // `ExprType`
+    uint8_t op;   // `ConstType`, `UnOp` or `BinOp` by kind
+    int line;
+    union {
+        int ival;
+        double fval;
+        const char *sval; // Owned by the parser's arena
+        const Atom *name; // Variable
+        NodeRef operand;  // Unary
+        struct {          // Binary and assignment
+            NodeRef left;
+            NodeRef right;
+        } binary;
+        struct {
+            NodeRef func;
+            uint32_t args; // List of arguments
+        } call;
+        struct {
+            NodeRef type;
+            NodeRef expr;
+        } cast;
+        uint32_t conditional; // `extra` index of the left, middle and right operands
+    };
+} FlatExpr;
+
+typedef struct {
+    FlatType *types;
+    FlatDecl *decls;
+    FlatBlock *blocks;
+    FlatStmt *stmts;
+    FlatExpr *exprs;
+    uint32_t *extra;  // Child lists
+    uint32_t program; // List of top level declarations
+
+    // Pool lengths and allocated capacities
+    uint32_t type_count, type_cap;
+    uint32_t decl_count, decl_cap;
+    uint32_t block_count, block_cap;
+    uint32_t stmt_count, stmt_cap;
+    uint32_t expr_count, expr_cap;
+    uint32_t extra_count, extra_cap;
+
+    jmp_buf *fail; // Where running out of memory abandons `flatten_program`
+} FlatAst;
+
+/**
+ * @brief Converts a parsed program into a flat AST. String constants still point
+ * into the parser's arena, so the parser must outlive the result.
+ * @param ctx
+ * @param prog
+ * @return NULL if memory ran out.
+ */
+FlatAst *flatten_program(CompilerContext *ctx, const Program *prog);
+
+/**
+ * @brief Frees a flat AST.
+ * @param ast
+ */
+void purge_flat(FlatAst *ast);
+
+/**
+ * @brief Bytes used by the node pools and child lists.
+ * @param ast
+ * @return
+ */
+size_t flat_size(const FlatAst *ast);
+
+/**
+ * @brief Prints a flat AST in the same format as `print_ast`.
+ * @param ast
+ */
+void print_flat(const FlatAst *ast);
+
+/**
+ * @brief Number of entries in a child list.
+ * @param ast
+ * @param list
+ * @return
+ */
+static inline uint32_t flat_count(const FlatAst *ast, uint32_t list) {
+    return ast->extra[list];
+}
+
+/**
+ * @brief Entries of a child list.
+ * @param ast
+ * @param list
+ * @return
+ */
+static inline const NodeRef *flat_items(const FlatAst *ast, uint32_t list) {
+    return ast->extra + list + 1;
+}
+
+#endif
@@ -0,0 +1,377 @@
+#include <math.h>
+#include <stdlib.h>
+
+#include "memstat.h"
+#include "fold.h"
+
+/*
+ * Folding runs over finished function bodies. Blocks are in reverse
+ * postorder, so every operand but a phi's is visited before its use, already
+ * folded. An instruction whose value is known becomes a constant in place,
+ * one that equals another value is replaced by it. What no store, call or
+ * terminator needs any longer is then dropped and the body renumbered.
+ */
+
+static bool is_arith_op(IrOp op) {
+    return op >= IR_ADD && op <= IR_MOD;
+}
+
+static bool is_compare_op(IrOp op) {
+    return op >= IR_EQ && op <= IR_GE;
+}
+
+static bool is_unary_op(IrOp op) {
+    return op == IR_NEG || op == IR_NOT || op == IR_CONV || op == IR_SHL;
+}
+
+/**
+ * @brief Operands of an instruction, stored one after another.
+ * @param fn
+ * @param inst
+ * @param ops Receives the first operand.
+ * @return Number of operands.
+ */
+static uint32_t operands(IrFunc *fn, IrInst *inst, IrRef **ops) {
+    switch (inst->op) {
+    case IR_PHI:
+    case IR_CALL:  *ops = &fn->extra[inst->arg + 1]; return fn->extra[inst->arg];
+    case IR_STORE: *ops = &inst->arg; return 1;
+    case IR_RET:   *ops = inst->ops; return inst->ops[0] != IR_NONE;
+    case IR_NEG:
+    case IR_NOT:
+    case IR_CONV:
+    case IR_SHL:   // `ops[1]` is a count
+    case IR_BR:    *ops = inst->ops; return 1;
+    default:
+        *ops = inst->ops;
+        return is_arith_op(inst->op) || is_compare_op(inst->op) ? 2 : 0;
+    }
+}
+
+/**
+ * @brief Whether an instruction is kept even if its value is unused.
+ * @param op
+ * @return
+ */
+static bool has_effect(IrOp op) {
+    return op == IR_STORE || op == IR_CALL || op >= IR_JMP;
+}
+
+/**
+ * @brief Wraps an integer result to the width of its type.
+ * @param type
+ * @param value
+ * @return
+ */
+static int32_t wrap(uint8_t type, int64_t value) {
+    switch (type) {
+    case IT_BOOL: return value != 0;
+    case IT_CHAR: return (int8_t)value;
+    default:      return (int32_t)(uint32_t)value;
+    }
+}
+
+/**
+ * @brief Whether an instruction is an arithmetic constant of `value`.
+ * @param inst
+ * @param value
+ * @return
+ */
+static bool is_value(const IrInst *inst, int value) {
+    if (inst->op != IR_CONST || inst->type == IT_STRING) return false;
+
+    return inst->type == IT_FLOAT ? inst->fval == value : inst->ival == value;
+}
+
+/**
+ * @brief Exponent of an integer constant that is a power of two.
+ * @param inst
+ * @return `k` if the constant is `2^k` with `k >= 1`, 0 otherwise.
+ */
+static uint32_t shift_count(const IrInst *inst) {
+    if (inst->op != IR_CONST || inst->type == IT_FLOAT || inst->type == IT_STRING) return 0;
+
+    int32_t value = inst->ival;
+    return value >= 2 && !(value & (value - 1)) ? __builtin_ctz(value) : 0;
+}
+
+/**
+ * @brief Turns an instruction into an integer constant.
+ * @param inst
+ * @param value Wrapped to the instruction's type already.
+ */
+static void set_int(IrInst *inst, int32_t value) {
+    inst->op   = IR_CONST;
+    inst->ival = value;
+}
+
+/**
+ * @brief Turns an instruction into a float constant.
+ * @param inst
+ * @param value
+ */
+static void set_float(IrInst *inst, double value) {
+    inst->op   = IR_CONST;
+    inst->fval = value;
+}
+
+/**
+ * @brief Evaluates a negation, logical not, shift or conversion of a constant.
+ * @param inst
+ * @param arg Constant operand.
+ */
+static void fold_unary(IrInst *inst, const IrInst *arg) {
+    if (arg->type == IT_STRING) return;
+
+    if (inst->op == IR_NOT) {
+        set_int(inst, !arg->ival);
+    } else if (inst->op == IR_NEG) {
+        if (arg->type == IT_FLOAT) {
+            set_float(inst, -arg->fval);
+        } else {
+            set_int(inst, wrap(inst->type, -(int64_t)arg->ival));
+        }
+    } else if (inst->op == IR_SHL) {
+        uint32_t count = inst->ops[1];
+        set_int(inst, wrap(inst->type, (int64_t)((uint64_t)arg->ival << count)));
+    } else if (arg->type != IT_FLOAT) { // Conversion of an integer
+        if (inst->type == IT_FLOAT) {
+            set_float(inst, arg->ival);
+        } else {
+            set_int(inst, wrap(inst->type, arg->ival));
+        }
+    } else if (inst->type == IT_BOOL) {
+        set_int(inst, arg->fval != 0);
+    } else if (arg->fval > INT32_MIN - 1.0 && arg->fval < INT32_MAX + 1.0) {
+        set_int(inst, wrap(inst->type, (int32_t)arg->fval)); // Out of range is undefined
+    }
+}
+
+/**
+ * @brief Evaluates an arithmetic operation or comparison of two constants.
+ * Division by zero and overflowing division are left for run time.
+ * @param inst
+ * @param lhs
+ * @param rhs
+ */
+static void fold_binary(IrInst *inst, const IrInst *lhs, const IrInst *rhs) {
+    IrOp op = inst->op;
+    if (lhs->type == IT_STRING) return;
+
+    if (lhs->type == IT_FLOAT) {
+        double x = lhs->fval, y = rhs->fval;
+
+        switch (op) {
+        case IR_ADD: set_float(inst, x + y); break;
+        case IR_SUB: set_float(inst, x - y); break;
+        case IR_MUL: set_float(inst, x * y); break;
+        case IR_DIV:
+            if (y != 0) set_float(inst, x / y);
+            break;
+        case IR_EQ: set_int(inst, x == y); break;
+        case IR_NE: set_int(inst, x != y); break;
+        case IR_LT: set_int(inst, x < y); break;
+        case IR_LE: set_int(inst, x <= y); break;
+        case IR_GT: set_int(inst, x > y); break;
+        case IR_GE: set_int(inst, x >= y); break;
+        default:    break;
+        }
+        return;
+    }
+
+    int64_t x = lhs->ival, y = rhs->ival;
+    bool safe = y != 0 && !(x == INT32_MIN && y == -1);
+
+    switch (op) {
+    case IR_ADD: set_int(inst, wrap(inst->type, x + y)); break;
+    case IR_SUB: set_int(inst, wrap(inst->type, x - y)); break;
+    case IR_MUL: set_int(inst, wrap(inst->type, x * y)); break;
+    case IR_DIV:
+        if (safe) set_int(inst, wrap(inst->type, x / y));
+        break;
+    case IR_MOD:
+        if (safe) set_int(inst, wrap(inst->type, x % y));
+        break;
+    case IR_EQ: set_int(inst, x == y); break;
+    case IR_NE: set_int(inst, x != y); break;
+    case IR_LT: set_int(inst, x < y); break;
+    case IR_LE: set_int(inst, x <= y); break;
+    case IR_GT: set_int(inst, x > y); break;
+    case IR_GE: set_int(inst, x >= y); break;
+    default:    break;
+    }
+}
+
+/**
+ * @brief Applies the arithmetic identities. Those that do not hold for every
+ * float, like `x + 0` for `-0.0` or `x * 0` for infinities, are applied to
+ * integers only. Integer `x * 2^k` becomes `x << k`, both wrap the same way.
+ * Signed `x / 2^k` rounds toward zero and is left as a division.
+ * @param fn
+ * @param i Arithmetic instruction with at most one constant operand.
+ * @return The value the instruction equals, `i` itself if none.
+ */
+static IrRef simplify(IrFunc *fn, IrRef i) {
+    IrInst *inst      = &fn->insts[i];
+    IrRef a           = inst->ops[0];
+    IrRef b           = inst->ops[1];
+    const IrInst *lhs = &fn->insts[a];
+    const IrInst *rhs = &fn->insts[b];
+    bool whole        = inst->type != IT_FLOAT;
+
+    switch (inst->op) {
+    case IR_ADD:
+        if (whole && is_value(rhs, 0)) return a;
+        if (whole && is_value(lhs, 0)) return b;
+        break;
+    case IR_SUB:
+        if (is_value(rhs, 0) && (whole || !signbit(rhs->fval))) return a;
+        if (whole && a == b) set_int(inst, 0);
+        break;
+    case IR_MUL:
+        if (is_value(rhs, 1)) return a;
+        if (is_value(lhs, 1)) return b;
+        if (whole && (is_value(lhs, 0) || is_value(rhs, 0))) {
+            set_int(inst, 0);
+        } else if (whole && (shift_count(rhs) || shift_count(lhs))) {
+            uint32_t count = shift_count(rhs) ? shift_count(rhs) : shift_count(lhs);
+            inst->ops[0]   = shift_count(rhs) ? a : b;
+            inst->ops[1]   = count;
+            inst->op       = IR_SHL;
+        }
+        break;
+    case IR_DIV:
+        if (is_value(rhs, 1)) return a;
+        break;
+    case IR_MOD:
+        if (is_value(rhs, 1) || is_value(rhs, -1)) set_int(inst, 0);
+        break;
+    default: break;
+    }
+    return i;
+}
+
+/**
+ * @brief Follows the replacements of a value.
+ * @param repl
+ * @param ref
+ * @return The value kept in its place.
+ */
+static IrRef resolve(const uint32_t *repl, IrRef ref) {
+    while (repl[ref] != ref) ref = repl[ref];
+    return ref;
+}
+
+/**
+ * @brief Folds one function body.
+ * @param fn
+ * @param repl Scratch of `inst_count` entries.
+ * @param num Scratch of `inst_count` entries.
+ * @return Number of instructions removed.
+ */
+static uint32_t fold_func(IrFunc *fn, uint32_t *repl, uint32_t *num) {
+    uint32_t n = fn->inst_count;
+    for (IrRef i = 0; i < n; i++) repl[i] = i;
+
+    for (IrRef i = 0; i < n; i++) {
+        IrInst *inst = &fn->insts[i];
+        IrRef *ops;
+        uint32_t count = operands(fn, inst, &ops);
+        for (uint32_t k = 0; k < count; k++) ops[k] = resolve(repl, ops[k]);
+
+        if (inst->op == IR_PHI) {
+            // Operands from later blocks are not folded yet, they count as distinct
+            IrRef same = IR_NONE;
+            for (uint32_t k = 0; k < count && same != i; k++) {
+                if (ops[k] == i || ops[k] == same) continue;
+                same = same == IR_NONE ? ops[k] : i;
+            }
+            if (same != IR_NONE) repl[i] = same;
+        } else if (is_unary_op(inst->op)) {
+            if (fn->insts[ops[0]].op == IR_CONST) fold_unary(inst, &fn->insts[ops[0]]);
+        } else if (count == 2) {
+            const IrInst *lhs = &fn->insts[ops[0]];
+            const IrInst *rhs = &fn->insts[ops[1]];
+
+            if (lhs->op == IR_CONST && rhs->op == IR_CONST) {
+                fold_binary(inst, lhs, rhs);
+            } else if (is_arith_op(inst->op)) {
+                repl[i] = simplify(fn, i);
+            }
+        }
+    }
+
+    // Phis may use values replaced after them, and what is left is marked
+    // live from the instructions with effects, once more for every back edge
+    for (IrRef i = 0; i < n; i++) {
+        IrRef *ops;
+        uint32_t count = operands(fn, &fn->insts[i], &ops);
+        for (uint32_t k = 0; k < count; k++) ops[k] = resolve(repl, ops[k]);
+        num[i] = repl[i] == i && has_effect(fn->insts[i].op);
+    }
+
+    for (bool again = true; again;) {
+        again = false;
+        for (IrRef i = n; i-- > 0;) {
+            if (!num[i]) continue;
+
+            IrRef *ops;
+            uint32_t count = operands(fn, &fn->insts[i], &ops);
+            for (uint32_t k = 0; k < count; k++) {
+                if (num[ops[k]]) continue;
+
+                num[ops[k]] = 1;
+                again       = again || ops[k] > i;
+            }
+        }
+    }
+
+    // Compact every block in place, then renumber the operands
+    IrRef at = 0;
+    for (uint32_t k = 0; k < fn->block_count; k++) {
+        IrBlock *blk = &fn->blocks[k];
+        IrRef first  = blk->first;
+
+        blk->first = at;
+        blk->phis  = 0;
+        for (IrRef i = first; i < first + blk->count; i++) {
+            if (!num[i]) continue;
+
+            num[i]          = at;
+            blk->phis      += fn->insts[i].op == IR_PHI;
+            fn->insts[at++] = fn->insts[i];
+        }
+        blk->count = at - blk->first;
+    }
+
+    for (IrRef i = 0; i < at; i++) {
+        IrRef *ops;
+        uint32_t count = operands(fn, &fn->insts[i], &ops);
+        for (uint32_t k = 0; k < count; k++) ops[k] = num[ops[k]];
+    }
+
+    fn->inst_count = at;
+    return n - at;
+}
+
+size_t fold_module(CompilerContext *ctx, IrModule *mod) {
+    uint32_t most = 0;
+    for (uint32_t f = 0; f < mod->func_count; f++) {
+        if (mod->funcs[f].inst_count > most) most = mod->funcs[f].inst_count;
+    }
+    if (!most) return 0;
+
+    uint32_t *repl = mem_malloc(2 * (size_t)most * sizeof(uint32_t));
+    if (!repl) {
+        fail_context(ctx, CERR_NOMEM, "out of memory while folding IR");
+        return 0;
+    }
+
+    size_t removed = 0;
+    for (uint32_t f = 0; f < mod->func_count; f++) {
+        if (mod->funcs[f].insts) removed += fold_func(&mod->funcs[f], repl, repl + most);
+    }
+
+    free(repl);
+    return removed;
+}
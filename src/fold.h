@@ -0,0 +1,17 @@
+#ifndef _FOLD_H
+#define _FOLD_H
+
+#include "ir.h"
+
+/**
+ * @brief Folds the constant operations of every function body, simplifies
+ * arithmetic identities such as `x * 0`, `x + 0` and `x * 1`, then drops the
+ * instructions whose values are no longer used. Bodies are compacted in
+ * place, keeping their blocks.
+ * @param ctx Records running out of memory.
+ * @param mod
+ * @return Number of instructions removed.
+ */
+size_t fold_module(CompilerContext *ctx, IrModule *mod);
+
+#endif
@@ -0,0 +1,122 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+#include "memstat.h"
+#include "intern.h"
+
+#define INITIAL_SLOTS 1024  // Initial slot count, must be power of two
+#define BLOCK_SIZE    65536 // Atom storage block size in bytes
+
+// Atom storage block, atoms are packed one after another
+struct AtomBlock {
+    AtomBlock *next;
+    size_t used;
+    size_t size;
+    _Alignas(Atom) char data[];
+};
+
+/**
+ * @brief Allocates storage for an atom of `len` characters.
+ * @param in
+ * @param len
+ * @return NULL if memory ran out.
+ */
+static Atom *alloc_atom(Interner *in, size_t len) {
+    size_t need = sizeof(Atom) + len + 1;
+    need        = (need + _Alignof(Atom) - 1) & ~(_Alignof(Atom) - 1);
+
+    AtomBlock *blk = in->blocks;
+    if (!blk || blk->used + need > blk->size) {
+        size_t size = need > BLOCK_SIZE ? need : BLOCK_SIZE;
+
+        blk = mem_malloc(sizeof(AtomBlock) + size);
+        if (!blk) return NULL;
+
+        blk->size  = size;
+        blk->used  = 0;
+        blk->next  = in->blocks;
+        in->blocks = blk;
+    }
+
+    Atom *atom = (Atom *)(blk->data + blk->used);
+    blk->used += need;
+    return atom;
+}
+
+/**
+ * @brief Doubles the slot array and reinserts every atom by it's stored hash.
+ * @param in
+ * @return false if memory ran out, the interner is unchanged then.
+ */
+static bool grow_interner(Interner *in) {
+    unsigned size      = in->size ? in->size * 2 : INITIAL_SLOTS;
+    const Atom **slots = mem_calloc(size, sizeof(Atom *));
+    if (!slots) return false;
+
+    for (unsigned i = 0; i < in->size; i++) {
+        const Atom *atom = in->slots[i];
+        if (!atom) continue;
+
+        unsigned idx = atom->hash & (size - 1);
+        while (slots[idx]) idx = (idx + 1) & (size - 1);
+        slots[idx] = atom;
+    }
+
+    free(in->slots);
+    in->slots = slots;
+    in->size  = size;
+    return true;
+}
+
+const Atom *intern_hashed(Interner *in, const char *str, size_t len, unsigned hash) {
+    // Keep load factor under 1/2
+    if (in->count * 2 >= in->size && !grow_interner(in)) return NULL;
+
+    unsigned mask = in->size - 1;
+    unsigned idx  = hash & mask;
+
+    for (const Atom *atom; (atom = in->slots[idx]); idx = (idx + 1) & mask) {
+        if (atom->hash == hash && atom->len == len && memcmp(atom->str, str, len) == 0) {
+            return atom;
+        }
+    }
+
+    Atom *atom = alloc_atom(in, len);
+    if (!atom) return NULL;
+
+    atom->hash = hash;
+    atom->len  = len;
+    memcpy(atom->str, str, len);
+    atom->str[len] = '\0';
+
+    in->slots[idx] = atom;
+    in->count++;
+    return atom;
+}
+
+const Atom *intern(Interner *in, const char *str, size_t len) {
+    unsigned hash = FNV_OFFSET;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)str[i];
+        hash *= FNV_PRIME;
+    }
+    return intern_hashed(in, str, len, hash);
+}
+
+const Atom *intern_cstr(Interner *in, const char *str) {
+    return intern(in, str, strlen(str));
+}
+
+void purge_interner(Interner *in) {
+    AtomBlock *blk = in->blocks;
+    while (blk) {
+        AtomBlock *next = blk->next;
+        free(blk);
+        blk = next;
+    }
+
+    free(in->slots);
+    *in = (Interner){0};
+}
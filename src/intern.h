@@ -0,0 +1,57 @@
+#ifndef _INTERN_H
+#define _INTERN_H
+
+#include <stddef.h>
+
+// Interned spelling. Every distinct spelling has exactly one atom, so two
+// names are equal if and only if their atom pointers are equal.
+typedef struct Atom {
+    unsigned hash; // Full FNV hash of the spelling
+    unsigned len;  // Spelling length in bytes
+    char str[];    // Null terminated spelling
+} Atom;
+
+typedef struct AtomBlock AtomBlock;
+
+// Open addressing hash-table of atoms. A zeroed interner is ready to use.
+typedef struct {
+    const Atom **slots; // Slots, NULL if empty
+    unsigned size;      // Number of slots, power of two
+    unsigned count;     // Number of atoms
+    AtomBlock *blocks;  // Atom storage, newest first
+} Interner;
+
+/**
+ * @brief Interns a string and returns its atom.
+ * @param in
+ * @param str Spelling, not necessarily null terminated.
+ * @param len Spelling length.
+ * @return NULL if memory ran out.
+ */
+const Atom *intern(Interner *in, const char *str, size_t len);
+
+/**
+ * @brief Interns a string whose FNV hash is already known (e.g. from the lexer).
+ * @param in
+ * @param str Spelling, not necessarily null terminated.
+ * @param len Spelling length.
+ * @param hash Full FNV hash of the spelling.
+ * @return NULL if memory ran out.
+ */
+const Atom *intern_hashed(Interner *in, const char *str, size_t len, unsigned hash);
+
+/**
+ * @brief Interns a null terminated string.
+ * @param in
+ * @param str
+ * @return NULL if memory ran out.
+ */
+const Atom *intern_cstr(Interner *in, const char *str);
+
+/**
+ * @brief Frees every atom. Previously returned atoms become invalid.
+ * @param in
+ */
+void purge_interner(Interner *in);
+
+#endif
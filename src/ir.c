@@ -0,0 +1,1471 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "memstat.h"
+#include "ir.h"
+
+#define INITIAL_CAP 64 // Initial capacity of growing arrays, in entries
+
+/*
+ * The builder constructs SSA form directly while the body is being added,
+ * after Braun et al., "Simple and Efficient Construction of Static Single
+ * Assignment Form". A variable read looks for the value written last in the
+ * block, then in its predecessors, adding a phi where several meet. Reads in a
+ * block whose predecessors are not all known yet add an incomplete phi that is
+ * completed when the block is sealed. Phis merging a single value are replaced
+ * by `ir_end`, once unreachable predecessors are left out.
+ */
+
+// Builder state of a block
+typedef struct {
+    uint32_t preds;    // First incoming edge, `IR_NONE` without
+    uint32_t last;     // Last incoming edge, new ones are linked after it
+    uint32_t pred_count;
+    uint32_t succs[2];
+    uint32_t pending;  // First incomplete phi, `IR_NONE` without
+    bool sealed;       // Every predecessor is known
+    bool done;         // Has its terminator
+} BuildBlock;
+
+// Control flow edge, linked into the predecessor list of its target
+typedef struct {
+    uint32_t from;
+    uint32_t next; // Next edge into the same block
+} Edge;
+
+// Phi waiting for the predecessors of its block
+typedef struct {
+    uint32_t var;
+    IrRef phi;
+    uint32_t next; // Next incomplete phi of the same block
+} Pending;
+
+// Value of a variable at the end of a block
+typedef struct {
+    uint64_t key; // Block in the high half, variable in the low half
+    IrRef value;
+    uint32_t gen; // Function the entry was written for, older entries count as empty
+} DefSlot;
+
+// Scratch array of `ir_end`, reused by every function
+typedef struct {
+    uint32_t *items;
+    uint32_t cap;
+} Scratch;
+
+struct IrBuilder {
+    IrModule *mod;
+    jmp_buf *fail; // Where running out of memory jumps to
+    uint32_t func; // Function being built
+    uint32_t cur;  // Block taking new instructions
+    uint32_t gen;  // Functions started so far
+
+    // Function being built, the arrays are reused by the next one
+    IrInst *insts;      // Instructions in creation order
+    BuildBlock *blocks; // Blocks in creation order
+    uint32_t *extra;    // Operand lists
+    Edge *edges;
+    Pending *pending;
+    uint8_t *vars; // `IrType` of every variable
+    uint32_t inst_count, inst_cap;
+    uint32_t block_count, block_cap;
+    uint32_t extra_count, extra_cap;
+    uint32_t edge_count, edge_cap;
+    uint32_t pending_count, pending_cap;
+    uint32_t var_count, var_cap;
+
+    // Open addressing hash-table of variable values, never shrinks
+    DefSlot *defs;
+    uint32_t def_size;  // Slots, power of two
+    uint32_t def_count; // Entries of the current function
+
+    Scratch rpo;    // Reverse postorder index of every block, `IR_NONE` if unreachable
+    Scratch order;  // Blocks in reverse postorder
+    Scratch stack;  // Depth first search stack
+    Scratch fwd;    // Instruction every one is replaced by, itself if kept
+    Scratch key;    // Sort key of every instruction
+    Scratch num;    // Final number of every instruction, `IR_NONE` if dropped
+    Scratch bucket; // Start of every sort key
+};
+
+/*********************************************
+ * Helpers
+ *********************************************/
+
+static const char *op_names[IR_OP_COUNT] = {
+    [IR_CONST] = "const", [IR_UNDEF] = "undef", [IR_PARAM] = "param", [IR_PHI] = "phi",
+    [IR_LOAD] = "load",   [IR_CALL] = "call",   [IR_NEG] = "neg",     [IR_NOT] = "not",
+    [IR_CONV] = "conv",   [IR_ADD] = "add",     [IR_SUB] = "sub",     [IR_MUL] = "mul",
+    [IR_DIV] = "div",     [IR_MOD] = "mod",     [IR_SHL] = "shl",     [IR_EQ] = "eq",
+    [IR_NE] = "ne",       [IR_LT] = "lt",       [IR_LE] = "le",       [IR_GT] = "gt",
+    [IR_GE] = "ge",       [IR_STORE] = "store", [IR_JMP] = "jmp",     [IR_BR] = "br",
+    [IR_RET] = "ret",
+};
+
+static const char *type_names[IT_COUNT] = {
+    [IT_VOID] = "void",   [IT_BOOL] = "bool",   [IT_CHAR] = "char",
+    [IT_INT] = "int",     [IT_FLOAT] = "float", [IT_STRING] = "string",
+};
+
+static bool is_arith_op(IrOp op) {
+    return op >= IR_ADD && op <= IR_MOD;
+}
+
+static bool is_compare_op(IrOp op) {
+    return op >= IR_EQ && op <= IR_GE;
+}
+
+static bool is_terminator(IrOp op) {
+    return op >= IR_JMP;
+}
+
+static bool is_arith_type(IrType type) {
+    return type == IT_CHAR || type == IT_INT || type == IT_FLOAT;
+}
+
+/*********************************************
+ * Module
+ *********************************************/
+
+IrModule *make_module() {
+    return mem_calloc(1, sizeof(IrModule));
+}
+
+void purge_module(IrModule *mod) {
+    if (!mod) return;
+
+    purge_arena(&mod->arena);
+    free(mod->funcs);
+    free(mod->globals);
+    free(mod);
+}
+
+uint32_t ir_add_global(IrModule *mod, const Atom *name, IrType type) {
+    if (mod->global_count == mod->global_cap) {
+        uint32_t cap      = mod->global_cap ? mod->global_cap * 2 : INITIAL_CAP;
+        IrGlobal *globals = mem_realloc(mod->globals, cap * sizeof(IrGlobal));
+        if (!globals) return IR_NONE;
+
+        mod->globals    = globals;
+        mod->global_cap = cap;
+    }
+
+    mod->globals[mod->global_count] = (IrGlobal){.name = name, .type = type};
+    return mod->global_count++;
+}
+
+uint32_t ir_add_func(
+    IrModule *mod, const Atom *name, IrType ret, const IrType *params, uint32_t count
+) {
+    if (mod->func_count == mod->func_cap) {
+        uint32_t cap  = mod->func_cap ? mod->func_cap * 2 : INITIAL_CAP;
+        IrFunc *funcs = mem_realloc(mod->funcs, cap * sizeof(IrFunc));
+        if (!funcs) return IR_NONE;
+
+        mod->funcs    = funcs;
+        mod->func_cap = cap;
+    }
+
+    uint8_t *types = arena_alloc(&mod->arena, count);
+    if (!types) return IR_NONE;
+    for (uint32_t i = 0; i < count; i++) types[i] = params[i];
+
+    mod->funcs[mod->func_count] = (IrFunc){
+        .name        = name,
+        .ret         = ret,
+        .params      = types,
+        .param_count = count,
+    };
+    return mod->func_count++;
+}
+
+size_t ir_inst_count(const IrModule *mod) {
+    size_t count = 0;
+    for (uint32_t i = 0; i < mod->func_count; i++) count += mod->funcs[i].inst_count;
+    return count;
+}
+
+/*********************************************
+ * Builder Storage
+ *********************************************/
+
+/**
+ * @brief Makes room for `n` more entries in an array holding `count` entries.
+ * Running out of memory jumps to the builder's `fail`.
+ * @param b
+ * @param items
+ * @param count
+ * @param cap Array capacity, updated when the array grows.
+ * @param size Entry size.
+ * @param n
+ * @return The array, possibly moved.
+ */
+static void *grow(
+    IrBuilder *b, void *items, uint32_t count, uint32_t *cap, size_t size, uint32_t n
+) {
+    if (count + n <= *cap) return items;
+
+    uint32_t want = *cap ? *cap : INITIAL_CAP;
+    while (want < count + n) want *= 2;
+
+    items = mem_realloc(items, want * size);
+    if (!items) longjmp(*b->fail, 1);
+
+    *cap = want;
+    return items;
+}
+
+/**
+ * @brief Makes a scratch array at least `n` entries long.
+ * @param b
+ * @param s
+ * @param n
+ * @return Entries, their content is kept when the array grows.
+ */
+static uint32_t *reserve(IrBuilder *b, Scratch *s, uint32_t n) {
+    s->items = grow(b, s->items, 0, &s->cap, sizeof(uint32_t), n);
+    return s->items;
+}
+
+IrBuilder *make_builder(IrModule *mod, jmp_buf *fail) {
+    IrBuilder *b = mem_calloc(1, sizeof(IrBuilder));
+    if (!b) return NULL;
+
+    b->mod  = mod;
+    b->fail = fail;
+    b->func = IR_NONE;
+    b->cur  = IR_NONE;
+    return b;
+}
+
+void purge_builder(IrBuilder *b) {
+    if (!b) return;
+
+    free(b->insts);
+    free(b->blocks);
+    free(b->extra);
+    free(b->edges);
+    free(b->pending);
+    free(b->vars);
+    free(b->defs);
+    Scratch *scratch[] = {&b->rpo, &b->order, &b->stack, &b->fwd, &b->key, &b->num, &b->bucket};
+    for (size_t i = 0; i < sizeof(scratch) / sizeof(scratch[0]); i++) free(scratch[i]->items);
+    free(b);
+}
+
+/**
+ * @brief Appends an instruction of `block`, its operands are set by the caller.
+ * @param b
+ * @param op
+ * @param type
+ * @param block
+ * @return
+ */
+static IrRef add_inst(IrBuilder *b, IrOp op, IrType type, uint32_t block) {
+    b->insts = grow(b, b->insts, b->inst_count, &b->inst_cap, sizeof(IrInst), 1);
+
+    IrInst *inst = &b->insts[b->inst_count];
+    *inst        = (IrInst){.op = op, .type = type, .block = block};
+    inst->ops[0] = IR_NONE;
+    inst->ops[1] = IR_NONE;
+    return b->inst_count++;
+}
+
+/**
+ * @brief Reserves an operand list of `count` entries, filled in by the caller.
+ * @param b
+ * @param count
+ * @return `extra` index of the list.
+ */
+static uint32_t new_list(IrBuilder *b, uint32_t count) {
+    b->extra = grow(b, b->extra, b->extra_count, &b->extra_cap, sizeof(uint32_t), count + 1);
+
+    uint32_t list  = b->extra_count;
+    b->extra[list] = count;
+    b->extra_count += count + 1;
+    return list;
+}
+
+/**
+ * @brief Links an edge into the predecessors of `to`, after the ones it has.
+ * @param b
+ * @param from
+ * @param to
+ */
+static void add_edge(IrBuilder *b, uint32_t from, uint32_t to) {
+    b->edges = grow(b, b->edges, b->edge_count, &b->edge_cap, sizeof(Edge), 1);
+
+    uint32_t edge   = b->edge_count++;
+    b->edges[edge]  = (Edge){.from = from, .next = IR_NONE};
+    BuildBlock *blk = &b->blocks[to];
+
+    if (blk->last == IR_NONE) {
+        blk->preds = edge;
+    } else {
+        b->edges[blk->last].next = edge;
+    }
+    blk->last = edge;
+    blk->pred_count++;
+}
+
+uint32_t ir_block(IrBuilder *b) {
+    b->blocks = grow(b, b->blocks, b->block_count, &b->block_cap, sizeof(BuildBlock), 1);
+
+    b->blocks[b->block_count] = (BuildBlock){
+        .preds   = IR_NONE,
+        .last    = IR_NONE,
+        .succs   = {IR_NONE, IR_NONE},
+        .pending = IR_NONE,
+    };
+    return b->block_count++;
+}
+
+void ir_set_block(IrBuilder *b, uint32_t block) {
+    b->cur = block;
+}
+
+/**
+ * @brief Moves on to a new unreachable block if the current one has its
+ * terminator already, so nothing is added after it.
+ * @param b
+ */
+static void open_block(IrBuilder *b) {
+    if (!b->blocks[b->cur].done) return;
+
+    b->cur                   = ir_block(b);
+    b->blocks[b->cur].sealed = true; // Nothing jumps here
+}
+
+/**
+ * @brief Appends an instruction to the current block.
+ * @param b
+ * @param op
+ * @param type
+ * @return
+ */
+static IrRef emit(IrBuilder *b, IrOp op, IrType type) {
+    open_block(b);
+    return add_inst(b, op, type, b->cur);
+}
+
+/*********************************************
+ * SSA Construction
+ *********************************************/
+
+static uint64_t def_key(uint32_t block, uint32_t var) {
+    return (uint64_t)block << 32 | var;
+}
+
+/**
+ * @brief Finds the slot of `key`, or the empty slot it would take.
+ * @param b
+ * @param key
+ * @return
+ */
+static DefSlot *find_def(const IrBuilder *b, uint64_t key) {
+    uint32_t mask = b->def_size - 1;
+    uint32_t idx  = (uint32_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+
+    for (;; idx = (idx + 1) & mask) {
+        DefSlot *slot = &b->defs[idx];
+        if (slot->gen != b->gen || slot->key == key) return slot;
+    }
+}
+
+/**
+ * @brief Doubles the slots, keeping the entries of the current function.
+ * @param b
+ */
+static void grow_defs(IrBuilder *b) {
+    DefSlot *old  = b->defs;
+    uint32_t size = b->def_size;
+
+    b->defs = mem_calloc(size ? size * 2 : INITIAL_CAP, sizeof(DefSlot));
+    if (!b->defs) {
+        b->defs = old;
+        longjmp(*b->fail, 1);
+    }
+    b->def_size = size ? size * 2 : INITIAL_CAP;
+
+    for (uint32_t i = 0; i < size; i++) {
+        if (old[i].gen == b->gen) *find_def(b, old[i].key) = old[i];
+    }
+    free(old);
+}
+
+/**
+ * @brief Value of a variable written in `block`.
+ * @param b
+ * @param block
+ * @param var
+ * @return `IR_NONE` if the block does not write it.
+ */
+static IrRef get_def(const IrBuilder *b, uint32_t block, uint32_t var) {
+    if (!b->def_size) return IR_NONE;
+
+    const DefSlot *slot = find_def(b, def_key(block, var));
+    return slot->gen == b->gen ? slot->value : IR_NONE;
+}
+
+static void set_def(IrBuilder *b, uint32_t block, uint32_t var, IrRef value) {
+    // Keep load factor under 1/2
+    if ((b->def_count + 1) * 2 > b->def_size) grow_defs(b);
+
+    DefSlot *slot = find_def(b, def_key(block, var));
+    if (slot->gen != b->gen) {
+        slot->key = def_key(block, var);
+        slot->gen = b->gen;
+        b->def_count++;
+    }
+    slot->value = value;
+}
+
+static IrRef read_var(IrBuilder *b, uint32_t var, uint32_t block);
+
+/**
+ * @brief Sets the operands of a phi to the values of its variable at the end
+ * of every predecessor.
+ * @param b
+ * @param phi
+ * @param var
+ */
+static void fill_phi(IrBuilder *b, IrRef phi, uint32_t var) {
+    uint32_t block    = b->insts[phi].block;
+    uint32_t list     = new_list(b, b->blocks[block].pred_count);
+    b->insts[phi].arg = list;
+
+    uint32_t i = 0;
+    for (uint32_t e = b->blocks[block].preds; e != IR_NONE; e = b->edges[e].next) {
+        IrRef value              = read_var(b, var, b->edges[e].from);
+        b->extra[list + 1 + i++] = value;
+    }
+}
+
+/**
+ * @brief Value of a variable at the end of `block`, remembered for the blocks
+ * searched through.
+ * @param b
+ * @param var
+ * @param block
+ * @return
+ */
+static IrRef read_var(IrBuilder *b, uint32_t var, uint32_t block) {
+    IrRef value = get_def(b, block, var);
+    if (value != IR_NONE) return value;
+
+    // A block with a single predecessor sees its value, search up to a block
+    // that writes the variable or has several predecessors. The step limit
+    // stops at unreachable cycles, which the phi below handles.
+    uint32_t top = block;
+    for (uint32_t steps = 0; steps < b->block_count; steps++) {
+        const BuildBlock *blk = &b->blocks[top];
+        if (!blk->sealed || blk->pred_count != 1) break;
+
+        top   = b->edges[blk->preds].from;
+        value = get_def(b, top, var);
+        if (value != IR_NONE) break;
+    }
+
+    if (value == IR_NONE) {
+        const BuildBlock *blk = &b->blocks[top];
+        IrType type           = b->vars[var];
+
+        if (!blk->sealed) {
+            value = add_inst(b, IR_PHI, type, top);
+
+            b->pending = grow(b, b->pending, b->pending_count, &b->pending_cap, sizeof(Pending), 1);
+            b->pending[b->pending_count] = (Pending){var, value, b->blocks[top].pending};
+            b->blocks[top].pending       = b->pending_count++;
+        } else if (blk->pred_count == 0) {
+            value = add_inst(b, IR_UNDEF, type, top);
+        } else {
+            value = add_inst(b, IR_PHI, type, top);
+            set_def(b, top, var, value); // Reads through a loop find the phi
+            fill_phi(b, value, var);
+        }
+        set_def(b, top, var, value);
+    }
+
+    for (uint32_t at = block; at != top; at = b->edges[b->blocks[at].preds].from) {
+        set_def(b, at, var, value);
+    }
+    return value;
+}
+
+void ir_seal(IrBuilder *b, uint32_t block) {
+    if (b->blocks[block].sealed) return;
+
+    b->blocks[block].sealed = true;
+    for (uint32_t p = b->blocks[block].pending; p != IR_NONE; p = b->pending[p].next) {
+        fill_phi(b, b->pending[p].phi, b->pending[p].var);
+    }
+    b->blocks[block].pending = IR_NONE;
+}
+
+uint32_t ir_var(IrBuilder *b, IrType type) {
+    b->vars = grow(b, b->vars, b->var_count, &b->var_cap, sizeof(uint8_t), 1);
+
+    b->vars[b->var_count] = type;
+    return b->var_count++;
+}
+
+void ir_def(IrBuilder *b, uint32_t var, IrRef value) {
+    open_block(b);
+    set_def(b, b->cur, var, value);
+}
+
+IrRef ir_use(IrBuilder *b, uint32_t var) {
+    open_block(b);
+    return read_var(b, var, b->cur);
+}
+
+/*********************************************
+ * Instructions
+ *********************************************/
+
+IrType ir_type(const IrBuilder *b, IrRef value) {
+    return b->insts[value].type;
+}
+
+IrRef ir_const_int(IrBuilder *b, IrType type, int32_t value) {
+    IrRef ref          = emit(b, IR_CONST, type);
+    b->insts[ref].ival = value;
+    return ref;
+}
+
+IrRef ir_const_float(IrBuilder *b, double value) {
+    IrRef ref          = emit(b, IR_CONST, IT_FLOAT);
+    b->insts[ref].fval = value;
+    return ref;
+}
+
+IrRef ir_const_str(IrBuilder *b, const char *value) {
+    IrRef ref          = emit(b, IR_CONST, IT_STRING);
+    b->insts[ref].sval = value;
+    return ref;
+}
+
+IrRef ir_param(IrBuilder *b, uint32_t index) {
+    IrRef ref           = emit(b, IR_PARAM, b->mod->funcs[b->func].params[index]);
+    b->insts[ref].index = index;
+    return ref;
+}
+
+IrRef ir_load(IrBuilder *b, uint32_t global) {
+    IrRef ref           = emit(b, IR_LOAD, b->mod->globals[global].type);
+    b->insts[ref].index = global;
+    return ref;
+}
+
+void ir_store(IrBuilder *b, uint32_t global, IrRef value) {
+    IrRef ref           = emit(b, IR_STORE, IT_VOID);
+    b->insts[ref].index = global;
+    b->insts[ref].arg   = value;
+}
+
+IrRef ir_unary(IrBuilder *b, IrOp op, IrRef value) {
+    IrRef ref            = emit(b, op, op == IR_NOT ? IT_BOOL : ir_type(b, value));
+    b->insts[ref].ops[0] = value;
+    return ref;
+}
+
+IrRef ir_binary(IrBuilder *b, IrOp op, IrRef lhs, IrRef rhs) {
+    IrRef ref            = emit(b, op, is_compare_op(op) ? IT_BOOL : ir_type(b, lhs));
+    b->insts[ref].ops[0] = lhs;
+    b->insts[ref].ops[1] = rhs;
+    return ref;
+}
+
+IrRef ir_conv(IrBuilder *b, IrType type, IrRef value) {
+    if (ir_type(b, value) == type) return value;
+
+    IrRef ref            = emit(b, IR_CONV, type);
+    b->insts[ref].ops[0] = value;
+    return ref;
+}
+
+IrRef ir_call(IrBuilder *b, uint32_t func, const IrRef *args, uint32_t count) {
+    uint32_t list = new_list(b, count);
+    memcpy(&b->extra[list + 1], args, count * sizeof(IrRef));
+
+    IrRef ref           = emit(b, IR_CALL, b->mod->funcs[func].ret);
+    b->insts[ref].index = func;
+    b->insts[ref].arg   = list;
+    return ref;
+}
+
+/**
+ * @brief Ends the block of a terminator and links it to its successors.
+ * @param b
+ * @param term
+ * @param s0 First successor, `IR_NONE` if none.
+ * @param s1 Second successor, `IR_NONE` if none.
+ */
+static void terminate(IrBuilder *b, IrRef term, uint32_t s0, uint32_t s1) {
+    uint32_t block = b->insts[term].block;
+
+    b->blocks[block].done     = true;
+    b->blocks[block].succs[0] = s0;
+    b->blocks[block].succs[1] = s1;
+    if (s0 != IR_NONE) add_edge(b, block, s0);
+    if (s1 != IR_NONE) add_edge(b, block, s1);
+}
+
+void ir_jump(IrBuilder *b, uint32_t target) {
+    terminate(b, emit(b, IR_JMP, IT_VOID), target, IR_NONE);
+}
+
+void ir_branch(IrBuilder *b, IrRef cond, uint32_t then, uint32_t else_) {
+    IrRef ref            = emit(b, IR_BR, IT_VOID);
+    b->insts[ref].ops[0] = cond;
+    terminate(b, ref, then, else_);
+}
+
+void ir_ret(IrBuilder *b, IrRef value) {
+    IrRef ref            = emit(b, IR_RET, IT_VOID);
+    b->insts[ref].ops[0] = value;
+    terminate(b, ref, IR_NONE, IR_NONE);
+}
+
+/*********************************************
+ * Finishing a Function
+ *********************************************/
+
+void ir_begin(IrBuilder *b, uint32_t func) {
+    b->func          = func;
+    b->gen          += 1;
+    b->inst_count    = 0;
+    b->block_count   = 0;
+    b->extra_count   = 0;
+    b->edge_count    = 0;
+    b->pending_count = 0;
+    b->var_count     = 0;
+    b->def_count     = 0;
+
+    b->cur = ir_block(b);
+    ir_seal(b, b->cur);
+}
+
+/**
+ * @brief Numbers the blocks reachable from the entry in reverse postorder,
+ * into the `rpo` and `order` scratch arrays.
+ * @param b
+ * @return Number of reachable blocks.
+ */
+static uint32_t order_blocks(IrBuilder *b) {
+    uint32_t n      = b->block_count;
+    uint32_t *rpo   = reserve(b, &b->rpo, n);
+    uint32_t *order = reserve(b, &b->order, n);
+    uint32_t *stack = reserve(b, &b->stack, n);
+
+    // While a block is searched, `rpo` counts the successors it has visited
+    for (uint32_t k = 0; k < n; k++) rpo[k] = IR_NONE;
+    uint32_t top = 0, post = 0;
+    stack[top++] = 0;
+    rpo[0]       = 0;
+
+    while (top) {
+        uint32_t k = stack[top - 1];
+        if (rpo[k] < 2) {
+            // The second successor first, so the first one comes first in the order
+            uint32_t s = b->blocks[k].succs[1 - rpo[k]++];
+            if (s != IR_NONE && rpo[s] == IR_NONE) {
+                rpo[s]       = 0;
+                stack[top++] = s;
+            }
+        } else {
+            order[post++] = k;
+            top--;
+        }
+    }
+
+    for (uint32_t i = 0; i < post / 2; i++) {
+        uint32_t k          = order[i];
+        order[i]            = order[post - 1 - i];
+        order[post - 1 - i] = k;
+    }
+    for (uint32_t i = 0; i < post; i++) rpo[order[i]] = i;
+    return post;
+}
+
+/**
+ * @brief Leaves out the phi operands of unreachable predecessors.
+ * @param b
+ */
+static void prune_phis(IrBuilder *b) {
+    const uint32_t *rpo = b->rpo.items;
+
+    for (IrRef i = 0; i < b->inst_count; i++) {
+        const IrInst *inst = &b->insts[i];
+        if (inst->op != IR_PHI || rpo[inst->block] == IR_NONE) continue;
+
+        uint32_t *ops = &b->extra[inst->arg];
+        uint32_t kept = 0, at = 1;
+        for (uint32_t e = b->blocks[inst->block].preds; e != IR_NONE; e = b->edges[e].next) {
+            if (rpo[b->edges[e].from] != IR_NONE) ops[++kept] = ops[at];
+            at++;
+        }
+        ops[0] = kept;
+    }
+}
+
+/**
+ * @brief Follows the replacements of a value, shortening the path.
+ * @param fwd
+ * @param value
+ * @return The value kept in its place.
+ */
+static IrRef find(uint32_t *fwd, IrRef value) {
+    IrRef root = value;
+    while (fwd[root] != root) root = fwd[root];
+
+    while (fwd[value] != root) {
+        IrRef next = fwd[value];
+        fwd[value] = root;
+        value      = next;
+    }
+    return root;
+}
+
+/**
+ * @brief Replaces every reachable phi whose operands are one value besides
+ * itself by that value, until none is left. A phi of no value at all becomes
+ * an undefined value.
+ * @param b
+ */
+static void merge_phis(IrBuilder *b) {
+    const uint32_t *rpo = b->rpo.items;
+    uint32_t *fwd       = reserve(b, &b->fwd, b->inst_count);
+    for (IrRef i = 0; i < b->inst_count; i++) fwd[i] = i;
+
+    for (bool changed = true; changed;) {
+        changed = false;
+
+        for (IrRef i = 0; i < b->inst_count; i++) {
+            const IrInst *inst = &b->insts[i];
+            if (inst->op != IR_PHI || fwd[i] != i || rpo[inst->block] == IR_NONE) continue;
+
+            const uint32_t *ops = &b->extra[inst->arg];
+            IrRef same          = IR_NONE;
+            bool trivial        = true;
+            for (uint32_t k = 1; k <= ops[0] && trivial; k++) {
+                IrRef op = find(fwd, ops[k]);
+                if (op == i || op == same) continue;
+
+                trivial = same == IR_NONE;
+                same    = op;
+            }
+            if (!trivial) continue;
+
+            if (same == IR_NONE) {
+                same      = add_inst(b, IR_UNDEF, inst->type, inst->block);
+                fwd       = reserve(b, &b->fwd, b->inst_count);
+                fwd[same] = same;
+            }
+            fwd[i]  = same;
+            changed = true;
+        }
+    }
+}
+
+/**
+ * @brief Numbers the kept instructions block by block, phis first, then
+ * undefined values, then the others in creation order, and copies the body
+ * into the module's arena with every reference renumbered.
+ * @param b
+ * @param nblocks Reachable blocks.
+ */
+static void layout(IrBuilder *b, uint32_t nblocks) {
+    const uint32_t *rpo   = b->rpo.items;
+    const uint32_t *order = b->order.items;
+    uint32_t *fwd         = b->fwd.items;
+    uint32_t n            = b->inst_count;
+    uint32_t *key         = reserve(b, &b->key, n);
+    uint32_t *num         = reserve(b, &b->num, n);
+    uint32_t *bucket      = reserve(b, &b->bucket, 3 * nblocks + 1);
+    memset(bucket, 0, (3 * nblocks + 1) * sizeof(uint32_t));
+
+    // Counting sort by block and rank, which keeps the creation order
+    uint32_t lists = 0; // `extra` entries of the kept operand lists
+    for (IrRef i = 0; i < n; i++) {
+        const IrInst *inst = &b->insts[i];
+        if (rpo[inst->block] == IR_NONE || fwd[i] != i) {
+            key[i] = IR_NONE;
+            continue;
+        }
+
+        uint32_t rank = inst->op == IR_PHI ? 0 : inst->op == IR_UNDEF ? 1 : 2;
+        key[i]        = rpo[inst->block] * 3 + rank;
+        bucket[key[i] + 1]++;
+        if (inst->op == IR_PHI || inst->op == IR_CALL) lists += 1 + b->extra[inst->arg];
+    }
+    for (uint32_t k = 1; k <= 3 * nblocks; k++) bucket[k] += bucket[k - 1];
+    uint32_t count = bucket[3 * nblocks];
+
+    for (uint32_t k = 0; k < nblocks; k++) lists += 1 + b->blocks[order[k]].pred_count;
+
+    IrModule *mod    = b->mod;
+    IrInst *insts    = arena_alloc(&mod->arena, count * sizeof(IrInst));
+    IrBlock *blocks  = arena_alloc(&mod->arena, nblocks * sizeof(IrBlock));
+    uint32_t *extra  = arena_alloc(&mod->arena, lists * sizeof(uint32_t));
+    if (!insts || !blocks || !extra) longjmp(*b->fail, 1);
+
+    uint32_t at = 0;
+    for (uint32_t k = 0; k < nblocks; k++) {
+        const BuildBlock *src = &b->blocks[order[k]];
+        IrBlock *blk          = &blocks[k];
+
+        blk->first = bucket[3 * k];
+        blk->phis  = bucket[3 * k + 1] - bucket[3 * k];
+        blk->count = bucket[3 * k + 3] - bucket[3 * k];
+        for (int s = 0; s < 2; s++) {
+            blk->succs[s] = src->succs[s] == IR_NONE ? IR_NONE : rpo[src->succs[s]];
+        }
+
+        blk->preds = at;
+        extra[at]  = 0;
+        for (uint32_t e = src->preds; e != IR_NONE; e = b->edges[e].next) {
+            uint32_t from = rpo[b->edges[e].from];
+            if (from != IR_NONE) extra[at + 1 + extra[at]++] = from;
+        }
+        at += 1 + extra[at];
+    }
+
+    for (IrRef i = 0; i < n; i++) num[i] = key[i] == IR_NONE ? IR_NONE : bucket[key[i]]++;
+
+    for (IrRef i = 0; i < n; i++) {
+        if (num[i] == IR_NONE) continue;
+
+        IrInst inst = b->insts[i];
+        inst.block  = rpo[inst.block];
+
+        switch (inst.op) {
+        case IR_PHI:
+        case IR_CALL: {
+            const uint32_t *ops = &b->extra[inst.arg];
+            extra[at]           = ops[0];
+            for (uint32_t k = 1; k <= ops[0]; k++) extra[at + k] = num[find(fwd, ops[k])];
+            inst.arg = at;
+            at      += 1 + ops[0];
+            break;
+        }
+        case IR_STORE: inst.arg = num[find(fwd, inst.arg)]; break;
+        case IR_RET:
+            if (inst.ops[0] != IR_NONE) inst.ops[0] = num[find(fwd, inst.ops[0])];
+            break;
+        case IR_NEG:
+        case IR_NOT:
+        case IR_CONV:
+        case IR_SHL:
+        case IR_BR:   inst.ops[0] = num[find(fwd, inst.ops[0])]; break;
+        default:
+            if (is_arith_op(inst.op) || is_compare_op(inst.op)) {
+                inst.ops[0] = num[find(fwd, inst.ops[0])];
+                inst.ops[1] = num[find(fwd, inst.ops[1])];
+            }
+            break;
+        }
+        insts[num[i]] = inst;
+    }
+
+    IrFunc *fn      = &mod->funcs[b->func];
+    fn->insts       = insts;
+    fn->blocks      = blocks;
+    fn->extra       = extra;
+    fn->inst_count  = count;
+    fn->block_count = nblocks;
+    fn->extra_count = at;
+}
+
+void ir_end(IrBuilder *b) {
+    IrType ret = b->mod->funcs[b->func].ret;
+
+    // Every predecessor is known by now, and blocks left open fall off the end
+    for (uint32_t k = 0; k < b->block_count; k++) ir_seal(b, k);
+    for (uint32_t k = 0; k < b->block_count; k++) {
+        if (b->blocks[k].done) continue;
+
+        b->cur = k;
+        ir_ret(b, ret == IT_VOID ? IR_NONE : add_inst(b, IR_UNDEF, ret, k));
+    }
+
+    uint32_t nblocks = order_blocks(b);
+    prune_phis(b);
+    merge_phis(b);
+    layout(b, nblocks);
+
+    b->func = IR_NONE;
+    b->cur  = IR_NONE;
+}
+
+/*********************************************
+ * Printing
+ *********************************************/
+
+/**
+ * @brief Prints a string constant in quotes. Its escapes are still spelled as
+ * in the source, only raw control characters are escaped.
+ * @param str
+ * @param out
+ */
+static void print_string(const char *str, FILE *out) {
+    fputc('"', out);
+    for (const unsigned char *c = (const unsigned char *)str; *c; c++) {
+        if (*c == '\n') {
+            fputs("\\n", out);
+        } else if (*c == '\t') {
+            fputs("\\t", out);
+        } else if (*c < 0x20 || *c == 0x7f) {
+            fprintf(out, "\\x%02x", *c);
+        } else {
+            fputc(*c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+/**
+ * @brief Prints one instruction. Comparisons show the type of their operands,
+ * every other instruction the type of its value.
+ * @param mod
+ * @param fn
+ * @param i
+ * @param out
+ */
+static void print_inst(const IrModule *mod, const IrFunc *fn, IrRef i, FILE *out) {
+    const IrInst *inst = &fn->insts[i];
+    const char *type   = type_names[inst->type];
+
+    fputs("    ", out);
+    if (inst->type != IT_VOID) fprintf(out, "%%%u = ", i);
+    fputs(op_names[inst->op], out);
+
+    switch (inst->op) {
+    case IR_CONST:
+        fprintf(out, " %s ", type);
+        if (inst->type == IT_FLOAT) {
+            fprintf(out, "%g", inst->fval);
+        } else if (inst->type == IT_STRING) {
+            print_string(inst->sval, out);
+        } else {
+            fprintf(out, "%d", inst->ival);
+        }
+        break;
+    case IR_UNDEF: fprintf(out, " %s", type); break;
+    case IR_PARAM: fprintf(out, " %s %u", type, inst->index); break;
+    case IR_LOAD:  fprintf(out, " %s @%s", type, mod->globals[inst->index].name->str); break;
+    case IR_STORE:
+        fprintf(out, " @%s, %%%u", mod->globals[inst->index].name->str, inst->arg);
+        break;
+    case IR_PHI: {
+        const uint32_t *ops   = &fn->extra[inst->arg];
+        const uint32_t *preds = &fn->extra[fn->blocks[inst->block].preds];
+        fprintf(out, " %s", type);
+        for (uint32_t k = 1; k <= ops[0]; k++) {
+            fprintf(out, "%s [%%%u, b%u]", k > 1 ? "," : "", ops[k], preds[k]);
+        }
+        break;
+    }
+    case IR_CALL: {
+        const uint32_t *args = &fn->extra[inst->arg];
+        fprintf(out, " %s @%s(", type, mod->funcs[inst->index].name->str);
+        for (uint32_t k = 1; k <= args[0]; k++) {
+            fprintf(out, "%s%%%u", k > 1 ? ", " : "", args[k]);
+        }
+        fputc(')', out);
+        break;
+    }
+    case IR_JMP: fprintf(out, " b%u", fn->blocks[inst->block].succs[0]); break;
+    case IR_BR:
+        fprintf(
+            out, " %%%u, b%u, b%u", inst->ops[0], fn->blocks[inst->block].succs[0],
+            fn->blocks[inst->block].succs[1]
+        );
+        break;
+    case IR_RET:
+        if (inst->ops[0] != IR_NONE) fprintf(out, " %%%u", inst->ops[0]);
+        break;
+    case IR_NEG:
+    case IR_NOT:
+    case IR_CONV: fprintf(out, " %s %%%u", type, inst->ops[0]); break;
+    case IR_SHL:  fprintf(out, " %s %%%u, %u", type, inst->ops[0], inst->ops[1]); break;
+    default:
+        if (is_compare_op(inst->op)) type = type_names[fn->insts[inst->ops[0]].type];
+        fprintf(out, " %s %%%u, %%%u", type, inst->ops[0], inst->ops[1]);
+        break;
+    }
+    fputc('\n', out);
+}
+
+/**
+ * @brief Prints the signature of a function.
+ * @param fn
+ * @param out
+ */
+static void print_signature(const IrFunc *fn, FILE *out) {
+    fprintf(out, "%s @%s(", type_names[fn->ret], fn->name->str);
+    for (uint32_t i = 0; i < fn->param_count; i++) {
+        fprintf(out, "%s%s", i ? ", " : "", type_names[fn->params[i]]);
+    }
+    fputc(')', out);
+}
+
+void print_ir(const IrModule *mod, FILE *out) {
+    for (uint32_t g = 0; g < mod->global_count; g++) {
+        const IrGlobal *global = &mod->globals[g];
+        fprintf(out, "global %s @%s\n", type_names[global->type], global->name->str);
+    }
+
+    for (uint32_t f = 0; f < mod->func_count; f++) {
+        const IrFunc *fn = &mod->funcs[f];
+        if (f || mod->global_count) fputc('\n', out);
+
+        if (!fn->insts) {
+            fputs("declare ", out);
+            print_signature(fn, out);
+            fputc('\n', out);
+            continue;
+        }
+
+        fputs("func ", out);
+        print_signature(fn, out);
+        fputs(" {\n", out);
+
+        for (uint32_t k = 0; k < fn->block_count; k++) {
+            const IrBlock *blk    = &fn->blocks[k];
+            const uint32_t *preds = &fn->extra[blk->preds];
+
+            fprintf(out, "b%u:", k);
+            for (uint32_t p = 1; p <= preds[0]; p++) {
+                fprintf(out, "%s b%u", p > 1 ? "," : " ; preds", preds[p]);
+            }
+            fputc('\n', out);
+
+            for (IrRef i = blk->first; i < blk->first + blk->count; i++) {
+                print_inst(mod, fn, i, out);
+            }
+        }
+        fputs("}\n", out);
+    }
+}
+
+/*********************************************
+ * Verification
+ *********************************************/
+
+// Verifier state of one function. Dominance is answered with the preorder and
+// postorder numbers of the blocks in the dominator tree.
+typedef struct {
+    CompilerContext *ctx;
+    const IrModule *mod;
+    const IrFunc *fn;
+    uint32_t *mem;   // Every array below, in one allocation
+    uint32_t *rnum;  // Reverse postorder index of every block
+    uint32_t *order; // Blocks in reverse postorder
+    uint32_t *idom;  // Immediate dominator of every reverse postorder index
+    uint32_t *pre;   // Dominator tree preorder number of every index
+    uint32_t *post;  // Dominator tree postorder number of every index
+    uint32_t *first; // First child of every index in `kids`, one more entry at the end
+    uint32_t *kids;  // Dominator tree children, grouped by parent
+    uint32_t *stack; // Search stack
+    uint32_t *mark;  // Per block counts
+} Check;
+
+/**
+ * @brief Records a violation at an instruction.
+ * @param c
+ * @param at
+ * @param msg
+ * @return false
+ */
+static bool bad_inst(Check *c, IrRef at, const char *msg) {
+    fail_context(c->ctx, CERR_IR, "invalid IR in '%s' at %%%u: %s", c->fn->name->str, at, msg);
+    return false;
+}
+
+/**
+ * @brief Records a violation at a block.
+ * @param c
+ * @param at
+ * @param msg
+ * @return false
+ */
+static bool bad_block(Check *c, uint32_t at, const char *msg) {
+    fail_context(c->ctx, CERR_IR, "invalid IR in '%s' at b%u: %s", c->fn->name->str, at, msg);
+    return false;
+}
+
+/**
+ * @brief Checks that the blocks partition the instructions, that phis lead
+ * and terminators end every block, and that successors and predecessor lists
+ * describe the same edges.
+ * @param c
+ * @return
+ */
+static bool check_blocks(Check *c) {
+    const IrFunc *fn = c->fn;
+    if (!fn->block_count) return bad_block(c, 0, "function without blocks");
+
+    IrRef next = 0;
+    for (uint32_t k = 0; k < fn->block_count; k++) {
+        const IrBlock *blk = &fn->blocks[k];
+        if (blk->first != next || !blk->count || blk->phis >= blk->count ||
+            blk->first + blk->count > fn->inst_count) {
+            return bad_block(c, k, "instructions out of place");
+        }
+        next += blk->count;
+
+        for (IrRef i = blk->first; i < blk->first + blk->count; i++) {
+            const IrInst *inst = &fn->insts[i];
+            if (inst->block != k) return bad_inst(c, i, "wrong block");
+            if ((inst->op == IR_PHI) != (i < blk->first + blk->phis)) {
+                return bad_inst(c, i, "phi out of place");
+            }
+            if (is_terminator(inst->op) != (i == blk->first + blk->count - 1)) {
+                return bad_inst(c, i, "terminator out of place");
+            }
+        }
+
+        IrOp term  = fn->insts[blk->first + blk->count - 1].op;
+        int succs  = term == IR_JMP ? 1 : term == IR_BR ? 2 : 0;
+        for (int s = 0; s < 2; s++) {
+            bool want = s < succs;
+            if (want != (blk->succs[s] != IR_NONE) || (want && blk->succs[s] >= fn->block_count)) {
+                return bad_block(c, k, "successors do not match the terminator");
+            }
+        }
+
+        if (blk->preds >= fn->extra_count ||
+            blk->preds + 1 + fn->extra[blk->preds] > fn->extra_count) {
+            return bad_block(c, k, "predecessor list out of range");
+        }
+        for (uint32_t p = 1; p <= fn->extra[blk->preds]; p++) {
+            if (fn->extra[blk->preds + p] >= fn->block_count) {
+                return bad_block(c, k, "predecessor out of range");
+            }
+        }
+    }
+    if (next != fn->inst_count) {
+        return bad_block(c, fn->block_count - 1, "instructions out of place");
+    }
+    if (fn->extra[fn->blocks[0].preds]) return bad_block(c, 0, "entry block with predecessors");
+
+    // Every edge is listed once per successor slot naming it
+    uint32_t *indeg = c->mark;
+    memset(indeg, 0, fn->block_count * sizeof(uint32_t));
+    for (uint32_t k = 0; k < fn->block_count; k++) {
+        for (int s = 0; s < 2; s++) {
+            if (fn->blocks[k].succs[s] != IR_NONE) indeg[fn->blocks[k].succs[s]]++;
+        }
+    }
+    for (uint32_t k = 0; k < fn->block_count; k++) {
+        if (fn->extra[fn->blocks[k].preds] != indeg[k]) {
+            return bad_block(c, k, "predecessors do not match the successors");
+        }
+    }
+
+    memset(c->mark, 0, fn->block_count * sizeof(uint32_t));
+    for (uint32_t k = 0; k < fn->block_count; k++) {
+        const uint32_t *preds = &fn->extra[fn->blocks[k].preds];
+        bool ok               = true;
+
+        for (uint32_t p = 1; p <= preds[0]; p++) c->mark[preds[p]]++;
+        for (uint32_t p = 1; p <= preds[0]; p++) {
+            const IrBlock *from = &fn->blocks[preds[p]];
+            uint32_t edges      = (uint32_t)(from->succs[0] == k) + (from->succs[1] == k);
+            ok                  = ok && c->mark[preds[p]] == edges;
+        }
+        for (uint32_t p = 1; p <= preds[0]; p++) c->mark[preds[p]] = 0;
+        if (!ok) return bad_block(c, k, "predecessors do not match the successors");
+    }
+    return true;
+}
+
+/**
+ * @brief Nearest common dominator of two reverse postorder indices.
+ * @param idom
+ * @param a
+ * @param b
+ * @return
+ */
+static uint32_t intersect(const uint32_t *idom, uint32_t a, uint32_t b) {
+    while (a != b) {
+        while (a > b) a = idom[a];
+        while (b > a) b = idom[b];
+    }
+    return a;
+}
+
+/**
+ * @brief Computes the dominator tree, after Cooper, Harvey and Kennedy, "A
+ * Simple, Fast Dominance Algorithm", and numbers it for dominance queries.
+ * @param c
+ * @return false if a block is unreachable.
+ */
+static bool check_dominance(Check *c) {
+    const IrFunc *fn = c->fn;
+    uint32_t n       = fn->block_count;
+
+    // Reverse postorder, `rnum` counts visited successors while searching
+    for (uint32_t k = 0; k < n; k++) c->rnum[k] = IR_NONE;
+    uint32_t top = 0, post = 0;
+    c->stack[top++] = 0;
+    c->rnum[0]      = 0;
+    while (top) {
+        uint32_t k = c->stack[top - 1];
+        if (c->rnum[k] < 2) {
+            uint32_t s = fn->blocks[k].succs[c->rnum[k]++];
+            if (s != IR_NONE && c->rnum[s] == IR_NONE) {
+                c->rnum[s]      = 0;
+                c->stack[top++] = s;
+            }
+        } else {
+            c->order[n - 1 - post++] = k;
+            top--;
+        }
+    }
+    if (post != n) {
+        for (uint32_t k = 0; k < n; k++) {
+            if (c->rnum[k] == IR_NONE) return bad_block(c, k, "unreachable block");
+        }
+    }
+    for (uint32_t r = 0; r < n; r++) c->rnum[c->order[r]] = r;
+
+    for (uint32_t r = 0; r < n; r++) c->idom[r] = IR_NONE;
+    c->idom[0] = 0;
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (uint32_t r = 1; r < n; r++) {
+            const uint32_t *preds = &fn->extra[fn->blocks[c->order[r]].preds];
+            uint32_t idom         = IR_NONE;
+
+            for (uint32_t p = 1; p <= preds[0]; p++) {
+                uint32_t pr = c->rnum[preds[p]];
+                if (c->idom[pr] == IR_NONE) continue;
+                idom = idom == IR_NONE ? pr : intersect(c->idom, pr, idom);
+            }
+            if (c->idom[r] != idom) {
+                c->idom[r] = idom;
+                changed    = true;
+            }
+        }
+    }
+
+    // Children grouped by parent, then a preorder and postorder walk
+    memset(c->first, 0, (n + 1) * sizeof(uint32_t));
+    for (uint32_t r = 1; r < n; r++) c->first[c->idom[r] + 1]++;
+    for (uint32_t r = 1; r <= n; r++) c->first[r] += c->first[r - 1];
+    memcpy(c->mark, c->first, n * sizeof(uint32_t));
+    for (uint32_t r = 1; r < n; r++) c->kids[c->mark[c->idom[r]]++] = r;
+
+    memcpy(c->mark, c->first, n * sizeof(uint32_t)); // Next child to visit
+    uint32_t pre = 0;
+    post         = 0;
+    top          = 0;
+    c->stack[top++] = 0;
+    c->pre[0]       = pre++;
+    while (top) {
+        uint32_t r = c->stack[top - 1];
+        if (c->mark[r] < c->first[r + 1]) {
+            uint32_t kid    = c->kids[c->mark[r]++];
+            c->pre[kid]     = pre++;
+            c->stack[top++] = kid;
+        } else {
+            c->post[r] = post++;
+            top--;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Whether block `a` dominates block `b`.
+ * @param c
+ * @param a
+ * @param b
+ * @return
+ */
+static bool dominates(const Check *c, uint32_t a, uint32_t b) {
+    uint32_t ra = c->rnum[a], rb = c->rnum[b];
+    return c->pre[ra] <= c->pre[rb] && c->post[rb] <= c->post[ra];
+}
+
+/**
+ * @brief Checks that an operand names a value available where it is used.
+ * @param c
+ * @param i Using instruction.
+ * @param value
+ * @param block Block the value is used in, the predecessor for phi operands.
+ * @param type Type the operand must have, `IT_VOID` for any value.
+ * @return
+ */
+static bool check_operand(Check *c, IrRef i, IrRef value, uint32_t block, IrType type) {
+    const IrFunc *fn = c->fn;
+    if (value >= fn->inst_count) return bad_inst(c, i, "operand out of range");
+
+    const IrInst *def = &fn->insts[value];
+    if (def->type == IT_VOID) return bad_inst(c, i, "operand without value");
+    if (type != IT_VOID && def->type != type) return bad_inst(c, i, "operand of the wrong type");
+
+    bool phi = fn->insts[i].op == IR_PHI;
+    if (def->block == block ? !phi && value >= i : !dominates(c, def->block, block)) {
+        return bad_inst(c, i, "operand does not dominate its use");
+    }
+    return true;
+}
+
+/**
+ * @brief Checks the operands and type of one instruction.
+ * @param c
+ * @param i
+ * @return
+ */
+static bool check_inst(Check *c, IrRef i) {
+    const IrModule *mod = c->mod;
+    const IrFunc *fn    = c->fn;
+    const IrInst *inst  = &fn->insts[i];
+    IrType type         = inst->type;
+    uint32_t block      = inst->block;
+
+    if (inst->op >= IR_OP_COUNT || type >= IT_COUNT) return bad_inst(c, i, "unknown instruction");
+
+    switch (inst->op) {
+    case IR_CONST:
+        if (type == IT_VOID) return bad_inst(c, i, "constant without type");
+        return true;
+    case IR_UNDEF:
+        if (type == IT_VOID) return bad_inst(c, i, "undefined value without type");
+        return true;
+    case IR_PARAM:
+        if (block != 0 || inst->index >= fn->param_count || type != fn->params[inst->index]) {
+            return bad_inst(c, i, "parameter does not match the signature");
+        }
+        return true;
+    case IR_PHI: {
+        const uint32_t *preds = &fn->extra[fn->blocks[block].preds];
+        if (type == IT_VOID || inst->arg + 1 + preds[0] > fn->extra_count ||
+            fn->extra[inst->arg] != preds[0]) {
+            return bad_inst(c, i, "phi does not match the predecessors");
+        }
+        for (uint32_t k = 1; k <= preds[0]; k++) {
+            if (!check_operand(c, i, fn->extra[inst->arg + k], preds[k], type)) return false;
+        }
+        return true;
+    }
+    case IR_LOAD:
+    case IR_STORE: {
+        if (inst->index >= mod->global_count) return bad_inst(c, i, "global out of range");
+        IrType gtype = mod->globals[inst->index].type;
+
+        if (inst->op == IR_LOAD) {
+            return type == gtype || bad_inst(c, i, "load of the wrong type");
+        }
+        return (type == IT_VOID || bad_inst(c, i, "store with a value")) &&
+               check_operand(c, i, inst->arg, block, gtype);
+    }
+    case IR_CALL: {
+        if (inst->index >= mod->func_count) return bad_inst(c, i, "function out of range");
+
+        const IrFunc *callee = &mod->funcs[inst->index];
+        if (type != callee->ret || inst->arg + 1 + callee->param_count > fn->extra_count ||
+            fn->extra[inst->arg] != callee->param_count) {
+            return bad_inst(c, i, "call does not match the signature");
+        }
+        for (uint32_t k = 0; k < callee->param_count; k++) {
+            if (!check_operand(c, i, fn->extra[inst->arg + 1 + k], block, callee->params[k])) {
+                return false;
+            }
+        }
+        return true;
+    }
+    case IR_NEG:
+        if (!is_arith_type(type)) return bad_inst(c, i, "negation of a non arithmetic type");
+        return check_operand(c, i, inst->ops[0], block, type);
+    case IR_NOT:
+        if (type != IT_BOOL) return bad_inst(c, i, "logical not of a non boolean type");
+        return check_operand(c, i, inst->ops[0], block, IT_BOOL);
+    case IR_CONV: {
+        if (!is_arith_type(type) && type != IT_BOOL) {
+            return bad_inst(c, i, "conversion to a non scalar");
+        }
+        if (!check_operand(c, i, inst->ops[0], block, IT_VOID)) return false;
+
+        IrType from = fn->insts[inst->ops[0]].type;
+        return is_arith_type(from) || from == IT_BOOL ||
+               bad_inst(c, i, "conversion of a non scalar");
+    }
+    case IR_SHL:
+        if (type != IT_CHAR && type != IT_INT) {
+            return bad_inst(c, i, "shift of a non integer type");
+        }
+        if (inst->ops[1] < 1 || inst->ops[1] > 31) {
+            return bad_inst(c, i, "shift count out of range");
+        }
+        return check_operand(c, i, inst->ops[0], block, type);
+    case IR_JMP: return true;
+    case IR_BR:  return check_operand(c, i, inst->ops[0], block, IT_BOOL);
+    case IR_RET:
+        if (fn->ret == IT_VOID) {
+            return inst->ops[0] == IR_NONE || bad_inst(c, i, "value returned from a void function");
+        }
+        if (inst->ops[0] == IR_NONE) return bad_inst(c, i, "missing return value");
+        return check_operand(c, i, inst->ops[0], block, fn->ret);
+    default: break;
+    }
+
+    // Arithmetic and comparisons
+    if (is_arith_op(inst->op)) {
+        bool ok = inst->op == IR_MOD ? type == IT_CHAR || type == IT_INT : is_arith_type(type);
+        if (!ok) return bad_inst(c, i, "arithmetic on the wrong type");
+    } else if (type != IT_BOOL) {
+        return bad_inst(c, i, "comparison without boolean result");
+    }
+
+    IrType operand = is_arith_op(inst->op) ? type : IT_VOID;
+    if (!check_operand(c, i, inst->ops[0], block, operand)) return false;
+    if (operand == IT_VOID) {
+        operand = fn->insts[inst->ops[0]].type;
+        if (!is_arith_type(operand) && operand != IT_BOOL) {
+            return bad_inst(c, i, "comparison of a non scalar type");
+        }
+    }
+    return check_operand(c, i, inst->ops[1], block, operand);
+}
+
+/**
+ * @brief Checks one function body.
+ * @param c
+ * @return
+ */
+static bool check_func(Check *c) {
+    uint32_t n = c->fn->block_count;
+
+    c->mem = mem_malloc((9 * (size_t)n + 2) * sizeof(uint32_t));
+    if (!c->mem) {
+        fail_context(c->ctx, CERR_NOMEM, "out of memory while verifying IR");
+        return false;
+    }
+    c->rnum  = c->mem;
+    c->order = c->rnum + n;
+    c->idom  = c->order + n;
+    c->pre   = c->idom + n;
+    c->post  = c->pre + n;
+    c->first = c->post + n;
+    c->kids  = c->first + n + 1;
+    c->stack = c->kids + n;
+    c->mark  = c->stack + n;
+
+    bool ok = check_blocks(c) && check_dominance(c);
+    for (IrRef i = 0; ok && i < c->fn->inst_count; i++) ok = check_inst(c, i);
+
+    free(c->mem);
+    return ok;
+}
+
+bool verify_ir(CompilerContext *ctx, const IrModule *mod) {
+    for (uint32_t f = 0; f < mod->func_count; f++) {
+        Check c = {.ctx = ctx, .mod = mod, .fn = &mod->funcs[f]};
+        if (c.fn->insts && !check_func(&c)) return false;
+    }
+    return true;
+}
@@ -0,0 +1,321 @@
+#ifndef _IR_H
+#define _IR_H
+
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "arena.h"
+#include "context.h"
+
+/*
+ * Typed SSA intermediate representation. Every value is defined by exactly one
+ * instruction and named by its number, which is dense within the function. The
+ * instructions of a function live in one array grouped by block, a block being
+ * the range `[first, first + count)` with its phis first and its terminator
+ * last. Blocks are in reverse postorder, the entry block first. Operand lists
+ * of variable length live in the function's `extra` array as a count followed
+ * by the entries, like the child lists of the flat AST.
+ */
+
+typedef uint32_t IrRef; // Instruction number within its function
+
+#define IR_NONE UINT32_MAX // Absent value or block
+
+// Type of a value
+typedef enum {
+    IT_VOID,   // No value
+    IT_BOOL,   // Comparison and logic results
+    IT_CHAR,   // 8-bit integer
+    IT_INT,    // 32-bit integer
+    IT_FLOAT,  // Double precision
+    IT_STRING, // Pointer to constant characters
+    IT_COUNT,
+} IrType;
+
+typedef enum {
+    IR_CONST, // Constant of the instruction type
+    IR_UNDEF, // Variable read before it was written
+    IR_PARAM, // Parameter `index` of the function, entry block only
+    IR_PHI,   // Operand `i` of the `arg` list flows in from predecessor `i`
+    IR_LOAD,  // Reads global `index`
+    IR_CALL,  // Calls function `index` with the `arg` list
+    IR_NEG,   // Unary, `ops[0]` of the instruction type
+    IR_NOT,   // Unary, `ops[0]` of `IT_BOOL`
+    IR_CONV,  // Converts arithmetic or boolean `ops[0]` to the instruction type
+    IR_ADD,   // Arithmetic, `ops[0]` and `ops[1]` of the instruction type
+    IR_SUB,
+    IR_MUL,
+    IR_DIV,
+    IR_MOD,
+    IR_SHL, // `ops[0]` of `IT_CHAR` or `IT_INT` shifted left by the count `ops[1]`
+    IR_EQ,  // Comparison, `ops[0]` and `ops[1]` of one type, `IT_BOOL` result
+    IR_NE,
+    IR_LT,
+    IR_LE,
+    IR_GT,
+    IR_GE,
+    IR_STORE, // Writes value `arg` to global `index`
+    IR_JMP,   // Terminator, to successor 0
+    IR_BR,    // Terminator, to successor 0 if `ops[0]`, else to successor 1
+    IR_RET,   // Terminator, returns `ops[0]`, `IR_NONE` from a void function
+    IR_OP_COUNT,
+} IrOp;
+
+typedef struct {
+    uint8_t op;     // `IrOp`
+    uint8_t type;   // `IrType` of the value, `IT_VOID` if there is none
+    uint32_t block; // Block holding the instruction
+    union {
+        int32_t ival;     // `IR_CONST` of `IT_BOOL`, `IT_CHAR` and `IT_INT`
+        double fval;      // `IR_CONST` of `IT_FLOAT`
+        const char *sval; // `IR_CONST` of `IT_STRING`, owned by the parser's arena
+        IrRef ops[2];     // Unary and binary operands, condition or returned value
+        struct {
+            uint32_t index; // Parameter, global or function
+            uint32_t arg;   // Stored value, or `extra` index of the arguments or phi operands
+        };
+    };
+} IrInst;
+
+typedef struct {
+    IrRef first;       // First instruction
+    uint32_t count;    // Instructions, the terminator being the last one
+    uint32_t phis;     // Leading phis
+    uint32_t preds;    // `extra` list of predecessors, in phi operand order
+    uint32_t succs[2]; // Successors of the terminator, `IR_NONE` when it has fewer
+} IrBlock;
+
+typedef struct {
+    const Atom *name;
+    uint8_t ret;           // Returned `IrType`
+    const uint8_t *params; // `IrType` of every parameter
+    uint32_t param_count;
+    IrInst *insts;   // NULL for a function declared without body
+    IrBlock *blocks; // Entry block first
+    uint32_t *extra; // Operand and predecessor lists
+    uint32_t inst_count;
+    uint32_t block_count;
+    uint32_t extra_count;
+} IrFunc;
+
+typedef struct {
+    const Atom *name;
+    uint8_t type; // `IrType`
+} IrGlobal;
+
+// Functions and globals of one program, referred to by index
+typedef struct {
+    IrFunc *funcs;
+    IrGlobal *globals;
+    uint32_t func_count, func_cap;
+    uint32_t global_count, global_cap;
+    Arena arena; // Parameter types and the finished arrays of every function
+} IrModule;
+
+// Builds the bodies of a module's functions one at a time, see `ir.c`
+typedef struct IrBuilder IrBuilder;
+
+/**
+ * @brief Creates an empty module.
+ * @return NULL if memory ran out.
+ */
+IrModule *make_module();
+
+/**
+ * @brief Frees a module with every function and global.
+ * @param mod
+ */
+void purge_module(IrModule *mod);
+
+/**
+ * @brief Adds a global variable.
+ * @param mod
+ * @param name
+ * @param type
+ * @return Index of the global, `IR_NONE` if memory ran out.
+ */
+uint32_t ir_add_global(IrModule *mod, const Atom *name, IrType type);
+
+/**
+ * @brief Adds a function without body, `ir_begin` gives it one.
+ * @param mod
+ * @param name
+ * @param ret
+ * @param params Type of every parameter, copied.
+ * @param count Number of parameters.
+ * @return Index of the function, `IR_NONE` if memory ran out.
+ */
+uint32_t ir_add_func(
+    IrModule *mod, const Atom *name, IrType ret, const IrType *params, uint32_t count
+);
+
+/**
+ * @brief Number of instructions of every function.
+ * @param mod
+ * @return
+ */
+size_t ir_inst_count(const IrModule *mod);
+
+/**
+ * @brief Creates a builder adding to `mod`. Its scratch arrays are reused by
+ * every function it builds.
+ * @param mod
+ * @param fail Where running out of memory in any builder call jumps to.
+ * @return NULL if memory ran out.
+ */
+IrBuilder *make_builder(IrModule *mod, jmp_buf *fail);
+
+/**
+ * @brief Frees a builder, the functions it built stay in the module.
+ * @param b
+ */
+void purge_builder(IrBuilder *b);
+
+/**
+ * @brief Starts the body of function `func` with a sealed entry block, which
+ * takes the next instructions.
+ * @param b
+ * @param func
+ */
+void ir_begin(IrBuilder *b, uint32_t func);
+
+/**
+ * @brief Finishes the body. Blocks left open return, an undefined value unless
+ * the function returns void. Unreachable blocks are dropped, phis that merge a
+ * single value are replaced by it, and the rest is numbered and copied into
+ * the module's arena.
+ * @param b
+ */
+void ir_end(IrBuilder *b);
+
+/**
+ * @brief Adds an empty block, it takes instructions once `ir_set_block`
+ * selects it.
+ * @param b
+ * @return
+ */
+uint32_t ir_block(IrBuilder *b);
+
+/**
+ * @brief Selects the block that takes the next instructions. Instructions
+ * added after its terminator go to a new unreachable block.
+ * @param b
+ * @param block
+ */
+void ir_set_block(IrBuilder *b, uint32_t block);
+
+/**
+ * @brief Declares that every predecessor of `block` is known, which completes
+ * the phis its variable reads created.
+ * @param b
+ * @param block
+ */
+void ir_seal(IrBuilder *b, uint32_t block);
+
+/**
+ * @brief Adds a variable of the function being built. Its reads are answered
+ * with the SSA value reaching them, through a phi where several do.
+ * @param b
+ * @param type
+ * @return
+ */
+uint32_t ir_var(IrBuilder *b, IrType type);
+
+/**
+ * @brief Writes a variable in the current block.
+ * @param b
+ * @param var
+ * @param value Of the variable's type.
+ */
+void ir_def(IrBuilder *b, uint32_t var, IrRef value);
+
+/**
+ * @brief Reads a variable in the current block.
+ * @param b
+ * @param var
+ * @return The value reaching the current block, a phi where several do.
+ */
+IrRef ir_use(IrBuilder *b, uint32_t var);
+
+/**
+ * @brief Type of a value of the function being built.
+ * @param b
+ * @param value
+ * @return
+ */
+IrType ir_type(const IrBuilder *b, IrRef value);
+
+IrRef ir_const_int(IrBuilder *b, IrType type, int32_t value);
+IrRef ir_const_float(IrBuilder *b, double value);
+IrRef ir_const_str(IrBuilder *b, const char *value);
+IrRef ir_param(IrBuilder *b, uint32_t index);
+IrRef ir_load(IrBuilder *b, uint32_t global);
+void ir_store(IrBuilder *b, uint32_t global, IrRef value);
+
+/**
+ * @brief Adds a negation or logical not.
+ * @param b
+ * @param op `IR_NEG` or `IR_NOT`.
+ * @param value
+ * @return
+ */
+IrRef ir_unary(IrBuilder *b, IrOp op, IrRef value);
+
+/**
+ * @brief Adds an arithmetic operation or comparison.
+ * @param b
+ * @param op `IR_ADD` to `IR_GE` but `IR_SHL`, which only folding creates.
+ * @param lhs
+ * @param rhs Of the type of `lhs`.
+ * @return
+ */
+IrRef ir_binary(IrBuilder *b, IrOp op, IrRef lhs, IrRef rhs);
+
+/**
+ * @brief Converts a value to `type`.
+ * @param b
+ * @param type
+ * @param value
+ * @return `value` itself if it already has that type.
+ */
+IrRef ir_conv(IrBuilder *b, IrType type, IrRef value);
+
+/**
+ * @brief Adds a call.
+ * @param b
+ * @param func
+ * @param args Arguments of the parameter types, copied.
+ * @param count
+ * @return Returned value, of type `IT_VOID` for a void function.
+ */
+IrRef ir_call(IrBuilder *b, uint32_t func, const IrRef *args, uint32_t count);
+
+void ir_jump(IrBuilder *b, uint32_t target);
+void ir_branch(IrBuilder *b, IrRef cond, uint32_t then, uint32_t else_);
+
+/**
+ * @brief Returns from the function.
+ * @param b
+ * @param value `IR_NONE` from a void function.
+ */
+void ir_ret(IrBuilder *b, IrRef value);
+
+/**
+ * @brief Prints every global and function in textual form.
+ * @param mod
+ * @param out
+ */
+void print_ir(const IrModule *mod, FILE *out);
+
+/**
+ * @brief Checks the structure, types and dominance of every function body.
+ * The first violation is recorded in `ctx` as `CERR_IR`.
+ * @param ctx
+ * @param mod
+ * @return false if the module is invalid or memory ran out.
+ */
+bool verify_ir(CompilerContext *ctx, const IrModule *mod);
+
+#endif
@@ -1,16 +1,24 @@
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
+#include <limits.h>
 
 #include "utils.h"
+#include "memstat.h"
+#include "timing.h"
 #include "lexer.h"
+#include "charscan.h"
 
-#define TABLE_SIZE 256 // Hash-table size
-#define MAX_CHAIN 4    // Maximum
-
-void purge_lexer(Lexer *lexer);
+#define READ_CHUNK  65536 // Initial read size for non-mappable sources
+#define SHORT_RUN   16    // Runs are scanned inline up to this length before a vector scan
+#define STREAM_RING 16    // Streamed tokens kept for lookahead, must be a power of two
 
 // Token type to token string lookup table.
 const char *ttypestr[] = {
@@ -150,156 +158,239 @@ const char *ttypestr[] = {
     [T_EOF]     = "T_EOF",
 };
 
-typedef struct {
-    const char *kw;
-    TokType type;
-} KWElement;
-
-typedef struct {
-    KWElement elems[MAX_CHAIN];
-    int count;
-} KWBucket;
-
-// keyword hash-table
-static KWBucket kwtable[TABLE_SIZE] = {0};
-
 /**
- * @brief Adds new keyword entry to hash-table.
- * @param kw Keyword string.
- * @param type Token type.
+ * @brief Compares a spelling of known length against a keyword of the same length.
+ * @param str Spelling, not null terminated.
+ * @param kw Keyword.
+ * @param len Length of both.
+ * @param type Keyword token type.
+ * @return `type` on match, `T_IDENT` otherwise.
  */
-void add_keyword(const char *kw, TokType type) {
-    int idx       = hashfnv(kw, TABLE_SIZE);
-    KWBucket *bkt = &kwtable[idx];
+static TokType kwmatch(const char *str, const char *kw, size_t len, TokType type) {
+    return memcmp(str, kw, len) == 0 ? type : T_IDENT;
+}
 
-    if (bkt->count < MAX_CHAIN) {
-        bkt->elems[bkt->count].kw   = kw;
-        bkt->elems[bkt->count].type = type;
-        bkt->count++;
-    } else {
-        printf("Warning: Hash table overflow at index %u\n", idx);
+/**
+ * @brief Classifies an identifier as a keyword or `T_IDENT`.
+ * Dispatches on length and then first character, so every spelling is
+ * compared against at most a couple of keywords. Needs no initialization.
+ * @param str Spelling, not null terminated.
+ * @param len Spelling length.
+ * @return
+ */
+static TokType search_keyword(const char *str, size_t len) {
+    switch (len) {
+    case 2:
+        switch (str[0]) {
+        case 'd': return kwmatch(str, "do", 2, T_DO);
+        case 'i': return str[1] == 'f' ? T_IF : str[1] == 'n' ? T_IN : T_IDENT;
+        }
+        break;
+    case 3:
+        switch (str[0]) {
+        case 'f': return kwmatch(str, "for", 3, T_FOR);
+        case 'i': return kwmatch(str, "int", 3, T_INT);
+        case 'n': return kwmatch(str, "new", 3, T_NEW);
+        }
+        break;
+    case 4:
+        switch (str[0]) {
+        case 'c': return str[1] == 'h' ? kwmatch(str, "char", 4, T_CHAR) //
+                                       : kwmatch(str, "case", 4, T_CASE);
+        case 'e': return str[1] == 'n' ? kwmatch(str, "enum", 4, T_ENUM) //
+                                       : kwmatch(str, "else", 4, T_ELSE);
+        case 'f': return kwmatch(str, "from", 4, T_FROM);
+        case 'n': return kwmatch(str, "null", 4, T_NULL);
+        case 't': return str[1] == 'y' ? kwmatch(str, "type", 4, T_TYPE) //
+                                       : kwmatch(str, "this", 4, T_THIS);
+        case 'v': return kwmatch(str, "void", 4, T_VOID);
+        case 'w': return kwmatch(str, "wait", 4, T_WAIT);
+        }
+        break;
+    case 5:
+        switch (str[0]) {
+        case 'a': return kwmatch(str, "async", 5, T_ASYNC);
+        case 'b': return kwmatch(str, "break", 5, T_BREAK);
+        case 'c': return str[1] == 'o' ? kwmatch(str, "const", 5, T_CONST) //
+                                       : kwmatch(str, "class", 5, T_CLASS);
+        case 'e': return kwmatch(str, "error", 5, T_ERROR);
+        case 'f': return kwmatch(str, "float", 5, T_FLOAT);
+        case 'p': return kwmatch(str, "purge", 5, T_PURGE);
+        case 'w': return kwmatch(str, "while", 5, T_WHILE);
+        }
+        break;
+    case 6:
+        switch (str[0]) {
+        case 'a': return kwmatch(str, "atomic", 6, T_ATOMIC);
+        case 'e': return kwmatch(str, "extern", 6, T_EXTERN);
+        case 'i': return kwmatch(str, "import", 6, T_IMPORT);
+        case 'm': return kwmatch(str, "module", 6, T_MODULE);
+        case 'p': return kwmatch(str, "public", 6, T_PUBLIC);
+        case 'r': return kwmatch(str, "return", 6, T_RETURN);
+        case 't': return kwmatch(str, "thread", 6, T_THREAD);
+        case 's':
+            switch (str[1]) {
+            case 'i': return kwmatch(str, "sizeof", 6, T_SIZEOF);
+            case 'w': return kwmatch(str, "switch", 6, T_SWITCH);
+            case 't':
+                switch (str[3]) {
+                case 't': return kwmatch(str, "static", 6, T_STATIC);
+                case 'i': return kwmatch(str, "string", 6, T_STRING);
+                case 'u': return kwmatch(str, "struct", 6, T_STRUCT);
+                }
+            }
+        }
+        break;
+    case 7:
+        switch (str[0]) {
+        case 'd': return kwmatch(str, "default", 7, T_DEFAULT);
+        case 'f': return kwmatch(str, "foreach", 7, T_FOREACH);
+        case 'p': return kwmatch(str, "private", 7, T_PRIVATE);
+        }
+        break;
+    case 8:
+        switch (str[0]) {
+        case 'c': return kwmatch(str, "continue", 8, T_CONTINUE);
+        case 'v': return kwmatch(str, "volatile", 8, T_VOLATILE);
+        }
+        break;
+    case 9:
+        switch (str[0]) {
+        case 'i': return kwmatch(str, "interface", 9, T_INTERFACE);
+        case 'p': return kwmatch(str, "protected", 9, T_PROTECTED);
+        }
+        break;
     }
+    return T_IDENT;
 }
 
 /**
- * @brief Initialize keyword hash-table.
+ * @brief Maps a regular file read-only, followed by at least one zero byte.
+ * When the file ends exactly on a page boundary an anonymous zero page is
+ * reserved behind it, so the sentinel is guaranteed without copying.
+ * @param fd Open file descriptor.
+ * @param size File size in bytes.
+ * @return Mapped source, or NULL if the file can't be mapped.
  */
-void make_kwtable() {
-    // type modifiers
-    add_keyword("type", T_TYPE);
-
-    // async
-    add_keyword("async", T_ASYNC);
-    add_keyword("wait", T_WAIT);
-
-    // type qualifiers
-    add_keyword("const", T_CONST);
-    add_keyword("volatile", T_VOLATILE);
-    add_keyword("atomic", T_ATOMIC);
-
-    // access specifier
-    add_keyword("public", T_PUBLIC);
-    add_keyword("protected", T_PROTECTED);
-    add_keyword("private", T_PRIVATE);
+static const char *map_source(int fd, size_t size) {
+    size_t pgsz = (size_t)sysconf(_SC_PAGESIZE);
 
-    // storage class
-    add_keyword("static", T_STATIC);
-    add_keyword("extern", T_EXTERN);
-    add_keyword("thread", T_THREAD);
-
-    // types
-    add_keyword("void", T_VOID);
-    add_keyword("int", T_INT);
-    add_keyword("float", T_FLOAT);
-    add_keyword("char", T_CHAR);
-    add_keyword("string", T_STRING);
-    add_keyword("enum", T_ENUM);
-    add_keyword("struct", T_STRUCT);
-    add_keyword("interface", T_INTERFACE);
-    add_keyword("class", T_CLASS);
-
-    // conditions
-    add_keyword("if", T_IF);
-    add_keyword("else", T_ELSE);
-    add_keyword("switch", T_SWITCH);
-    add_keyword("case", T_CASE);
-    add_keyword("default", T_DEFAULT);
-    add_keyword("break", T_BREAK);
-    add_keyword("continue", T_CONTINUE);
-
-    // loops
-    add_keyword("do", T_DO);
-    add_keyword("while", T_WHILE);
-    add_keyword("for", T_FOR);
-    add_keyword("foreach", T_FOREACH);
-    add_keyword("in", T_IN);
-
-    // module
-    add_keyword("module", T_MODULE);
-    add_keyword("import", T_IMPORT);
-    add_keyword("from", T_FROM);
-
-    // function
-    add_keyword("return", T_RETURN);
+    if (size % pgsz != 0) {
+        // bytes past end of file in the last page read as zero
+        void *src = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        return src == MAP_FAILED ? NULL : src;
+    }
 
-    // memory operations
-    add_keyword("new", T_NEW);
-    add_keyword("null", T_NULL);
-    add_keyword("sizeof", T_SIZEOF);
-    add_keyword("this", T_THIS);
-    add_keyword("purge", T_PURGE);
+    void *base = mmap(NULL, size + pgsz, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) return NULL;
 
-    // others
-    add_keyword("error", T_ERROR);
+    if (mmap(base, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, size + pgsz);
+        return NULL;
+    }
+    return base;
 }
 
 /**
- * @brief Finds a keyword from the hash-table.
- * @param kw Key to search.
- * @return
+ * @brief Reads everything from `fd` into a heap buffer terminated by '\0'.
+ * Used for pipes, stdin and anything else that can't be mapped.
+ * @param fd Open file descriptor.
+ * @param size Receives the number of bytes read.
+ * @return NULL on failure, with `errno` set.
  */
-KWElement *search_keyword(const char *kw) {
-    int idx       = hashfnv(kw, TABLE_SIZE);
-    KWBucket *bkt = &kwtable[idx];
+static char *read_source(int fd, size_t *size) {
+    size_t cap = READ_CHUNK;
+    size_t len = 0;
+    char *buf  = mem_malloc(cap + 1);
+    if (!buf) return NULL;
+
+    ssize_t n;
+    while ((n = read(fd, buf + len, cap - len)) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            free(buf);
+            return NULL;
+        }
 
-    for (int i = 0; i < bkt->count; i++) {
-        if (strcmp(bkt->elems[i].kw, kw) == 0) {
-            return &bkt->elems[i];
+        len += n;
+        if (len == cap) {
+            cap *= 2;
+            char *grown = mem_realloc(buf, cap + 1);
+            if (!grown) {
+                free(buf);
+                return NULL;
+            }
+            buf = grown;
         }
     }
-    return NULL; // Not found
+    buf[len] = '\0';
+
+    *size = len;
+    return buf;
 }
 
 /**
- * @brief Creates lexer and store source code to it's `buffer`.
+ * @brief Creates lexer and loads the source into it's `buffer`.
+ * Regular files are memory-mapped so tokens are scanned straight out of the
+ * page cache, pipes and stdin (`-`) fall back to reading.
+ * @param ctx
  * @param path File name with path.
  * @return
  */
-Lexer *make_lexer(const char *path) {
-    Lexer *lexer = malloc(sizeof(Lexer));
-    if (!lexer) errexit("lexer allocation failed");
+Lexer *make_lexer(CompilerContext *ctx, const char *path) {
+    Lexer *lexer = mem_malloc(sizeof(Lexer));
+    if (!lexer) {
+        fail_context(ctx, CERR_NOMEM, "lexer allocation failed");
+        return NULL;
+    }
 
-    struct stat st;
-    if (stat(path, &st) == -1) errexit("failed to get stats");
+    init_charscan();
 
-    long fsize  = st.st_size;
-    lexer->col  = 1;
-    lexer->pos  = -1;
-    lexer->line = 1;
+    lexer->ctx    = ctx;
+    lexer->col    = 1;
+    lexer->pos    = -1;
+    lexer->line   = 1;
+    lexer->buffer = NULL;
+    lexer->mapped = false;
+    lexer->engine = LEX_HAND;
 
-    FILE *file = fopen(path, "r");
-    if (!file) errexit("failed to open file");
+    bool isstdin = strcmp(path, "-") == 0;
+    int fd       = isstdin ? STDIN_FILENO : open(path, O_RDONLY);
+    if (fd == -1) {
+        fail_context(ctx, CERR_IO, "failed to open file '%s'", path);
+        free(lexer);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        fail_context(ctx, CERR_IO, "failed to get stats of '%s'", path);
+        if (!isstdin) close(fd);
+        free(lexer);
+        return NULL;
+    }
+
+    if (S_ISREG(st.st_mode) && st.st_size > 0) {
+        lexer->size   = st.st_size;
+        lexer->buffer = map_source(fd, lexer->size);
+        lexer->mapped = lexer->buffer != NULL;
+    }
 
-    // allocate memory for the file
-    lexer->buffer = malloc(fsize + 1);
-    if (!lexer->buffer) errexit("buffer allocation failed");
+    if (!lexer->mapped) {
+        lexer->buffer = read_source(fd, &lexer->size);
+    } else {
+        posix_madvise((void *)lexer->buffer, lexer->size, POSIX_MADV_SEQUENTIAL);
+    }
 
-    // read the file into buffer
-    fread(lexer->buffer, 1, fsize, file);
-    lexer->buffer[fsize] = '\0';
+    if (!lexer->buffer) {
+        CompErr err = errno == ENOMEM ? CERR_NOMEM : CERR_IO;
+        fail_context(ctx, err, "failed to read file '%s'", path);
+        if (!isstdin) close(fd);
+        free(lexer);
+        return NULL;
+    }
 
-    // close file
-    fclose(file);
+    if (!isstdin) close(fd);
 
     return lexer;
 }
@@ -343,56 +434,67 @@ static char peekfw3(Lexer *lexer) {
  * @param lexer
  */
 static void skip_blank(Lexer *lexer) {
-    char next = peekfw1(lexer);
-    while (isblank(next)) {
-        advance(lexer, 1, true);
-        next = peekfw1(lexer);
-    }
+    const char *next = lexer->buffer + lexer->pos + 1;
+    int len          = 0;
+
+    // Most runs are short, only deep indentation is worth a vector scan
+    while (len < SHORT_RUN && isblank(next[len])) len++;
+    if (len == SHORT_RUN) len += span_blank(next + len, lexer->buffer + lexer->size);
+
+    advance(lexer, len, true);
 }
 
-static Token *new_token(Lexer *lexer, TokType type, int len, bool movecol) {
+static Token new_token(Lexer *lexer, TokType type, int len, bool movecol) {
     advance(lexer, len, movecol);
 
-    Token *token = malloc(sizeof(Token));
-    token->type  = type;
-    token->value = NULL;
-    token->line  = lexer->line;
-    token->col   = lexer->col - len;
+    Token token = {
+        .type = type,
+        .off  = lexer->pos - len + 1,
+        .len  = len,
+        .hash = 0,
+        .line = lexer->line,
+        .col  = lexer->col - len,
+    };
 
     return token;
 }
 
 /**
- * @brief Recognise the number, tokenize return it.
+ * @brief Starts a token whose value begins at the next input character.
  * @param lexer
+ * @param type Token type.
  * @return
  */
-static Token *scan_number(Lexer *lexer) {
-    Token *token = malloc(sizeof(Token));
-    token->type  = T_INT_LIT;
-    token->value = NULL;
-    token->line  = lexer->line;
-    token->col   = lexer->col;
+static Token start_token(Lexer *lexer, TokType type) {
+    Token token = {
+        .type = type,
+        .off  = lexer->pos + 1,
+        .len  = 0,
+        .hash = 0,
+        .line = lexer->line,
+        .col  = lexer->col,
+    };
 
-    size_t cap = 64;
-    char *buf  = malloc(cap);
-    size_t len = 0;
-    char next  = peekfw1(lexer);
+    return token;
+}
+
+/**
+ * @brief Recognise the number, tokenize return it.
+ * @param lexer
+ * @return
+ */
+static Token scan_number(Lexer *lexer) {
+    Token token = start_token(lexer, T_INT_LIT);
+    char next   = peekfw1(lexer);
 
     while (isdigit(next) || next == '.' || next == '_') {
-        if (next == '.') token->type = T_FLOAT_LIT;
+        if (next == '.') token.type = T_FLOAT_LIT;
 
-        if (len + 1 >= cap) {
-            cap *= 2;
-            buf = realloc(buf, cap);
-        }
-        buf[len++] = next;
         advance(lexer, 1, true);
         next = peekfw1(lexer);
     }
 
-    buf[len]     = '\0';
-    token->value = buf;
+    token.len = lexer->pos + 1 - token.off;
     return token;
 }
 
@@ -401,37 +503,31 @@ static Token *scan_number(Lexer *lexer) {
  * @param lexer
  * @return
  */
-static Token *scan_identifier(Lexer *lexer) {
-    Token *token = malloc(sizeof(Token));
-    token->type  = T_IDENT;
-    token->value = NULL;
-    token->line  = lexer->line;
-    token->col   = lexer->col;
-
-    size_t cap = 64;
-    char *buf  = malloc(cap);
-    size_t len = 0;
-    char c     = peekfw1(lexer);
-
-    while (isalnum(c) || c == '_') {
-        if (len + 1 >= cap) {
-            cap *= 2;
-            buf = realloc(buf, cap);
+static Token scan_identifier(Lexer *lexer) {
+    Token token     = start_token(lexer, T_IDENT);
+    const char *str = lexer->buffer + token.off;
+    unsigned hash   = FNV_OFFSET;
+    unsigned len    = 0;
+
+    // Short identifiers are hashed while scanning, long ones are measured first
+    while (len < SHORT_RUN && (isalnum(str[len]) || str[len] == '_')) {
+        hash ^= (unsigned char)str[len++];
+        hash *= FNV_PRIME;
+    }
+    if (len == SHORT_RUN) {
+        unsigned end = len + span_ident(str + len, lexer->buffer + lexer->size);
+        for (; len < end; len++) {
+            hash ^= (unsigned char)str[len];
+            hash *= FNV_PRIME;
         }
-        buf[len++] = c;
-        advance(lexer, 1, true);
-        c = peekfw1(lexer);
     }
-    buf[len] = '\0';
+
+    token.len  = len;
+    token.hash = hash;
+    advance(lexer, len, true);
 
     // Check for keywords
-    KWElement *kw = search_keyword(buf);
-    if (kw) {
-        token->type = kw->type;
-        free(buf); // Don't need value for keywords
-    } else {
-        token->value = buf;
-    }
+    token.type = search_keyword(lexer->buffer + token.off, token.len);
 
     return token;
 }
@@ -441,36 +537,23 @@ static Token *scan_identifier(Lexer *lexer) {
  * @param lexer
  * @return
  */
-static Token *scan_string(Lexer *lexer) {
-    Token *token = malloc(sizeof(Token));
-    token->type  = T_STRING_LIT;
-    token->value = NULL;
-    token->line  = lexer->line;
-    token->col   = lexer->col;
+static Token scan_string(Lexer *lexer) {
+    Token token = start_token(lexer, T_STRING_LIT);
 
     advance(lexer, 1, true); // Skip opening quote
-    size_t cap = 64;
-    char *buf  = malloc(cap);
-    size_t len = 0;
-    char next  = peekfw1(lexer);
+    token.off = lexer->pos + 1;
+    char next = peekfw1(lexer);
 
     while (next != '"' && next != '\0') {
-        if (len + 1 >= cap) {
-            cap *= 2;
-            buf = realloc(buf, cap);
-        }
-        buf[len++] = next;
         advance(lexer, 1, true);
         next = peekfw1(lexer);
     }
+    token.len = lexer->pos + 1 - token.off;
 
     if (next == '"') {
         advance(lexer, 1, true);
-        buf[len]     = '\0';
-        token->value = buf;
     } else {
-        free(buf);
-        token->type = T_UNKNOWN;
+        token.type = T_UNKNOWN;
     }
 
     return token;
@@ -481,31 +564,24 @@ static Token *scan_string(Lexer *lexer) {
  * @param lexer
  * @return
  */
-static Token *scan_character(Lexer *lexer) {
-    Token *token = malloc(sizeof(Token));
-    token->type  = T_CHAR_LIT;
-    token->value = NULL;
-    token->line  = lexer->line;
-    token->col   = lexer->col;
+static Token scan_character(Lexer *lexer) {
+    Token token = start_token(lexer, T_CHAR_LIT);
 
     advance(lexer, 1, true); // Skip opening quote
+    token.off = lexer->pos + 1;
     char next = peekfw1(lexer);
 
     if (next != '\'') {
-        token->value    = malloc(2);
-        token->value[0] = next;
-        token->value[1] = '\0';
+        token.len = 1;
         advance(lexer, 1, true);
 
         if (peekfw1(lexer) != '\'') {
-            free(token->value);
-            token->value = NULL;
-            token->type  = T_UNKNOWN;
+            token.type = T_UNKNOWN;
         } else {
             advance(lexer, 1, true);
         }
     } else {
-        token->type = T_UNKNOWN;
+        token.type = T_UNKNOWN;
     }
 
     return token;
@@ -516,35 +592,34 @@ static Token *scan_character(Lexer *lexer) {
  * @param lexer
  */
 static void scan_comment(Lexer *lexer) {
-    char next  = peekfw1(lexer);
-    char ptk   = peekfw1(lexer);
-    int buffsz = strlen(lexer->buffer);
-
-    if (next == '/' && ptk == '*') { // multi-line comment
-        advance(lexer, 2, true);     // skip '/*'
-        while (lexer->pos < buffsz) {
-            if (peekfw1(lexer) == '*' && peekfw1(lexer) == '/') {
-                advance(lexer, 2, true); // skip '*/'
-                return;
-            }
-            if (peekfw1(lexer) == '\n') {
+    const char *end = lexer->buffer + lexer->size;
+    char next       = peekfw1(lexer);
+
+    if (next == '/' && peekfw2(lexer) == '*') { // multi-line comment
+        advance(lexer, 2, true);                // skip '/*'
+        while (lexer->pos + 1 < (int)lexer->size) {
+            // Jump to the next candidate terminator or line break
+            const char *body = lexer->buffer + lexer->pos + 1;
+            size_t n         = find_either(body, end, '*', '\n');
+            advance(lexer, n, true);
+
+            if (body + n >= end) return; // unterminated comment
+
+            if (body[n] == '\n') {
                 lexer->line++;
                 lexer->col = 1;
                 advance(lexer, 1, false);
+            } else if (body[n + 1] == '/') {
+                advance(lexer, 2, true); // skip '*/'
+                return;
             } else {
                 advance(lexer, 1, true);
             }
         }
-    } else if (next == '/' && ptk == '/') { // single-line comment
-        advance(lexer, 2, true);            // skip '//'
-        while (lexer->pos < buffsz && peekfw1(lexer) != '\n') {
-            advance(lexer, 1, true);
-        }
-    } else if (next == '#') {    // hash-style comment
-        advance(lexer, 1, true); // skip '#'
-        while (lexer->pos < buffsz && peekfw1(lexer) != '\n') {
-            advance(lexer, 1, true);
-        }
+    } else { // single-line '//' or hash-style '#' comment, up to the line break
+        advance(lexer, next == '#' ? 1 : 2, true);
+        const char *body = lexer->buffer + lexer->pos + 1;
+        advance(lexer, find_either(body, end, '\n', '\n'), true);
     }
 }
 
@@ -553,21 +628,24 @@ static void scan_comment(Lexer *lexer) {
  * @param lexer
  * @return
  */
-static Token *scan_next(Lexer *lexer) {
-    skip_blank(lexer);
-    char next = peekfw1(lexer);
+static Token scan_next(Lexer *lexer) {
+    char next;
 
-    if (next == '\n' || next == '\r') {
-        lexer->line++;
-        lexer->col = 1; // reset for new line
-        advance(lexer, 1, false);
-        return scan_next(lexer); // recursively get the next token
-    }
+    // Skip blanks, line breaks and comments in a loop, scan workers have small stacks
+    for (;;) {
+        skip_blank(lexer);
+        next = peekfw1(lexer);
 
-    // handle comments
-    if ((next == '/' && (peekfw2(lexer) == '*' || peekfw2(lexer) == '/')) || next == '#') {
-        scan_comment(lexer);     // skip the comment
-        return scan_next(lexer); // recursively get the next token after the comment
+        if (next == '\n' || next == '\r') {
+            lexer->line++;
+            lexer->col = 1; // reset for new line
+            advance(lexer, 1, false);
+        } else if ((next == '/' && (peekfw2(lexer) == '*' || peekfw2(lexer) == '/')) ||
+                   next == '#') {
+            scan_comment(lexer); // skip the comment
+        } else {
+            break;
+        }
     }
 
     if (isalpha(next) || next == '_') return scan_identifier(lexer);
@@ -600,6 +678,7 @@ static Token *scan_next(Lexer *lexer) {
     if (next == '|' && peekfw2(lexer) == '=') return new_token(lexer, T_OREQ, 2, true);
 
     // Single-character Operators
+    if (next == '<') return new_token(lexer, T_LT, 1, true);
     if (next == '>') return new_token(lexer, T_GT, 1, true);
     if (next == '=') return new_token(lexer, T_EQ, 1, true);
     if (next == '+') return new_token(lexer, T_PLUS, 1, true);
@@ -630,39 +709,738 @@ static Token *scan_next(Lexer *lexer) {
     return new_token(lexer, T_UNKNOWN, 1, true);
 }
 
+/*
+ * Table-driven DFA scanner, the `LEX_DFA` engine.
+ * Every byte maps to a character class, and (state, class) maps to the next
+ * state. The scanner steps until a state has no transition (`S_STOP`), so the
+ * longest match wins, then performs the action of the state it stopped in.
+ * Literal and comment bodies are delegated to the hand-coded sub-scanners.
+ */
+
+// Character classes, unlisted bytes are `CC_OTHER`
+typedef enum {
+    CC_OTHER,
+    CC_NUL,
+    CC_BLANK,
+    CC_NEWLINE,
+    CC_ALPHA,
+    CC_UNDER,
+    CC_DIGIT,
+    CC_DOT,
+    CC_DQUOTE,
+    CC_SQUOTE,
+    CC_HASH,
+    CC_SLASH,
+    CC_STAR,
+    CC_EQ,
+    CC_BANG,
+    CC_LT,
+    CC_GT,
+    CC_PLUS,
+    CC_MINUS,
+    CC_PERCENT,
+    CC_AMP,
+    CC_PIPE,
+    CC_CARET,
+    CC_PUNCT, // Single character tokens, see `punctok`
+    CC_COUNT,
+} CharClass;
+
+// DFA states, `S_STOP` is zero so missing transitions stop the scanner
+typedef enum {
+    S_STOP,
+    S_START,
+    S_BLANK,
+    S_NEWLINE,
+    S_IDENT,
+    S_INT,
+    S_FLOAT,
+    S_STRING,
+    S_CHAR,
+    S_COMMENT,
+    S_UNKNOWN,
+    S_PUNCT,
+    S_DOT,
+    S_LT,
+    S_LTLT,
+    S_LTEQ,
+    S_LTLTEQ,
+    S_GT,
+    S_GTGT,
+    S_GTEQ,
+    S_GTGTEQ,
+    S_EQ,
+    S_EQEQ,
+    S_BANG,
+    S_NTEQ,
+    S_PLUS,
+    S_PLUSEQ,
+    S_MINUS,
+    S_MINUSEQ,
+    S_STAR,
+    S_MULEQ,
+    S_SLASH,
+    S_DIVEQ,
+    S_PERCENT,
+    S_MODEQ,
+    S_AMP,
+    S_AND,
+    S_ANDEQ,
+    S_PIPE,
+    S_OR,
+    S_OREQ,
+    S_CARET,
+    S_XOREQ,
+    S_COUNT,
+} DFAState;
+
+// What to do with the bytes matched when the scanner stops in a state
+typedef enum {
+    ACT_EOF,     // End of input, nothing matched
+    ACT_TOKEN,   // Emit the state's token type
+    ACT_PUNCT,   // Emit the single character token of the first byte
+    ACT_IDENT,   // Emit an identifier or keyword
+    ACT_BLANK,   // Skip blanks
+    ACT_NEWLINE, // Skip line breaks
+    ACT_COMMENT, // Skip a comment with `scan_comment`
+    ACT_STRING,  // Scan with `scan_string`
+    ACT_CHAR,    // Scan with `scan_character`
+} DFAAction;
+
+typedef struct {
+    uint8_t action; // `DFAAction`
+    uint8_t type;   // `TokType` for `ACT_TOKEN`
+} DFAAccept;
+
+static const uint8_t charclass[256] = {
+    ['\0'] = CC_NUL,     //
+    [' ']  = CC_BLANK,   //
+    ['\t'] = CC_BLANK,   //
+    ['\n'] = CC_NEWLINE, //
+    ['\r'] = CC_NEWLINE, //
+
+    ['a' ... 'z'] = CC_ALPHA, //
+    ['A' ... 'Z'] = CC_ALPHA, //
+    ['0' ... '9'] = CC_DIGIT, //
+    ['_']         = CC_UNDER, //
+
+    ['.']  = CC_DOT,     //
+    ['"']  = CC_DQUOTE,  //
+    ['\''] = CC_SQUOTE,  //
+    ['#']  = CC_HASH,    //
+    ['/']  = CC_SLASH,   //
+    ['*']  = CC_STAR,    //
+    ['=']  = CC_EQ,      //
+    ['!']  = CC_BANG,    //
+    ['<']  = CC_LT,      //
+    ['>']  = CC_GT,      //
+    ['+']  = CC_PLUS,    //
+    ['-']  = CC_MINUS,   //
+    ['%']  = CC_PERCENT, //
+    ['&']  = CC_AMP,     //
+    ['|']  = CC_PIPE,    //
+    ['^']  = CC_CARET,   //
+
+    [';']  = CC_PUNCT, //
+    ['\\'] = CC_PUNCT, //
+    ['?']  = CC_PUNCT, //
+    ['(']  = CC_PUNCT, //
+    [')']  = CC_PUNCT, //
+    ['{']  = CC_PUNCT, //
+    ['}']  = CC_PUNCT, //
+    ['[']  = CC_PUNCT, //
+    [']']  = CC_PUNCT, //
+    ['@']  = CC_PUNCT, //
+    ['~']  = CC_PUNCT, //
+    [':']  = CC_PUNCT, //
+    [',']  = CC_PUNCT, //
+};
+
+static const uint8_t punctok[256] = {
+    [';']  = T_SCOLON,   //
+    ['\\'] = T_BSLASH,   //
+    ['?']  = T_QMARK,    //
+    ['(']  = T_LPAREN,   //
+    [')']  = T_RPAREN,   //
+    ['{']  = T_LBRACE,   //
+    ['}']  = T_RBRACE,   //
+    ['[']  = T_LBRACKET, //
+    [']']  = T_RBRACKET, //
+    ['@']  = T_AT,       //
+    ['~']  = T_TILDE,    //
+    [':']  = T_COLON,    //
+    [',']  = T_COMMA,    //
+};
+
+static const uint8_t dfa_next[S_COUNT][CC_COUNT] = {
+    [S_START] =
+        {
+            [CC_OTHER]   = S_UNKNOWN,
+            [CC_BLANK]   = S_BLANK,
+            [CC_NEWLINE] = S_NEWLINE,
+            [CC_ALPHA]   = S_IDENT,
+            [CC_UNDER]   = S_IDENT,
+            [CC_DIGIT]   = S_INT,
+            [CC_DOT]     = S_DOT,
+            [CC_DQUOTE]  = S_STRING,
+            [CC_SQUOTE]  = S_CHAR,
+            [CC_HASH]    = S_COMMENT,
+            [CC_SLASH]   = S_SLASH,
+            [CC_STAR]    = S_STAR,
+            [CC_EQ]      = S_EQ,
+            [CC_BANG]    = S_BANG,
+            [CC_LT]      = S_LT,
+            [CC_GT]      = S_GT,
+            [CC_PLUS]    = S_PLUS,
+            [CC_MINUS]   = S_MINUS,
+            [CC_PERCENT] = S_PERCENT,
+            [CC_AMP]     = S_AMP,
+            [CC_PIPE]    = S_PIPE,
+            [CC_CARET]   = S_CARET,
+            [CC_PUNCT]   = S_PUNCT,
+        },
+
+    [S_BLANK]   = {[CC_BLANK] = S_BLANK},
+    [S_NEWLINE] = {[CC_NEWLINE] = S_NEWLINE},
+    [S_IDENT]   = {[CC_ALPHA] = S_IDENT, [CC_UNDER] = S_IDENT, [CC_DIGIT] = S_IDENT},
+    [S_INT]     = {[CC_DIGIT] = S_INT, [CC_UNDER] = S_INT, [CC_DOT] = S_FLOAT},
+    [S_FLOAT]   = {[CC_DIGIT] = S_FLOAT, [CC_UNDER] = S_FLOAT, [CC_DOT] = S_FLOAT},
+
+    [S_LT]      = {[CC_LT] = S_LTLT, [CC_EQ] = S_LTEQ},
+    [S_LTLT]    = {[CC_EQ] = S_LTLTEQ},
+    [S_GT]      = {[CC_GT] = S_GTGT, [CC_EQ] = S_GTEQ},
+    [S_GTGT]    = {[CC_EQ] = S_GTGTEQ},
+    [S_EQ]      = {[CC_EQ] = S_EQEQ},
+    [S_BANG]    = {[CC_EQ] = S_NTEQ},
+    [S_PLUS]    = {[CC_EQ] = S_PLUSEQ},
+    [S_MINUS]   = {[CC_EQ] = S_MINUSEQ},
+    [S_STAR]    = {[CC_EQ] = S_MULEQ},
+    [S_SLASH]   = {[CC_EQ] = S_DIVEQ, [CC_SLASH] = S_COMMENT, [CC_STAR] = S_COMMENT},
+    [S_PERCENT] = {[CC_EQ] = S_MODEQ},
+    [S_AMP]     = {[CC_AMP] = S_AND, [CC_EQ] = S_ANDEQ},
+    [S_PIPE]    = {[CC_PIPE] = S_OR, [CC_EQ] = S_OREQ},
+    [S_CARET]   = {[CC_EQ] = S_XOREQ},
+};
+
+static const DFAAccept dfa_accept[S_COUNT] = {
+    [S_START]   = {ACT_EOF, T_EOF},
+    [S_BLANK]   = {ACT_BLANK, 0},
+    [S_NEWLINE] = {ACT_NEWLINE, 0},
+    [S_IDENT]   = {ACT_IDENT, T_IDENT},
+    [S_INT]     = {ACT_TOKEN, T_INT_LIT},
+    [S_FLOAT]   = {ACT_TOKEN, T_FLOAT_LIT},
+    [S_STRING]  = {ACT_STRING, 0},
+    [S_CHAR]    = {ACT_CHAR, 0},
+    [S_COMMENT] = {ACT_COMMENT, 0},
+    [S_UNKNOWN] = {ACT_TOKEN, T_UNKNOWN},
+    [S_PUNCT]   = {ACT_PUNCT, 0},
+    [S_DOT]     = {ACT_TOKEN, T_DOT},
+    [S_LT]      = {ACT_TOKEN, T_LT},
+    [S_LTLT]    = {ACT_TOKEN, T_LSHIFT},
+    [S_LTEQ]    = {ACT_TOKEN, T_LTEQ},
+    [S_LTLTEQ]  = {ACT_TOKEN, T_LSHIFTEQ},
+    [S_GT]      = {ACT_TOKEN, T_GT},
+    [S_GTGT]    = {ACT_TOKEN, T_RSHIFT},
+    [S_GTEQ]    = {ACT_TOKEN, T_GTEQ},
+    [S_GTGTEQ]  = {ACT_TOKEN, T_RSHIFTEQ},
+    [S_EQ]      = {ACT_TOKEN, T_EQ},
+    [S_EQEQ]    = {ACT_TOKEN, T_EQEQ},
+    [S_BANG]    = {ACT_TOKEN, T_BANG},
+    [S_NTEQ]    = {ACT_TOKEN, T_NTEQ},
+    [S_PLUS]    = {ACT_TOKEN, T_PLUS},
+    [S_PLUSEQ]  = {ACT_TOKEN, T_PLUSEQ},
+    [S_MINUS]   = {ACT_TOKEN, T_MINUS},
+    [S_MINUSEQ] = {ACT_TOKEN, T_MINUSEQ},
+    [S_STAR]    = {ACT_TOKEN, T_ASTERISK},
+    [S_MULEQ]   = {ACT_TOKEN, T_MULEQ},
+    [S_SLASH]   = {ACT_TOKEN, T_FSLASH},
+    [S_DIVEQ]   = {ACT_TOKEN, T_DIVEQ},
+    [S_PERCENT] = {ACT_TOKEN, T_MODULUS},
+    [S_MODEQ]   = {ACT_TOKEN, T_MODEQ},
+    [S_AMP]     = {ACT_TOKEN, T_AMPERSAND},
+    [S_AND]     = {ACT_TOKEN, T_AND},
+    [S_ANDEQ]   = {ACT_TOKEN, T_ANDEQ},
+    [S_PIPE]    = {ACT_TOKEN, T_PIPE},
+    [S_OR]      = {ACT_TOKEN, T_OR},
+    [S_OREQ]    = {ACT_TOKEN, T_OREQ},
+    [S_CARET]   = {ACT_TOKEN, T_CARET},
+    [S_XOREQ]   = {ACT_TOKEN, T_XOREQ},
+};
+
+/**
+ * @brief Fetch the next token with the table-driven DFA.
+ * @param lexer
+ * @return
+ */
+static Token scan_next_dfa(Lexer *lexer) {
+    for (;;) {
+        const unsigned char *str = (const unsigned char *)lexer->buffer + lexer->pos + 1;
+        int state                = S_START;
+        int len                  = 0;
+
+        // No state consumes '\0', so the scan never reads past the sentinel
+        for (int next; (next = dfa_next[state][charclass[str[len]]]) != S_STOP; len++) {
+            state = next;
+        }
+
+        DFAAccept accept = dfa_accept[state];
+        switch (accept.action) {
+        case ACT_EOF:   return new_token(lexer, T_EOF, 1, true);
+        case ACT_TOKEN: return new_token(lexer, accept.type, len, true);
+        case ACT_PUNCT: return new_token(lexer, punctok[str[0]], 1, true);
+        case ACT_IDENT: {
+            Token token   = new_token(lexer, T_IDENT, len, true);
+            unsigned hash = FNV_OFFSET;
+            for (int i = 0; i < len; i++) {
+                hash ^= str[i];
+                hash *= FNV_PRIME;
+            }
+            token.hash = hash;
+            token.type = search_keyword((const char *)str, len);
+            return token;
+        }
+        case ACT_BLANK: advance(lexer, len, true); break;
+        case ACT_NEWLINE:
+            lexer->line += len;
+            lexer->col = 1;
+            advance(lexer, len, false);
+            break;
+        case ACT_COMMENT: scan_comment(lexer); break;
+        case ACT_STRING:  return scan_string(lexer);
+        case ACT_CHAR:    return scan_character(lexer);
+        }
+    }
+}
+
 /**
- * @brief Scan the source code and return the tokens array.
- * @param lexers
+ * @brief Resizes every array of `list` to `capacity` tokens.
+ * @param list
+ * @param capacity
+ * @return false if memory ran out, arrays that were resized keep at least
+ * the old capacity then.
+ */
+static bool resize_toklist(TokList *list, int capacity) {
+    uint8_t *types   = mem_realloc(list->types, capacity * sizeof(*types));
+    if (types) list->types = types;
+    int *lines       = mem_realloc(list->lines, capacity * sizeof(*lines));
+    if (lines) list->lines = lines;
+    int *cols        = mem_realloc(list->cols, capacity * sizeof(*cols));
+    if (cols) list->cols = cols;
+    unsigned *offs   = mem_realloc(list->offs, capacity * sizeof(*offs));
+    if (offs) list->offs = offs;
+    unsigned *lens   = mem_realloc(list->lens, capacity * sizeof(*lens));
+    if (lens) list->lens = lens;
+    unsigned *hashes = mem_realloc(list->hashes, capacity * sizeof(*hashes));
+    if (hashes) list->hashes = hashes;
+
+    if (!types || !lines || !cols || !offs || !lens || !hashes) return false;
+
+    list->capacity = capacity;
+    return true;
+}
+
+/**
+ * @brief Appends `token` to the end of `list`.
+ * @param list
+ * @param token
+ * @return false if memory ran out.
+ */
+static bool push_token(TokList *list, Token token) {
+    if (list->count >= list->capacity && !resize_toklist(list, list->capacity * 2)) return false;
+
+    int i           = list->count++;
+    list->types[i]  = (uint8_t)token.type;
+    list->lines[i]  = token.line;
+    list->cols[i]   = token.col;
+    list->offs[i]   = token.off;
+    list->lens[i]   = token.len;
+    list->hashes[i] = token.hash;
+    return true;
+}
+
+/**
+ * @brief Allocates an empty token list over the `lexer` buffer.
+ * @param lexer
+ * @param capacity
+ * @return NULL if memory ran out.
+ */
+static TokList *make_toklist(Lexer *lexer, int capacity) {
+    TokList *list = mem_calloc(1, sizeof(TokList));
+    if (!list) return NULL;
+
+    list->source = lexer->buffer;
+    list->mask   = UINT_MAX;
+    if (!resize_toklist(list, capacity)) {
+        purge_toklist(list);
+        return NULL;
+    }
+    return list;
+}
+
+/**
+ * @brief Reports a failed token allocation and frees the partial `list`.
+ * @param lexer
+ * @param list
+ * @return NULL, for returning straight from a scan.
+ */
+static TokList *alloc_failed(Lexer *lexer, TokList *list) {
+    fail_context(lexer->ctx, CERR_NOMEM, "token allocation failed");
+    purge_toklist(list);
+    return NULL;
+}
+
+/**
+ * @brief Token recogniser selected by `lexer` engine.
+ * @param lexer
  * @return
  */
-TokList *scan(const char *src) {
-    make_kwtable();
+static Token (*engine_next(Lexer *lexer))(Lexer *) {
+    return lexer->engine == LEX_DFA ? scan_next_dfa : scan_next;
+}
 
-    int capacity = 64;
-    int count    = 0;
+/**
+ * @brief Scan the source code and return the tokens array.
+ * @param lexer
+ * @return
+ */
+TokList *scan(Lexer *lexer) {
+    TokList *list = make_toklist(lexer, 64);
+    if (!list) return alloc_failed(lexer, NULL);
 
-    Lexer *lexer   = make_lexer(src);
-    Token **tokens = malloc(capacity * sizeof(Token *));
-    Token *tok;
+    Token (*next)(Lexer *) = engine_next(lexer);
 
+    Token token;
     do {
-        tok             = scan_next(lexer); // Assume next() returns Token*
-        tokens[count++] = tok;
+        token = next(lexer);
+        if (!push_token(list, token)) return alloc_failed(lexer, list);
+    } while (token.type != T_EOF);
+
+    // Shrink to fit, keeping the larger arrays is fine if that fails
+    resize_toklist(list, list->count);
+
+    return list;
+}
+
+/**
+ * @brief Creates a pull-mode token stream over `lexer`.
+ * @param lexer
+ * @return
+ */
+TokList *scan_stream(Lexer *lexer) {
+    TokList *list = make_toklist(lexer, STREAM_RING);
+    if (!list) return alloc_failed(lexer, NULL);
+
+    list->lexer = lexer;
+    list->mask  = STREAM_RING - 1;
+
+    return list;
+}
+
+/**
+ * @brief Scans the next token of a stream into its ring.
+ * @param list
+ * @return
+ */
+bool pull_token(TokList *list) {
+    Lexer *lexer = list->lexer;
+    if (!lexer) return false;
+
+    Token token = engine_next(lexer)(lexer);
+    if (token.type == T_EOF) list->lexer = NULL;
+
+    int i           = list->count++ & list->mask;
+    list->types[i]  = (uint8_t)token.type;
+    list->lines[i]  = token.line;
+    list->cols[i]   = token.col;
+    list->offs[i]   = token.off;
+    list->lens[i]   = token.len;
+    list->hashes[i] = token.hash;
+
+    return true;
+}
+
+/*
+ * Parallel scanning. The buffer is cut into chunks that start right after a
+ * line break, and every chunk is scanned on its own thread assuming it starts
+ * outside any literal or comment. Each chunk scans until it has consumed its
+ * range and keeps the lexer state (position, line, column) it stopped in.
+ * That guess is verified while stitching: the next chunk is accepted from the
+ * point where its own scan passes through the same position and column, and
+ * is otherwise scanned again serially. Past that point both scans are the
+ * same, so an accepted chunk only needs it's lines shifted. Once every chunk
+ * has a place in the result the workers copy them there in parallel.
+ */
+
+#define MAX_WORKERS 64
+
+typedef struct {
+    Lexer lexer;          // Private lexer, left in the state the chunk scan stopped in
+    size_t end;           // Chunk end, scanning stops once everything before it is consumed
+    TokList *list;        // Tokens scanned for the chunk
+    Token eof;            // `T_EOF` token, if the chunk scan reached the end of input
+    bool ended;           // `eof` is set
+    bool failed;          // Memory ran out while scanning, `list` is incomplete
+    TokList *dst;         // Stitched result
+    int skip;             // Leading tokens of `list` already covered by the previous chunk
+    int at;               // Index of the first copied token in `dst`
+    int delta;            // Line shift from chunk relative to absolute lines
+    void *(*run)(void *); // Work of the current `run_chunks` call
+    double cpu;           // CPU milliseconds that work took on a thread of its own
+    MemStats mem;         // Allocations it made there
+} Chunk;
+
+/**
+ * @brief Scans tokens into `list` until everything before `end` is consumed.
+ * Runs on worker threads, so running out of memory is only flagged.
+ * @param lexer
+ * @param end
+ * @param list
+ * @param eof Receives the `T_EOF` token if the input ends first.
+ * @param failed Set if memory ran out, scanning stops then.
+ * @return True if the input ended.
+ */
+static bool scan_until(Lexer *lexer, size_t end, TokList *list, Token *eof, bool *failed) {
+    Token (*next)(Lexer *) = engine_next(lexer);
+
+    while ((size_t)(lexer->pos + 1) < end) {
+        Token token = next(lexer);
+        if (token.type == T_EOF) {
+            *eof = token;
+            return true;
+        }
+        if (!push_token(list, token)) {
+            *failed = true;
+            return false;
+        }
+    }
+    return false;
+}
+
+static void *scan_chunk(void *arg) {
+    Chunk *chunk = arg;
+    chunk->ended =
+        scan_until(&chunk->lexer, chunk->end, chunk->list, &chunk->eof, &chunk->failed);
+    return NULL;
+}
 
-        if (count >= capacity) {
-            capacity *= 2;
-            tokens = realloc(tokens, capacity * sizeof(Token *));
+static void *copy_chunk(void *arg) {
+    Chunk *chunk = arg;
+    TokList *src = chunk->list;
+    TokList *dst = chunk->dst;
+    int from     = chunk->skip;
+    int n        = src->count - from;
+    int at       = chunk->at;
+
+    memcpy(dst->types + at, src->types + from, n * sizeof(*src->types));
+    memcpy(dst->cols + at, src->cols + from, n * sizeof(*src->cols));
+    memcpy(dst->offs + at, src->offs + from, n * sizeof(*src->offs));
+    memcpy(dst->lens + at, src->lens + from, n * sizeof(*src->lens));
+    memcpy(dst->hashes + at, src->hashes + from, n * sizeof(*src->hashes));
+    for (int i = 0; i < n; i++) {
+        dst->lines[at + i] = src->lines[from + i] + chunk->delta;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Thread of `run_chunks`, records what the work of a chunk cost.
+ * @param arg Chunk.
+ * @return
+ */
+static void *run_chunk(void *arg) {
+    Chunk *chunk = arg;
+    double cpu   = thread_cpu();
+    MemStats mem = mem_stats();
+
+    chunk->run(chunk);
+    chunk->cpu = thread_cpu() - cpu;
+    chunk->mem = mem_since(mem);
+    return NULL;
+}
+
+/**
+ * @brief Runs `fn` on every chunk, the first one on the calling thread. The
+ * CPU time and allocations of the other threads are added to the calling
+ * thread's.
+ * @param chunks
+ * @param count
+ * @param fn
+ */
+static void run_chunks(Chunk *chunks, int count, void *(*fn)(void *)) {
+    pthread_t threads[MAX_WORKERS];
+    bool started[MAX_WORKERS];
+
+    for (int k = 1; k < count; k++) {
+        chunks[k].run = fn;
+        started[k]    = pthread_create(&threads[k], NULL, run_chunk, &chunks[k]) == 0;
+        if (!started[k]) fn(&chunks[k]);
+    }
+    fn(&chunks[0]);
+    for (int k = 1; k < count; k++) {
+        if (!started[k] || pthread_join(threads[k], NULL) != 0) continue;
+
+        absorb_cpu(chunks[k].cpu);
+        mem_absorb(&chunks[k].mem);
+    }
+}
+
+/**
+ * @brief Replays the start of `chunk` until it's lexer reaches `pos`.
+ * @param chunk
+ * @param start Chunk start offset.
+ * @param pos Position the previous chunk stopped at.
+ * @param at Receives the lexer state at `pos`.
+ * @return Number of replayed tokens, or -1 if the chunk never stops at `pos`.
+ */
+static int replay_chunk(const Chunk *chunk, size_t start, int pos, Lexer *at) {
+    *at      = chunk->lexer;
+    at->pos  = start - 1;
+    at->line = 1;
+    at->col  = 1;
+
+    Token (*next)(Lexer *) = engine_next(at);
+
+    int count = 0;
+    while (at->pos < pos && count < chunk->list->count) {
+        next(at);
+        count++;
+    }
+    return at->pos == pos ? count : -1;
+}
+
+/**
+ * @brief Frees the chunk token lists and the chunk bookkeeping.
+ * @param chunks
+ * @param starts
+ * @param count
+ */
+static void purge_chunks(Chunk *chunks, size_t *starts, int count) {
+    for (int k = 0; k < count; k++) {
+        purge_toklist(chunks[k].list);
+    }
+    free(chunks);
+    free(starts);
+}
+
+TokList *scan_parallel(Lexer *lexer, int workers) {
+    size_t base  = lexer->pos + 1;
+    size_t size  = lexer->size - base;
+    size_t start = base;
+
+    if (workers < 2) return scan(lexer);
+    if (workers > MAX_WORKERS) workers = MAX_WORKERS;
+    if ((size_t)workers > size / MIN_CHUNK) workers = size / MIN_CHUNK;
+    if (workers < 2) return scan(lexer);
+
+    Chunk *chunks  = mem_calloc(workers, sizeof(Chunk));
+    size_t *starts = mem_calloc(workers, sizeof(size_t));
+    if (!chunks || !starts) {
+        purge_chunks(chunks, starts, 0);
+        return alloc_failed(lexer, NULL);
+    }
+
+    // Cut after the first line break past each even split point
+    for (int k = 0; k < workers; k++) {
+        size_t end = lexer->size;
+        if (k < workers - 1) {
+            size_t split = base + size / workers * (k + 1);
+            if (split < start) split = start;
+
+            const char *nl = memchr(lexer->buffer + split, '\n', lexer->size - split);
+            if (nl) end = nl - lexer->buffer + 1;
+        }
+
+        Chunk *chunk = &chunks[k];
+        chunk->lexer = *lexer;
+        chunk->end   = end;
+        chunk->list  = make_toklist(lexer, 64);
+        if (!chunk->list) {
+            purge_chunks(chunks, starts, workers);
+            return alloc_failed(lexer, NULL);
+        }
+        if (k > 0) {
+            chunk->lexer.pos  = start - 1;
+            chunk->lexer.line = 1;
+            chunk->lexer.col  = 1;
+        }
+        starts[k] = start;
+        start     = end;
+    }
+
+    run_chunks(chunks, workers, scan_chunk);
+
+    for (int k = 0; k < workers; k++) {
+        if (chunks[k].failed) {
+            purge_chunks(chunks, starts, workers);
+            return alloc_failed(lexer, NULL);
+        }
+    }
+
+    // Stitch, `carry` is the lexer state at the end of the stitched prefix
+    Lexer carry = chunks[0].lexer;
+    bool ended  = chunks[0].ended;
+    Token eof   = chunks[0].eof;
+    int count   = chunks[0].list->count;
+
+    for (int k = 1; k < workers; k++) {
+        Chunk *chunk = &chunks[k];
+        chunk->at    = count;
+        chunk->skip  = chunk->list->count;
+
+        // Input ended early on a '\0', or the prefix already covers this chunk
+        if (ended || (size_t)(carry.pos + 1) >= chunk->end) continue;
+
+        Lexer at;
+        int skip = replay_chunk(chunk, starts[k], carry.pos, &at);
+
+        if (skip >= 0 && at.col == carry.col) {
+            chunk->skip  = skip;
+            chunk->delta = carry.line - at.line;
+
+            carry = chunk->lexer;
+            ended = chunk->ended;
+            eof   = chunk->eof;
+            carry.line += chunk->delta;
+            eof.line += chunk->delta;
+        } else {
+            // Chunk started inside a token, literal or comment, rescan it from `carry`
+            chunk->list->count = 0;
+            chunk->skip        = 0;
+            chunk->delta       = 0;
+            ended              = scan_until(&carry, chunk->end, chunk->list, &eof, &chunk->failed);
+            if (chunk->failed) {
+                purge_chunks(chunks, starts, workers);
+                return alloc_failed(lexer, NULL);
+            }
         }
-    } while (tok->type != T_EOF);
+        count += chunk->list->count - chunk->skip;
+    }
+
+    TokList *list = make_toklist(lexer, count + 1);
+    if (!list) {
+        purge_chunks(chunks, starts, workers);
+        return alloc_failed(lexer, NULL);
+    }
+    list->count = count;
 
-    // Shrink to fit
-    tokens = realloc(tokens, count * sizeof(Token *));
+    for (int k = 0; k < workers; k++) {
+        chunks[k].dst = list;
+    }
+    run_chunks(chunks, workers, copy_chunk);
+
+    // Leave `lexer` where a serial scan would have
+    if (!ended) {
+        carry.engine = lexer->engine;
+        eof          = engine_next(&carry)(&carry);
+    }
+    push_token(list, eof);
+
+    lexer->pos  = eof.off;
+    lexer->line = eof.line;
+    lexer->col  = eof.col + 1;
 
-    TokList *list = malloc(sizeof(TokList));
-    list->tokens  = tokens;
-    list->count   = count;
+    purge_chunks(chunks, starts, workers);
 
-    purge_lexer(lexer);
     return list;
 }
 
@@ -672,11 +1450,31 @@ TokList *scan(const char *src) {
  */
 void purge_lexer(Lexer *lexer) {
     if (lexer) {
-        free(lexer->buffer);
+        if (lexer->mapped) {
+            munmap((void *)lexer->buffer, lexer->size + 1);
+        } else {
+            free((void *)lexer->buffer);
+        }
         free(lexer);
     }
 }
 
+/**
+ * @brief Checks if tokens of the given type carry a value.
+ * @param type
+ * @return
+ */
+static bool tokhasval(TokType type) {
+    switch (type) {
+    case T_IDENT:
+    case T_INT_LIT:
+    case T_FLOAT_LIT:
+    case T_CHAR_LIT:
+    case T_STRING_LIT: return true;
+    default:           return false;
+    }
+}
+
 /**
  * @brief Cleanup allocated memory from `tokens`.
  * @param list
@@ -684,13 +1482,12 @@ void purge_lexer(Lexer *lexer) {
 void purge_toklist(TokList *list) {
     if (!list) return;
 
-    for (int i = 0; i < list->count; i++) {
-        Token *t = list->tokens[i];
-        if (t->value) free(t->value);
-        free(t);
-    }
-
-    free(list->tokens);
+    free(list->types);
+    free(list->lines);
+    free(list->cols);
+    free(list->offs);
+    free(list->lens);
+    free(list->hashes);
     free(list);
 }
 
@@ -701,13 +1498,12 @@ void purge_toklist(TokList *list) {
 void print_toklist(const TokList *list) {
     printf("Scanned %d tokens:\n\n", list->count);
 
-    Token *token;
-
     for (int i = 0; i < list->count; i++) {
-        token = list->tokens[i];
+        TokType type = list->types[i];
+        int len      = tokhasval(type) ? (int)list->lens[i] : 0;
         printf(
-            "%-16s %-10s typ:%-4d lin:%-4d col:%d\n", //
-            ttypestr[token->type], token->value, token->type, token->line, token->col
+            "%-16s %-10.*s typ:%-4d lin:%-4d col:%d\n", //
+            ttypestr[type], len, list->source + list->offs[i], type, list->lines[i], list->cols[i]
         );
     }
 }
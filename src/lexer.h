@@ -2,6 +2,12 @@
 #define _LEXER_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "context.h"
+
+#define MIN_CHUNK (1 << 20) // Smallest chunk of source `scan_parallel` gives a thread
 
 // Token types
 typedef enum {
@@ -143,35 +149,106 @@ typedef enum {
     T_EOF,     // End of file
 } TokType;
 
+_Static_assert(T_EOF <= UINT8_MAX, "token types must fit the packed token stream");
+
 extern const char *ttypestr[];
 
+// Token recognisers selectable behind `scan`
+typedef enum {
+    LEX_HAND, // Hand-coded scanner (default)
+    LEX_DFA,  // Table-driven DFA scanner
+} LexEngine;
+
+typedef struct {
+    CompilerContext *ctx; // Receives errors of this lexer and it's scans
+    const char *buffer;   // Source text, always terminated by a '\0' sentinel
+    size_t size;          // Source length in bytes (without the sentinel)
+    bool mapped;          // `buffer` is a read-only file mapping, not a heap copy
+    LexEngine engine;     // Recogniser used by `scan`, `LEX_HAND` unless changed
+    int pos;
+    int line;
+    int col;
+} Lexer;
+
+// Single token, as produced by the scanner
 typedef struct {
     TokType type;
-    char *value;
+    unsigned off;  // Value offset into the source buffer
+    unsigned len;  // Value length in bytes
+    unsigned hash; // Identifier FNV hash, computed once while scanning
     int line;
     int col;
 } Token;
 
+// Token stream as parallel arrays, all indexed by token position.
+// A streamed list is a ring: token `i` lives in slot `i & mask` and only the
+// most recent `capacity` tokens are kept, a complete list has an all ones mask.
 typedef struct {
-    Token **tokens;
-    int count;
+    uint8_t *types;     // Token types, `TokType` narrowed to a byte
+    int *lines;         // Token lines
+    int *cols;          // Token columns
+    unsigned *offs;     // Value offsets into `source`
+    unsigned *lens;     // Value lengths in bytes
+    unsigned *hashes;   // Identifier FNV hashes
+    int count;          // Number of tokens scanned so far
+    int capacity;       // Allocated length of every array
+    unsigned mask;      // Slot mask applied to token positions
+    Lexer *lexer;       // Lexer still producing tokens into a stream, NULL once complete
+    const char *source; // Source buffer token values point into, owned by the lexer
 } TokList;
 
-typedef struct {
-    char *buffer;
-    int pos;
-    int line;
-    int col;
-} Lexer;
-
 extern const char *ttypestr[];
 
+/**
+ * @brief Creates lexer and loads the source into it's `buffer`.
+ * Regular files are memory-mapped, pipes and stdin (`-`) are read.
+ * @param ctx
+ * @param path File name with path.
+ * @return NULL if the source can't be read, the reason is reported to `ctx`.
+ */
+Lexer *make_lexer(CompilerContext *ctx, const char *path);
+
+/**
+ * @brief Cleanup resources allocated for lexer and it's `buffer`.
+ * @param lexer
+ */
+void purge_lexer(Lexer *lexer);
+
 /**
  * @brief Scan the source and return the tokens array.
- * @param src Sourcecode file path.
- * @return
+ * Token values are slices of `lexer` buffer, so the lexer must outlive the list.
+ * @param lexer Lexer created by `make_lexer`.
+ * @return NULL if memory ran out.
+ */
+TokList *scan(Lexer *lexer);
+
+/**
+ * @brief Scan the source on up to `workers` threads, same result as `scan`.
+ * Chunks start after line breaks and are verified against their predecessor
+ * while stitching, so literals and comments spanning a cut are rescanned.
+ * Sources below a few megabytes are scanned serially.
+ * @param lexer Lexer created by `make_lexer`.
+ * @param workers Thread count, including the calling thread.
+ * @return NULL if memory ran out.
+ */
+TokList *scan_parallel(Lexer *lexer, int workers);
+
+/**
+ * @brief Creates a pull-mode token stream over `lexer`.
+ * Nothing is scanned up front, `pull_token` scans one token at a time into a
+ * small ring, so memory stays constant however long the source is.
+ * @param lexer Lexer created by `make_lexer`, must outlive the stream.
+ * @return NULL if memory ran out.
+ */
+TokList *scan_stream(Lexer *lexer);
+
+/**
+ * @brief Scans the next token of a stream into its ring.
+ * Overwrites token `count - capacity`, callers may only look back that far.
+ * @param list Stream created by `scan_stream`.
+ * @return False once `T_EOF` has been pulled, or if `list` is complete.
  */
-TokList *scan(const char *src);
+bool pull_token(TokList *list);
 
 /**
  * @brief Cleanup allocated memory from `tokens`.
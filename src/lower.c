@@ -0,0 +1,869 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "memstat.h"
+#include "lower.h"
+
+#define INITIAL_CAP 64 // Initial capacity of growing arrays and name tables
+
+/*
+ * Lowers the flat AST into SSA form with the IR builder. Locals and parameters
+ * are builder variables, so their reads become the SSA value reaching them and
+ * nothing is ever stored for them. Control flow follows the builder's sealing
+ * rule: a block is sealed once every jump into it has been added, which for a
+ * loop header is after the body, and for a loop exit after the last `break`.
+ */
+
+// Variable in scope, shadowing the previous binding of its name
+typedef struct {
+    const Atom *name;
+    bool global;  // `index` is a module global, else a builder variable
+    uint8_t type; // `IrType`
+    uint32_t index;
+    uint32_t prev; // Binding the name had before, `IR_NONE` if none
+} Binding;
+
+typedef struct {
+    const Atom *name; // NULL if empty
+    uint32_t value;   // Innermost binding or function, `IR_NONE` once unbound
+} NameSlot;
+
+// Open addressing hash-table keyed by atom
+typedef struct {
+    NameSlot *slots;
+    uint32_t size; // Slots, power of two
+    uint32_t count;
+} NameMap;
+
+// Targets of `break` and `continue` in the innermost loop
+typedef struct {
+    uint32_t brk;
+    uint32_t cont;
+} Loop;
+
+typedef struct {
+    CompilerContext *ctx;
+    const FlatAst *ast;
+    IrModule *mod;
+    IrBuilder *b;
+    NameMap vars;  // Innermost binding of every variable name
+    NameMap funcs; // Function of every name, never shadowed
+    Binding *binds;
+    Loop *loops;
+    IrRef *args;    // Arguments of the calls being lowered, innermost last
+    IrType *params; // Parameter types of the function being declared
+    uint32_t bind_count, bind_cap;
+    uint32_t loop_count, loop_cap;
+    uint32_t arg_count, arg_cap;
+    uint32_t param_cap;
+    IrType ret;   // Return type of the function being lowered
+    bool err;     // A construct that cannot be lowered was reported
+    jmp_buf fail; // Where errors abandon the lowering
+} Lowerer;
+
+static void lower_block(Lowerer *lw, NodeRef ref);
+static void lower_stmt(Lowerer *lw, NodeRef ref);
+static IrRef lower_expr(Lowerer *lw, NodeRef ref);
+static IrType type_of(Lowerer *lw, NodeRef ref);
+
+// IR operation of every arithmetic and comparison operator
+static const uint8_t binary_ops[] = {
+    [BOP_ADD]  = IR_ADD,
+    [BOP_SUB]  = IR_SUB,
+    [BOP_MUL]  = IR_MUL,
+    [BOP_DIV]  = IR_DIV,
+    [BOP_MOD]  = IR_MOD,
+    [BOP_EQ]   = IR_EQ,
+    [BOP_NEQ]  = IR_NE,
+    [BOP_LT]   = IR_LT,
+    [BOP_LTEQ] = IR_LE,
+    [BOP_GT]   = IR_GT,
+    [BOP_GTEQ] = IR_GE,
+};
+
+/*********************************************
+ * Helpers
+ *********************************************/
+
+/**
+ * @brief Abandons the lowering, `lower_program` records `CERR_NOMEM`.
+ * @param lw
+ */
+static _Noreturn void out_of_memory(Lowerer *lw) {
+    longjmp(lw->fail, 1);
+}
+
+/**
+ * @brief Reports a construct the IR cannot express yet and abandons the lowering.
+ * @param lw
+ * @param line
+ * @param what Construct, the subject of the message.
+ */
+static _Noreturn void unsupported(Lowerer *lw, int line, const char *what) {
+    report_error(lw->ctx, line, 0, "%s not supported yet", what);
+    set_error(lw->ctx, CERR_IR);
+    lw->err = true;
+    longjmp(lw->fail, 1);
+}
+
+/**
+ * @brief Makes room for one more entry in an array holding `count` entries.
+ * @param lw
+ * @param items
+ * @param count
+ * @param cap Array capacity, updated when the array grows.
+ * @param size Entry size.
+ * @return The array, possibly moved.
+ */
+static void *grow(Lowerer *lw, void *items, uint32_t count, uint32_t *cap, size_t size) {
+    if (count < *cap) return items;
+
+    uint32_t want = *cap ? *cap * 2 : INITIAL_CAP;
+    items         = mem_realloc(items, want * size);
+    if (!items) out_of_memory(lw);
+
+    *cap = want;
+    return items;
+}
+
+static const FlatDecl *decl_at(const Lowerer *lw, NodeRef ref) {
+    return &lw->ast->decls[ref];
+}
+
+static const FlatExpr *expr_at(const Lowerer *lw, NodeRef ref) {
+    return &lw->ast->exprs[ref];
+}
+
+static bool is_func(const Lowerer *lw, const FlatDecl *decl) {
+    return lw->ast->types[decl->type].kind == TY_FUNC;
+}
+
+/**
+ * @brief Maps a declared type to the IR type of its values.
+ * @param lw
+ * @param type
+ * @param line Where the type is used, for the error.
+ * @return
+ */
+static IrType map_type(Lowerer *lw, NodeRef type, int line) {
+    switch (lw->ast->types[type].kind) {
+    case TY_VOID:   return IT_VOID;
+    case TY_INT:    return IT_INT;
+    case TY_FLOAT:  return IT_FLOAT;
+    case TY_CHAR:   return IT_CHAR;
+    case TY_STRING: return IT_STRING;
+    default:        unsupported(lw, line, "Pointer and function values are");
+    }
+}
+
+/**
+ * @brief Type two operands are converted to, like the analyzer's numeric
+ * promotion. Non arithmetic operands of one type keep it.
+ * @param a
+ * @param b
+ * @return
+ */
+static IrType promote(IrType a, IrType b) {
+    if (a == IT_FLOAT || b == IT_FLOAT) return IT_FLOAT;
+    if (a == b && (a == IT_BOOL || a == IT_STRING)) return a;
+
+    return IT_INT;
+}
+
+/*********************************************
+ * Names
+ *********************************************/
+
+/**
+ * @brief Finds the slot of `name`, or the empty slot it would take.
+ * @param map
+ * @param name
+ * @return
+ */
+static NameSlot *find_name(const NameMap *map, const Atom *name) {
+    uint32_t mask = map->size - 1;
+    uint32_t idx  = name->hash & mask;
+
+    while (map->slots[idx].name && map->slots[idx].name != name) idx = (idx + 1) & mask;
+    return &map->slots[idx];
+}
+
+/**
+ * @brief Looks a name up.
+ * @param map
+ * @param name
+ * @return Value of the name, `IR_NONE` if it has none.
+ */
+static uint32_t lookup(const NameMap *map, const Atom *name) {
+    if (!map->size) return IR_NONE;
+
+    const NameSlot *slot = find_name(map, name);
+    return slot->name ? slot->value : IR_NONE;
+}
+
+/**
+ * @brief Finds the slot of `name`, adding it without value when it is new.
+ * @param lw
+ * @param map
+ * @param name
+ * @return
+ */
+static NameSlot *name_slot(Lowerer *lw, NameMap *map, const Atom *name) {
+    // Keep load factor under 1/2
+    if ((map->count + 1) * 2 > map->size) {
+        NameMap old = *map;
+
+        map->size  = old.size ? old.size * 2 : INITIAL_CAP;
+        map->slots = mem_calloc(map->size, sizeof(NameSlot));
+        if (!map->slots) {
+            *map = old;
+            out_of_memory(lw);
+        }
+        for (uint32_t i = 0; i < old.size; i++) {
+            if (old.slots[i].name) *find_name(map, old.slots[i].name) = old.slots[i];
+        }
+        free(old.slots);
+    }
+
+    NameSlot *slot = find_name(map, name);
+    if (!slot->name) {
+        *slot = (NameSlot){.name = name, .value = IR_NONE};
+        map->count++;
+    }
+    return slot;
+}
+
+/**
+ * @brief Brings a variable into scope until `unbind` drops it.
+ * @param lw
+ * @param name
+ * @param global
+ * @param type
+ * @param index Global or builder variable.
+ */
+static void bind(Lowerer *lw, const Atom *name, bool global, IrType type, uint32_t index) {
+    lw->binds      = grow(lw, lw->binds, lw->bind_count, &lw->bind_cap, sizeof(Binding));
+    NameSlot *slot = name_slot(lw, &lw->vars, name);
+
+    lw->binds[lw->bind_count] = (Binding){
+        .name   = name,
+        .global = global,
+        .type   = type,
+        .index  = index,
+        .prev   = slot->value,
+    };
+    slot->value = lw->bind_count++;
+}
+
+/**
+ * @brief Drops the bindings made since `mark`, the names they shadowed are
+ * visible again.
+ * @param lw
+ * @param mark Binding count when the scope was entered.
+ */
+static void unbind(Lowerer *lw, uint32_t mark) {
+    while (lw->bind_count > mark) {
+        const Binding *bnd = &lw->binds[--lw->bind_count];
+        find_name(&lw->vars, bnd->name)->value = bnd->prev;
+    }
+}
+
+/**
+ * @brief Innermost binding of a variable name.
+ * @param lw
+ * @param name
+ * @param line Where the name is used, for the error.
+ * @return
+ */
+static const Binding *variable(Lowerer *lw, const Atom *name, int line) {
+    uint32_t bnd = lookup(&lw->vars, name);
+    if (bnd == IR_NONE) unsupported(lw, line, "Referring to a function as a value is");
+
+    return &lw->binds[bnd];
+}
+
+/*********************************************
+ * Declarations
+ *********************************************/
+
+/**
+ * @brief Adds a function to the module under its name.
+ * @param lw
+ * @param name
+ * @param ret
+ * @param params
+ * @param count
+ * @return Index of the function.
+ */
+static uint32_t add_func(
+    Lowerer *lw, const Atom *name, IrType ret, const IrType *params, uint32_t count
+) {
+    uint32_t func = ir_add_func(lw->mod, name, ret, params, count);
+    if (func == IR_NONE) out_of_memory(lw);
+
+    name_slot(lw, &lw->funcs, name)->value = func;
+    return func;
+}
+
+/**
+ * @brief Adds a declared function, without its body.
+ * @param lw
+ * @param decl
+ */
+static void declare_func(Lowerer *lw, const FlatDecl *decl) {
+    const NodeRef *params = flat_items(lw->ast, decl->func.params);
+    uint32_t count        = flat_count(lw->ast, decl->func.params);
+
+    for (uint32_t i = 0; i < count; i++) {
+        lw->params    = grow(lw, lw->params, i, &lw->param_cap, sizeof(IrType));
+        lw->params[i] = map_type(lw, decl_at(lw, params[i])->type, decl->line);
+    }
+
+    IrType ret = map_type(lw, lw->ast->types[decl->type].func.ret, decl->line);
+    add_func(lw, decl->name, ret, lw->params, count);
+}
+
+/**
+ * @brief Lowers the body of a declared function. Parameters are variables
+ * defined by the parameter values on entry.
+ * @param lw
+ * @param decl
+ */
+static void lower_func(Lowerer *lw, const FlatDecl *decl) {
+    uint32_t func         = lookup(&lw->funcs, decl->name);
+    const NodeRef *params = flat_items(lw->ast, decl->func.params);
+    uint32_t mark         = lw->bind_count;
+
+    ir_begin(lw->b, func);
+    lw->ret = lw->mod->funcs[func].ret;
+
+    for (uint32_t i = 0; i < flat_count(lw->ast, decl->func.params); i++) {
+        IrType type  = lw->mod->funcs[func].params[i];
+        uint32_t var = ir_var(lw->b, type);
+
+        ir_def(lw->b, var, ir_param(lw->b, i));
+        bind(lw, decl_at(lw, params[i])->name, false, type, var);
+    }
+
+    lower_block(lw, decl->func.body);
+    ir_end(lw->b);
+    unbind(lw, mark);
+}
+
+/**
+ * @brief Lowers a local declaration. Variables get a builder variable, set
+ * to the initializer when there is one. Functions declared in a block are
+ * added to the module, but may not have a body there.
+ * @param lw
+ * @param decl
+ */
+static void lower_local(Lowerer *lw, const FlatDecl *decl) {
+    if (is_func(lw, decl)) {
+        if (decl->func.body != NO_NODE) unsupported(lw, decl->line, "Nested function bodies are");
+
+        declare_func(lw, decl);
+        return;
+    }
+
+    IrType type  = map_type(lw, decl->type, decl->line);
+    uint32_t var = ir_var(lw->b, type);
+
+    // In scope in its own initializer, like the analyzer has it
+    bind(lw, decl->name, false, type, var);
+    if (decl->var.init != NO_NODE) {
+        ir_def(lw->b, var, ir_conv(lw->b, type, lower_expr(lw, decl->var.init)));
+    }
+}
+
+/**
+ * @brief Lowers the initializers of the globals into the void function
+ * `.init`, which stores them in declaration order.
+ * @param lw
+ */
+static void lower_init(Lowerer *lw) {
+    const NodeRef *decls = flat_items(lw->ast, lw->ast->program);
+    uint32_t count       = flat_count(lw->ast, lw->ast->program);
+
+    bool any = false;
+    for (uint32_t i = 0; i < count && !any; i++) {
+        const FlatDecl *decl = decl_at(lw, decls[i]);
+        any                  = !is_func(lw, decl) && decl->var.init != NO_NODE;
+    }
+    if (!any) return;
+
+    const Atom *name = intern_cstr(&lw->ctx->interner, ".init");
+    if (!name) out_of_memory(lw);
+
+    ir_begin(lw->b, add_func(lw, name, IT_VOID, NULL, 0));
+    lw->ret = IT_VOID;
+
+    for (uint32_t i = 0; i < count; i++) {
+        const FlatDecl *decl = decl_at(lw, decls[i]);
+        if (is_func(lw, decl) || decl->var.init == NO_NODE) continue;
+
+        const Binding *bnd = &lw->binds[lookup(&lw->vars, decl->name)];
+        uint32_t global    = bnd->index;
+        IrType type        = bnd->type;
+        ir_store(lw->b, global, ir_conv(lw->b, type, lower_expr(lw, decl->var.init)));
+    }
+
+    ir_ret(lw->b, IR_NONE);
+    ir_end(lw->b);
+}
+
+/*********************************************
+ * Statements
+ *********************************************/
+
+/**
+ * @brief Lowers a compound block in a scope of its own.
+ * @param lw
+ * @param ref
+ */
+static void lower_block(Lowerer *lw, NodeRef ref) {
+    const FlatBlock *block = &lw->ast->blocks[ref];
+    const NodeRef *items   = flat_items(lw->ast, block->items);
+    uint32_t mark          = lw->bind_count;
+
+    for (uint32_t i = 0; i < flat_count(lw->ast, block->items); i++) {
+        if (items[i] & ITEM_STMT) {
+            lower_stmt(lw, items[i] & ~ITEM_STMT);
+        } else {
+            lower_local(lw, decl_at(lw, items[i]));
+        }
+    }
+    unbind(lw, mark);
+}
+
+/**
+ * @brief Converts a scalar value to a boolean, true when it is not zero.
+ * @param lw
+ * @param value
+ * @return
+ */
+static IrRef to_bool(Lowerer *lw, IrRef value) {
+    IrType type = ir_type(lw->b, value);
+    if (type == IT_BOOL) return value;
+
+    IrRef zero = type == IT_FLOAT ? ir_const_float(lw->b, 0) : ir_const_int(lw->b, type, 0);
+    return ir_binary(lw->b, IR_NE, value, zero);
+}
+
+/**
+ * @brief Lowers a condition and branches on it.
+ * @param lw
+ * @param cond
+ * @param then Taken when the condition holds.
+ * @param else_
+ */
+static void branch(Lowerer *lw, NodeRef cond, uint32_t then, uint32_t else_) {
+    ir_branch(lw->b, to_bool(lw, lower_expr(lw, cond)), then, else_);
+}
+
+/**
+ * @brief Selects a block and seals it, for blocks whose predecessors are
+ * all known when they are entered.
+ * @param lw
+ * @param block
+ */
+static void enter(Lowerer *lw, uint32_t block) {
+    ir_seal(lw->b, block);
+    ir_set_block(lw->b, block);
+}
+
+static void lower_if(Lowerer *lw, const FlatStmt *stmt) {
+    uint32_t then  = ir_block(lw->b);
+    uint32_t join  = ir_block(lw->b);
+    uint32_t else_ = stmt->_if.else_ != NO_NODE ? ir_block(lw->b) : join;
+
+    branch(lw, stmt->_if.cond, then, else_);
+
+    enter(lw, then);
+    lower_stmt(lw, stmt->_if.then);
+    ir_jump(lw->b, join);
+
+    if (else_ != join) {
+        enter(lw, else_);
+        lower_stmt(lw, stmt->_if.else_);
+        ir_jump(lw->b, join);
+    }
+    enter(lw, join);
+}
+
+/**
+ * @brief Lowers the body of a loop with the targets of `break` and `continue`.
+ * @param lw
+ * @param body
+ * @param brk
+ * @param cont
+ */
+static void lower_body(Lowerer *lw, NodeRef body, uint32_t brk, uint32_t cont) {
+    lw->loops = grow(lw, lw->loops, lw->loop_count, &lw->loop_cap, sizeof(Loop));
+    lw->loops[lw->loop_count++] = (Loop){brk, cont};
+
+    lower_stmt(lw, body);
+    lw->loop_count--;
+}
+
+static void lower_while(Lowerer *lw, const FlatStmt *stmt) {
+    uint32_t head = ir_block(lw->b);
+    uint32_t body = ir_block(lw->b);
+    uint32_t exit = ir_block(lw->b);
+
+    ir_jump(lw->b, head);
+    ir_set_block(lw->b, head); // Sealed once the body jumps back
+    branch(lw, stmt->_while.cond, body, exit);
+
+    enter(lw, body);
+    lower_body(lw, stmt->_while.body, exit, head);
+    ir_jump(lw->b, head);
+
+    ir_seal(lw->b, head);
+    enter(lw, exit);
+}
+
+static void lower_do_while(Lowerer *lw, const FlatStmt *stmt) {
+    uint32_t body = ir_block(lw->b);
+    uint32_t cond = ir_block(lw->b);
+    uint32_t exit = ir_block(lw->b);
+
+    ir_jump(lw->b, body);
+    ir_set_block(lw->b, body); // Sealed once the condition jumps back
+    lower_body(lw, stmt->_while.body, exit, cond);
+    ir_jump(lw->b, cond);
+
+    enter(lw, cond);
+    branch(lw, stmt->_while.cond, body, exit);
+
+    ir_seal(lw->b, body);
+    enter(lw, exit);
+}
+
+static void lower_for(Lowerer *lw, const FlatStmt *stmt) {
+    uint32_t mark = lw->bind_count;
+    if (stmt->_for.init != NO_NODE) lower_local(lw, decl_at(lw, stmt->_for.init));
+
+    uint32_t head = ir_block(lw->b);
+    uint32_t body = ir_block(lw->b);
+    uint32_t post = ir_block(lw->b);
+    uint32_t exit = ir_block(lw->b);
+
+    ir_jump(lw->b, head);
+    ir_set_block(lw->b, head); // Sealed once the increment jumps back
+    if (stmt->_for.cond != NO_NODE) {
+        branch(lw, stmt->_for.cond, body, exit);
+    } else {
+        ir_jump(lw->b, body);
+    }
+
+    enter(lw, body);
+    lower_body(lw, stmt->_for.body, exit, post);
+    ir_jump(lw->b, post);
+
+    enter(lw, post);
+    if (stmt->_for.post != NO_NODE) lower_expr(lw, stmt->_for.post);
+    ir_jump(lw->b, head);
+
+    ir_seal(lw->b, head);
+    enter(lw, exit);
+    unbind(lw, mark);
+}
+
+static void lower_return(Lowerer *lw, const FlatStmt *stmt) {
+    IrRef value = IR_NONE;
+    if (stmt->expr != NO_NODE) value = lower_expr(lw, stmt->expr);
+    if (value != IR_NONE && lw->ret != IT_VOID) value = ir_conv(lw->b, lw->ret, value);
+
+    ir_ret(lw->b, lw->ret == IT_VOID ? IR_NONE : value);
+}
+
+static void lower_stmt(Lowerer *lw, NodeRef ref) {
+    const FlatStmt *stmt = &lw->ast->stmts[ref];
+
+    switch (stmt->kind) {
+    case STMT_RETURN:   lower_return(lw, stmt); break;
+    case STMT_IF:       lower_if(lw, stmt); break;
+    case STMT_WHILE:    lower_while(lw, stmt); break;
+    case STMT_DO_WHILE: lower_do_while(lw, stmt); break;
+    case STMT_FOR:      lower_for(lw, stmt); break;
+    case STMT_BREAK:
+    case STMT_CONTINUE:
+        if (!lw->loop_count) {
+            unsupported(lw, stmt->line, "'break' and 'continue' outside a loop are");
+        }
+
+        const Loop *loop = &lw->loops[lw->loop_count - 1];
+        ir_jump(lw->b, stmt->kind == STMT_BREAK ? loop->brk : loop->cont);
+        break;
+    case STMT_COMPOUND: lower_block(lw, stmt->block); break;
+    case STMT_EXPR:
+        if (stmt->expr != NO_NODE) lower_expr(lw, stmt->expr);
+        break;
+    default: unsupported(lw, stmt->line, "Statement kind is");
+    }
+}
+
+/*********************************************
+ * Expressions
+ *********************************************/
+
+/**
+ * @brief Type of the value an expression lowers to, without lowering it.
+ * @param lw
+ * @param ref
+ * @return
+ */
+static IrType type_of(Lowerer *lw, NodeRef ref) {
+    const FlatExpr *expr = expr_at(lw, ref);
+
+    switch (expr->kind) {
+    case EXPR_CONST:
+        return expr->op == CONST_INT ? IT_INT : expr->op == CONST_FLOAT ? IT_FLOAT : IT_STRING;
+    case EXPR_VAR: return variable(lw, expr->name, expr->line)->type;
+    case EXPR_UNARY: {
+        if (expr->op == UOP_NOT) return IT_BOOL;
+
+        IrType type = type_of(lw, expr->operand);
+        return type == IT_BOOL ? IT_INT : type;
+    }
+    case EXPR_BINARY:
+        if (expr->op >= BOP_AND) return IT_BOOL; // Logic and comparisons
+        return promote(type_of(lw, expr->binary.left), type_of(lw, expr->binary.right));
+    case EXPR_ASSIGN: return type_of(lw, expr->binary.left);
+    case EXPR_TERNARY: {
+        const NodeRef *ops = lw->ast->extra + expr->conditional;
+        return promote(type_of(lw, ops[1]), type_of(lw, ops[2]));
+    }
+    case EXPR_CALL: {
+        const FlatExpr *callee = expr_at(lw, expr->call.func);
+        uint32_t func = callee->kind == EXPR_VAR ? lookup(&lw->funcs, callee->name) : IR_NONE;
+        return func == IR_NONE ? IT_VOID : lw->mod->funcs[func].ret;
+    }
+    case EXPR_CAST: return map_type(lw, expr->cast.type, expr->line);
+    default:        return IT_VOID;
+    }
+}
+
+/**
+ * @brief Lowers `&&` and `||`. The right operand is only evaluated when the
+ * left one does not decide the result.
+ * @param lw
+ * @param expr
+ * @return
+ */
+static IrRef lower_logical(Lowerer *lw, const FlatExpr *expr) {
+    uint32_t result = ir_var(lw->b, IT_BOOL);
+    uint32_t right  = ir_block(lw->b);
+    uint32_t join   = ir_block(lw->b);
+
+    IrRef left = to_bool(lw, lower_expr(lw, expr->binary.left));
+    ir_def(lw->b, result, left);
+    if (expr->op == BOP_AND) {
+        ir_branch(lw->b, left, right, join);
+    } else {
+        ir_branch(lw->b, left, join, right);
+    }
+
+    enter(lw, right);
+    ir_def(lw->b, result, to_bool(lw, lower_expr(lw, expr->binary.right)));
+    ir_jump(lw->b, join);
+
+    enter(lw, join);
+    return ir_use(lw->b, result);
+}
+
+static IrRef lower_binary(Lowerer *lw, const FlatExpr *expr) {
+    if (expr->op == BOP_AND || expr->op == BOP_OR) return lower_logical(lw, expr);
+
+    IrRef left  = lower_expr(lw, expr->binary.left);
+    IrRef right = lower_expr(lw, expr->binary.right);
+    IrType type = promote(ir_type(lw->b, left), ir_type(lw->b, right));
+
+    left  = ir_conv(lw->b, type, left);
+    right = ir_conv(lw->b, type, right);
+    return ir_binary(lw->b, binary_ops[expr->op], left, right);
+}
+
+static IrRef lower_unary(Lowerer *lw, const FlatExpr *expr) {
+    switch (expr->op) {
+    case UOP_NOT: return ir_unary(lw->b, IR_NOT, to_bool(lw, lower_expr(lw, expr->operand)));
+    case UOP_NEG: {
+        IrRef value = lower_expr(lw, expr->operand);
+        if (ir_type(lw->b, value) == IT_BOOL) value = ir_conv(lw->b, IT_INT, value);
+        return ir_unary(lw->b, IR_NEG, value);
+    }
+    default: unsupported(lw, expr->line, "Address-of and dereference are");
+    }
+}
+
+static IrRef lower_assign(Lowerer *lw, const FlatExpr *expr) {
+    const FlatExpr *target = expr_at(lw, expr->binary.left);
+    if (target->kind != EXPR_VAR) unsupported(lw, expr->line, "Assignment to non variables is");
+
+    const Binding *bnd = variable(lw, target->name, expr->line);
+    bool global        = bnd->global;
+    uint32_t index     = bnd->index;
+    IrRef value        = ir_conv(lw->b, bnd->type, lower_expr(lw, expr->binary.right));
+
+    if (global) {
+        ir_store(lw->b, index, value);
+    } else {
+        ir_def(lw->b, index, value);
+    }
+    return value;
+}
+
+/**
+ * @brief Lowers a conditional expression, only the chosen operand is evaluated.
+ * @param lw
+ * @param expr
+ * @return
+ */
+static IrRef lower_ternary(Lowerer *lw, const FlatExpr *expr) {
+    const NodeRef *ops = lw->ast->extra + expr->conditional; // Left, middle and right
+    IrType type        = promote(type_of(lw, ops[1]), type_of(lw, ops[2]));
+    uint32_t result    = ir_var(lw->b, type);
+    uint32_t then      = ir_block(lw->b);
+    uint32_t else_     = ir_block(lw->b);
+    uint32_t join      = ir_block(lw->b);
+
+    branch(lw, ops[0], then, else_);
+
+    for (int i = 1; i <= 2; i++) {
+        enter(lw, i == 1 ? then : else_);
+        ir_def(lw->b, result, ir_conv(lw->b, type, lower_expr(lw, ops[i])));
+        ir_jump(lw->b, join);
+    }
+
+    enter(lw, join);
+    return ir_use(lw->b, result);
+}
+
+static IrRef lower_call(Lowerer *lw, const FlatExpr *expr) {
+    const FlatExpr *callee = expr_at(lw, expr->call.func);
+    uint32_t func = callee->kind == EXPR_VAR ? lookup(&lw->funcs, callee->name) : IR_NONE;
+    if (func == IR_NONE) unsupported(lw, expr->line, "Calls through function values are");
+
+    const NodeRef *args = flat_items(lw->ast, expr->call.args);
+    uint32_t count      = flat_count(lw->ast, expr->call.args);
+    uint32_t base       = lw->arg_count;
+
+    for (uint32_t i = 0; i < count; i++) {
+        IrRef arg = lower_expr(lw, args[i]);
+        arg       = ir_conv(lw->b, lw->mod->funcs[func].params[i], arg);
+
+        lw->args = grow(lw, lw->args, lw->arg_count, &lw->arg_cap, sizeof(IrRef));
+        lw->args[lw->arg_count++] = arg;
+    }
+
+    lw->arg_count = base;
+    return ir_call(lw->b, func, lw->args + base, count);
+}
+
+/**
+ * @brief Lowers an expression.
+ * @param lw
+ * @param ref
+ * @return Value of the expression, of type `IT_VOID` for a void call.
+ */
+static IrRef lower_expr(Lowerer *lw, NodeRef ref) {
+    const FlatExpr *expr = expr_at(lw, ref);
+
+    switch (expr->kind) {
+    case EXPR_CONST:
+        switch (expr->op) {
+        case CONST_INT:   return ir_const_int(lw->b, IT_INT, expr->ival);
+        case CONST_FLOAT: return ir_const_float(lw->b, expr->fval);
+        default:          return ir_const_str(lw->b, expr->sval);
+        }
+    case EXPR_VAR: {
+        const Binding *bnd = variable(lw, expr->name, expr->line);
+        return bnd->global ? ir_load(lw->b, bnd->index) : ir_use(lw->b, bnd->index);
+    }
+    case EXPR_UNARY:   return lower_unary(lw, expr);
+    case EXPR_BINARY:  return lower_binary(lw, expr);
+    case EXPR_ASSIGN:  return lower_assign(lw, expr);
+    case EXPR_TERNARY: return lower_ternary(lw, expr);
+    case EXPR_CALL:    return lower_call(lw, expr);
+    case EXPR_CAST: {
+        IrType type = map_type(lw, expr->cast.type, expr->line);
+        if (type == IT_VOID) unsupported(lw, expr->line, "Casts to void are");
+        return ir_conv(lw->b, type, lower_expr(lw, expr->cast.expr));
+    }
+    default: unsupported(lw, expr->line, "Expression kind is");
+    }
+}
+
+/*********************************************
+ * Program
+ *********************************************/
+
+/**
+ * @brief Frees the lowerer, not the module it built.
+ * @param lw
+ */
+static void purge_lowerer(Lowerer *lw) {
+    purge_builder(lw->b);
+    free(lw->vars.slots);
+    free(lw->funcs.slots);
+    free(lw->binds);
+    free(lw->loops);
+    free(lw->args);
+    free(lw->params);
+    free(lw);
+}
+
+IrModule *lower_program(CompilerContext *ctx, const FlatAst *ast) {
+    Lowerer *lw   = mem_calloc(1, sizeof(Lowerer));
+    IrModule *mod = lw ? make_module() : NULL;
+    IrBuilder *b  = mod ? make_builder(mod, &lw->fail) : NULL;
+    if (!b) {
+        fail_context(ctx, CERR_NOMEM, "IR allocation failed");
+        purge_module(mod);
+        free(lw);
+        return NULL;
+    }
+    lw->ctx = ctx;
+    lw->ast = ast;
+    lw->mod = mod;
+    lw->b   = b;
+
+    if (setjmp(lw->fail)) {
+        if (!lw->err) fail_context(ctx, CERR_NOMEM, "out of memory while lowering");
+        purge_lowerer(lw);
+        purge_module(mod);
+        return NULL;
+    }
+
+    // Builtin of the analyzer's symbol table
+    IrType print_params[] = {IT_STRING};
+    const Atom *print     = intern_cstr(&ctx->interner, "printf");
+    if (!print) out_of_memory(lw);
+    add_func(lw, print, IT_INT, print_params, 1);
+
+    // Every top level name first, the analyzer has checked declaration order
+    const NodeRef *decls = flat_items(ast, ast->program);
+    uint32_t count       = flat_count(ast, ast->program);
+    for (uint32_t i = 0; i < count; i++) {
+        const FlatDecl *decl = decl_at(lw, decls[i]);
+
+        if (is_func(lw, decl)) {
+            declare_func(lw, decl);
+            continue;
+        }
+
+        IrType type     = map_type(lw, decl->type, decl->line);
+        uint32_t global = ir_add_global(mod, decl->name, type);
+        if (global == IR_NONE) out_of_memory(lw);
+        bind(lw, decl->name, true, type, global);
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        const FlatDecl *decl = decl_at(lw, decls[i]);
+        if (is_func(lw, decl) && decl->func.body != NO_NODE) lower_func(lw, decl);
+    }
+    lower_init(lw);
+
+    purge_lowerer(lw);
+    return mod;
+}
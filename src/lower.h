@@ -0,0 +1,18 @@
+#ifndef _LOWER_H
+#define _LOWER_H
+
+#include "flat.h"
+#include "ir.h"
+
+/**
+ * @brief Lowers a resolved program into SSA form. Every function becomes an IR
+ * function, locals and parameters become SSA values and globals are loaded and
+ * stored. Initializers of globals run in order in a void function `.init`.
+ * @param ctx
+ * @param ast Program the analyzer accepted.
+ * @return NULL if memory ran out or the program uses a construct that cannot
+ * be lowered yet, the error is recorded in `ctx`.
+ */
+IrModule *lower_program(CompilerContext *ctx, const FlatAst *ast);
+
+#endif
@@ -0,0 +1,47 @@
+#include <stdlib.h>
+
+#include "memstat.h"
+
+static _Thread_local MemStats stats;
+
+/**
+ * @brief Counts an allocation of `size` bytes if it succeeded.
+ * @param ptr Allocated block.
+ * @param size
+ * @return `ptr`
+ */
+static void *counted(void *ptr, size_t size) {
+    if (ptr) {
+        stats.allocs++;
+        stats.bytes += size;
+    }
+    return ptr;
+}
+
+void *mem_malloc(size_t size) {
+    return counted(malloc(size), size);
+}
+
+void *mem_calloc(size_t count, size_t size) {
+    return counted(calloc(count, size), count * size);
+}
+
+void *mem_realloc(void *ptr, size_t size) {
+    return counted(realloc(ptr, size), size);
+}
+
+MemStats mem_stats() {
+    return stats;
+}
+
+void mem_absorb(const MemStats *other) {
+    stats.allocs += other->allocs;
+    stats.bytes  += other->bytes;
+}
+
+MemStats mem_since(MemStats start) {
+    return (MemStats){
+        .allocs = stats.allocs - start.allocs,
+        .bytes  = stats.bytes - start.bytes,
+    };
+}
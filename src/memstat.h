@@ -0,0 +1,59 @@
+#ifndef _MEMSTAT_H
+#define _MEMSTAT_H
+
+#include <stddef.h>
+
+// Heap allocations made by the calling thread since it started, and those it
+// absorbed from threads it joined. Blocks are still released with plain
+// `free`, which is not counted.
+typedef struct {
+    size_t allocs; // Successful allocation and reallocation calls
+    size_t bytes;  // Bytes requested by those calls
+} MemStats;
+
+/**
+ * @brief Counted `malloc`.
+ * @param size
+ * @return NULL if memory ran out.
+ */
+void *mem_malloc(size_t size);
+
+/**
+ * @brief Counted `calloc`.
+ * @param count
+ * @param size
+ * @return NULL if memory ran out.
+ */
+void *mem_calloc(size_t count, size_t size);
+
+/**
+ * @brief Counted `realloc`, the whole new size counts as requested.
+ * @param ptr
+ * @param size
+ * @return NULL if memory ran out, `ptr` is left untouched then.
+ */
+void *mem_realloc(void *ptr, size_t size);
+
+/**
+ * @brief Reports the allocations of the calling thread. A compilation runs on
+ * one thread and absorbs the allocations of the threads it starts, so the
+ * difference of two calls is what the code in between allocated.
+ * @return
+ */
+MemStats mem_stats();
+
+/**
+ * @brief Adds allocations made on another thread to the calling thread's,
+ * once that thread is joined.
+ * @param other Allocations of the joined thread, see `mem_since`.
+ */
+void mem_absorb(const MemStats *other);
+
+/**
+ * @brief Allocations of the calling thread since `start`.
+ * @param start Earlier result of `mem_stats`.
+ * @return
+ */
+MemStats mem_since(MemStats start);
+
+#endif
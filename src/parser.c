@@ -3,8 +3,8 @@
 #include <string.h>
 
 #include "lexer.h"
+#include "memstat.h"
 #include "parser.h"
-#include "utils.h"
 
 /*********************************************
  * Function Declarations
@@ -12,20 +12,22 @@
 
 static int precedence(TokType type);
 
-static Type *parse_type_specifier(Parser *prs);
+static const Type *parse_type_specifier(Parser *prs);
 static TypeKind tok_to_typekind(TokType type);
 static StgClass tok_to_sc(TokType type);
-static DeclInfo process_declarator(Parser *prs, Type *base_type);
+static DeclInfo process_declarator(Parser *prs, const Type *base_type);
 static Decl *parse_declaration(Parser *prs);
 static ConstType tok_to_consttype(TokType type);
 
 static UnOp tok_to_unop(TokType type);
 static BinOp tok_to_binop(TokType type);
 
-static Token *peek(Parser *prs);
-static Token *peek_next(Parser *prs);
-static Token *advance(Parser *prs);
-static Token *expect(Parser *prs, TokType type, const char *msg);
+static TokType peek(Parser *prs);
+static TokType peek_next(Parser *prs);
+static int peek_line(Parser *prs);
+static bool fetch(Parser *prs, int tok);
+static int advance(Parser *prs);
+static int expect(Parser *prs, TokType type, const char *msg);
 
 static Block *parse_block(Parser *prs);
 static Stmt *parse_stmt(Parser *prs);
@@ -33,12 +35,18 @@ static Stmt *parse_stmt(Parser *prs);
 static Expr *parse_expr(Parser *prs, int min_prec);
 static Expr *parse_primary_expr(Parser *prs);
 
-static Expr *create_const_expr(ConstType const_type, Token *tok);
-static Expr *create_var_expr(const char *name);
-static Expr *create_unary_expr(UnOp op, Expr *u);
-static Expr *create_binary_expr(BinOp op, Expr *left, Expr *right);
-static Expr *create_assign_expr(Expr *left, Expr *right);
-static Expr *create_call_expr(Expr *func, Expr **args, unsigned arg_count);
+static _Noreturn void out_of_memory(Parser *prs);
+static void *alloc(Parser *prs, size_t size);
+static void *new_node(Parser *prs, size_t size, NodeType kind);
+static void push_child(Parser *prs, void *child);
+static void *pop_children(Parser *prs, unsigned mark);
+
+static Expr *create_const_expr(Parser *prs, ConstType const_type, const char *val, unsigned len);
+static Expr *create_var_expr(Parser *prs, const Atom *name);
+static Expr *create_unary_expr(Parser *prs, UnOp op, Expr *u);
+static Expr *create_binary_expr(Parser *prs, BinOp op, Expr *left, Expr *right);
+static Expr *create_assign_expr(Parser *prs, Expr *left, Expr *right);
+static Expr *create_call_expr(Parser *prs, Expr *func, Expr **args, unsigned arg_count);
 
 static bool isbinop(TokType type);
 static bool isunop(TokType type);
@@ -46,7 +54,15 @@ static bool isasnop(TokType type);
 static bool istypetok(TokType type);
 static bool isacctok(TokType type);
 
-static void errexitinfo(Parser *prs, const char *msg);
+static void report(Parser *prs, const char *msg);
+static void errinfo(Parser *prs, const char *msg);
+static void synchronize(Parser *prs, int start);
+static bool too_many_errors(Parser *prs);
+static const char *tokval(Parser *prs, int tok);
+static const Atom *tokatom(Parser *prs, int tok);
+static int tokslot(Parser *prs, int tok);
+static int tokline(Parser *prs, int tok);
+static int tokcol(Parser *prs, int tok);
 
 /*********************************************
  * Data Definitions
@@ -98,20 +114,114 @@ static const BinOp binop_table[] = {
  * Helper Functions
  *********************************************/
 
-static void errexitinfo(Parser *prs, const char *msg) {
-    Token *next = peek(prs);
-    if (next) {
-        fprintf(stderr, "Error: %s at '%s' (line %d)\n", msg, ttypestr[next->type], next->line);
+/**
+ * @brief Records a syntax error at the next token. Errors are suppressed while
+ * recovering from a previous one.
+ * @param prs
+ * @param msg
+ */
+static void report(Parser *prs, const char *msg) {
+    if (prs->panic) return;
+
+    prs->errors++;
+
+    int tok = prs->pos + 1;
+    if (fetch(prs, tok)) {
+        TokType type = prs->list->types[tokslot(prs, tok)];
+        report_error(
+            prs->ctx, tokline(prs, tok), tokcol(prs, tok), "%s at '%s'", msg, ttypestr[type]
+        );
     } else {
-        fprintf(stderr, "Error: %s at end of input\n", msg);
+        tok = prs->list->count - 1;
+        report_error(prs->ctx, tokline(prs, tok), tokcol(prs, tok), "%s at end of input", msg);
     }
-    exit(1);
 }
 
-static Token *expect(Parser *prs, TokType expr_type, const char *msg) {
-    Token *next = peek(prs);
-    if (!next || next->type != expr_type) {
-        errexitinfo(prs, msg);
+// Parsing stops once the context can't keep any more of our errors, the errors
+// of the input left are lost then
+static bool too_many_errors(Parser *prs) {
+    if (!prs->errors || !diags_full(&prs->ctx->diags)) return false;
+
+    prs->ctx->diags.dropped = true;
+    return true;
+}
+
+/**
+ * @brief Records a syntax error and enters panic mode, which lasts until the
+ * enclosing declaration or statement loop resynchronizes.
+ * @param prs
+ * @param msg
+ */
+static void errinfo(Parser *prs, const char *msg) {
+    report(prs, msg);
+    prs->panic = true;
+}
+
+/**
+ * @brief Skips to the next likely item boundary after a syntax error: past a
+ * ';', or up to a '}' or a type starting a declaration. Braced regions are
+ * skipped whole. Nothing is skipped if the failed item ended with its own ';'
+ * or '}', and at least one token is if it consumed none.
+ * @param prs
+ * @param start Position before the failed item.
+ */
+static void synchronize(Parser *prs, int start) {
+    if (prs->pos == start) {
+        advance(prs);
+    } else {
+        // The failed item already ended on a boundary
+        TokType last = prs->list->types[tokslot(prs, prs->pos)];
+        if (last == T_SCOLON || last == T_RBRACE) {
+            prs->panic = false;
+            return;
+        }
+    }
+
+    int depth = 0;
+    for (TokType type = peek(prs); type != T_EOF; type = peek(prs)) {
+        if (depth == 0 && (type == T_RBRACE || istypetok(type))) break;
+
+        advance(prs);
+        if (type == T_LBRACE) depth++;
+        if (type == T_RBRACE) depth--;
+        if (depth == 0 && type == T_SCOLON) break;
+    }
+    prs->panic = false;
+}
+
+// Streams keep recent tokens in a ring, complete lists have an all ones mask
+static int tokslot(Parser *prs, int tok) {
+    return tok & prs->list->mask;
+}
+
+static int tokline(Parser *prs, int tok) {
+    return prs->list->lines[tokslot(prs, tok)];
+}
+
+static int tokcol(Parser *prs, int tok) {
+    return prs->list->cols[tokslot(prs, tok)];
+}
+
+// Token values are slices of the source buffer, `lens[tok]` bytes long
+static const char *tokval(Parser *prs, int tok) {
+    return prs->list->source + prs->list->offs[tokslot(prs, tok)];
+}
+
+// Identifiers are interned with the hash computed by the lexer
+static const Atom *tokatom(Parser *prs, int tok) {
+    int i            = tokslot(prs, tok);
+    unsigned len     = prs->list->lens[i];
+    unsigned hash    = prs->list->hashes[i];
+    const Atom *atom = intern_hashed(&prs->ctx->interner, tokval(prs, tok), len, hash);
+    if (!atom) out_of_memory(prs);
+    return atom;
+}
+
+// Consumes the expected token, a mismatch is reported and left unconsumed
+static int expect(Parser *prs, TokType expr_type, const char *msg) {
+    if (peek(prs) != expr_type) {
+        errinfo(prs, msg);
+        return prs->pos;
     }
     return advance(prs);
 }
@@ -120,65 +230,157 @@ static Token *expect(Parser *prs, TokType expr_type, const char *msg) {
  * Parser Initialization
  *********************************************/
 
-Parser *make_parser(const TokList *list) {
-    Parser *prs = malloc(sizeof(Parser));
-    prs->list   = list;
-    prs->pos    = -1;
-    prs->token  = NULL;
+Parser *make_parser(CompilerContext *ctx, TokList *list) {
+    Parser *prs = mem_calloc(1, sizeof(Parser));
+    if (!prs) {
+        fail_context(ctx, CERR_NOMEM, "parser allocation failed");
+        return NULL;
+    }
+
+    prs->ctx  = ctx;
+    prs->list = list;
+    prs->pos  = -1;
     return prs;
 }
 
-static Token *peek(Parser *prs) {
-    return (prs->pos + 1 < prs->list->count) ? prs->list->tokens[prs->pos + 1] : NULL;
+ParseStats parse_stats(const Parser *prs) {
+    ParseStats stats = {
+        .used     = prs->arena.used,
+        .reserved = prs->arena.reserved,
+    };
+    memcpy(stats.nodes, prs->nodes, sizeof(stats.nodes));
+    stats.nodes[NODE_TYPE] = prs->ctx->types.count;
+    return stats;
 }
 
-static Token *peek_next(Parser *prs) {
-    return (prs->pos + 2 < prs->list->count) ? prs->list->tokens[prs->pos + 2] : NULL;
+/**
+ * @brief Abandons the parse, `parse_program` returns NULL.
+ * @param prs
+ */
+static _Noreturn void out_of_memory(Parser *prs) {
+    fail_context(prs->ctx, CERR_NOMEM, "out of memory while parsing");
+    longjmp(prs->fail, 1);
 }
 
-static Token *advance(Parser *prs) {
-    if (prs->pos < prs->list->count - 1) {
-        prs->token = prs->list->tokens[++prs->pos];
-    } else {
-        prs->token = NULL;
+// Allocates from the parser's arena, giving up the parse if memory ran out
+static void *alloc(Parser *prs, size_t size) {
+    void *ptr = arena_alloc(&prs->arena, size);
+    if (!ptr) out_of_memory(prs);
+    return ptr;
+}
+
+// Takes a type from the context's type table, giving up the parse if memory ran out
+static const Type *canon(Parser *prs, const Type *type) {
+    if (!type) out_of_memory(prs);
+    return type;
+}
+
+/**
+ * @brief Allocates a zeroed node from the parser's arena.
+ * @param prs
+ * @param size Size of the node structure.
+ * @param kind
+ * @return
+ */
+static void *new_node(Parser *prs, size_t size, NodeType kind) {
+    Node *node = alloc(prs, size);
+    memset(node, 0, size);
+
+    node->node_type = kind;
+    prs->nodes[kind]++;
+    return node;
+}
+
+// Pushes a child of the node being built onto the scratch stack
+static void push_child(Parser *prs, void *child) {
+    Scratch *scr = &prs->scratch;
+    if (scr->count == scr->capacity) {
+        unsigned capacity = scr->capacity ? scr->capacity * 2 : 64;
+        void **items      = mem_realloc(scr->items, capacity * sizeof(void *));
+        if (!items) out_of_memory(prs);
+
+        scr->items    = items;
+        scr->capacity = capacity;
     }
-    return prs->token;
+    scr->items[scr->count++] = child;
+}
+
+/**
+ * @brief Pops the children pushed since `mark` into an exactly sized arena array.
+ * @param prs
+ * @param mark Scratch count before the first child was pushed.
+ * @return Child array, NULL when there are no children.
+ */
+static void *pop_children(Parser *prs, unsigned mark) {
+    Scratch *scr   = &prs->scratch;
+    unsigned count = scr->count - mark;
+    if (!count) return NULL;
+
+    void **children = alloc(prs, count * sizeof(void *));
+    memcpy(children, scr->items + mark, count * sizeof(void *));
+    scr->count = mark;
+    return children;
+}
+
+// Makes token `tok` available, pulling from the lexer when parsing a stream
+static bool fetch(Parser *prs, int tok) {
+    while (tok >= prs->list->count) {
+        if (!pull_token(prs->list)) return false;
+    }
+    return true;
+}
+
+// Lookahead reads the packed type array, past the end reads as `T_EOF`
+static TokType peek(Parser *prs) {
+    int tok = prs->pos + 1;
+    return fetch(prs, tok) ? prs->list->types[tokslot(prs, tok)] : T_EOF;
+}
+
+static TokType peek_next(Parser *prs) {
+    int tok = prs->pos + 2;
+    return fetch(prs, tok) ? prs->list->types[tokslot(prs, tok)] : T_EOF;
+}
+
+static int peek_line(Parser *prs) {
+    int tok = prs->pos + 1;
+    return tokline(prs, fetch(prs, tok) ? tok : prs->list->count - 1);
+}
+
+// Consumes the next token and returns it's index, stays on the last token at the end
+static int advance(Parser *prs) {
+    if (fetch(prs, prs->pos + 1)) prs->pos++;
+    return prs->pos;
 }
 
 /*********************************************
  * Type Parsing
  *********************************************/
 
-static Type *parse_type_specifier(Parser *prs) {
-    if (!istypetok(peek(prs)->type)) {
-        errexitinfo(prs, "Expected type specifier");
+static const Type *parse_type_specifier(Parser *prs) {
+    TypeTable *tt = &prs->ctx->types;
+
+    if (!istypetok(peek(prs))) {
+        errinfo(prs, "Expected type specifier");
+        return canon(prs, basic_type(tt, TY_INT)); // Placeholder so the caller can carry on
     }
 
-    Token *tok                = peek(prs);
-    Type *expr_type           = malloc(sizeof(Type));
-    expr_type->base.node_type = NODE_TYPE;
-    expr_type->type_kind      = tok_to_typekind(tok->type);
-    advance(prs);
-    return expr_type;
+    int tok = advance(prs);
+    return canon(prs, basic_type(tt, tok_to_typekind(prs->list->types[tokslot(prs, tok)])));
 }
 
 /*********************************************
  * Declarator Processing
  *********************************************/
 
-static DeclInfo process_declarator(Parser *prs, Type *base_type) {
+static DeclInfo process_declarator(Parser *prs, const Type *base_type) {
     // Handle pointers
-    if (peek(prs) && peek(prs)->type == T_ASTERISK) {
+    if (peek(prs) == T_ASTERISK) {
         advance(prs);
-        Type *ptr_type           = malloc(sizeof(Type));
-        ptr_type->base.node_type = NODE_TYPE;
-        ptr_type->type_kind      = TY_PTR;
-        ptr_type->ptr.ref        = base_type;
-        return process_declarator(prs, ptr_type);
+        return process_declarator(prs, canon(prs, pointer_type(&prs->ctx->types, base_type)));
     }
 
     // Handle grouping parentheses
-    if (peek(prs) && peek(prs)->type == T_LPAREN) {
+    if (peek(prs) == T_LPAREN) {
         advance(prs);
         DeclInfo inner = process_declarator(prs, base_type);
         expect(prs, T_RPAREN, "Expected ')' after declarator");
@@ -187,58 +389,64 @@ static DeclInfo process_declarator(Parser *prs, Type *base_type) {
 
     // Handle identifier (must come after pointers/grouping)
     DeclInfo info = {0};
-    if (peek(prs) && peek(prs)->type == T_IDENT) {
-        info.name = peek(prs)->value ? strdup(peek(prs)->value) : NULL;
+    if (peek(prs) == T_IDENT) {
+        info.name = tokatom(prs, advance(prs));
         info.type = base_type;
-        advance(prs);
     } else {
-        errexitinfo(prs, "Expected identifier in declarator");
+        errinfo(prs, "Expected identifier in declarator");
+        info.type = base_type;
     }
 
     // Handle function parameters AFTER identifier
-    while (peek(prs) && peek(prs)->type == T_LPAREN) {
+    while (peek(prs) == T_LPAREN) {
         advance(prs);
 
-        Type **param_types   = NULL;
-        char **param_names   = NULL;
-        unsigned param_count = 0;
+        unsigned mark = prs->scratch.count;
 
-        while (peek(prs) && peek(prs)->type != T_RPAREN) {
+        while (peek(prs) != T_RPAREN && peek(prs) != T_EOF) {
             // Parse parameter type
-            Type *param_base    = parse_type_specifier(prs);
-            DeclInfo param_info = process_declarator(prs, param_base);
+            const Type *param_base = parse_type_specifier(prs);
+            DeclInfo param_info    = process_declarator(prs, param_base);
 
             // Add error check for invalid parameter type
             if (!param_info.type) {
-                errexitinfo(prs, "Invalid parameter type");
+                errinfo(prs, "Invalid parameter type");
             }
 
-            param_types              = realloc(param_types, (param_count + 1) * sizeof(Type *));
-            param_names              = realloc(param_names, (param_count + 1) * sizeof(char *));
-            param_types[param_count] = param_info.type;
-            param_names[param_count] = param_info.name;
-            param_count++;
+            // Types and names are pushed in pairs
+            push_child(prs, (void *)param_info.type);
+            push_child(prs, (void *)param_info.name);
 
-            if (peek(prs)->type != T_COMMA) break;
+            if (peek(prs) != T_COMMA) break;
             advance(prs);
         }
 
         expect(prs, T_RPAREN, "Expected ')' after parameters");
 
-        // Create function expr_type wrapping previous expr_type
-        Type *func_type             = malloc(sizeof(Type));
-        func_type->base.node_type   = NODE_TYPE;
-        func_type->type_kind        = TY_FUNC;
-        func_type->func.ret         = base_type;
-        func_type->func.params      = param_types;
-        func_type->func.param_count = param_count;
+        unsigned param_count     = (prs->scratch.count - mark) / 2;
+        const Type **param_types = NULL;
+        const Atom **param_names = NULL;
+
+        if (param_count) {
+            void **pairs = prs->scratch.items + mark;
+            param_types  = alloc(prs, param_count * sizeof(Type *));
+            param_names  = alloc(prs, param_count * sizeof(const Atom *));
+            for (unsigned i = 0; i < param_count; i++) {
+                param_types[i] = pairs[2 * i];
+                param_names[i] = pairs[2 * i + 1];
+            }
+            prs->scratch.count = mark;
+        }
 
-        if (!func_type->func.ret || !func_type->func.params) {
-            errexitinfo(prs, "Invalid function type definition");
+        if (!base_type || !param_types) {
+            report(prs, "Invalid function type definition");
         }
 
+        // Function type wrapping the previous type
+        const Type *fn_type = func_type(&prs->ctx->types, base_type, param_types, param_count);
+
         // Update declarator info
-        info.type         = func_type;
+        info.type         = canon(prs, fn_type);
         info.params.names = param_names;
         info.params.count = param_count;
     }
@@ -251,34 +459,38 @@ static DeclInfo process_declarator(Parser *prs, Type *base_type) {
  *********************************************/
 
 static Decl *parse_declaration(Parser *prs) {
+    int line = peek_line(prs);
+
     // Parse base expr_type
-    Type *base_type = parse_type_specifier(prs);
+    const Type *base_type = parse_type_specifier(prs);
 
     // Process declarator
     DeclInfo decl_info = process_declarator(prs, base_type);
 
     // Build declaration
-    Decl *decl           = malloc(sizeof(Decl));
-    decl->base.node_type = NODE_DECL;
-    decl->name           = decl_info.name;
-    decl->type           = decl_info.type;
-    decl->class          = SC_NONE;
+    Decl *decl      = new_node(prs, sizeof(Decl), NODE_DECL);
+    decl->base.line = line;
+    decl->name      = decl_info.name;
+    decl->type      = decl_info.type;
+    decl->class     = SC_NONE;
 
     if (decl_info.type->type_kind == TY_FUNC) {
         // Create parameters
-        decl->func.params = malloc(decl_info.params.count * sizeof(Decl *));
+        decl->func.params = alloc(prs, decl_info.params.count * sizeof(Decl *));
         for (unsigned i = 0; i < decl_info.params.count; i++) {
-            Decl *param           = malloc(sizeof(Decl));
-            param->base.node_type = NODE_DECL;
-            param->name           = decl_info.params.names ? decl_info.params.names[i] : NULL;
-            param->type           = decl->type->func.params ? decl->type->func.params[i] : NULL;
-            param->class          = SC_NONE;
-            decl->func.params[i]  = param;
+            Decl *param          = new_node(prs, sizeof(Decl), NODE_DECL);
+            param->base.line     = line;
+            param->name          = decl_info.params.names ? decl_info.params.names[i] : NULL;
+            param->type          = decl->type->func.params ? decl->type->func.params[i] : NULL;
+            param->class         = SC_NONE;
+            param->var.init      = NULL;
+            decl->func.params[i] = param;
         }
         decl->func.param_count = decl_info.params.count;
+        decl->func.body        = NULL;
 
         // Parse function body
-        if (peek(prs)->type == T_LBRACE) {
+        if (peek(prs) == T_LBRACE) {
             decl->func.body = parse_block(prs);
         } else {
             expect(prs, T_SCOLON, "Expected ';' after function declaration");
@@ -287,7 +499,8 @@ static Decl *parse_declaration(Parser *prs) {
 
     else {
         // Variable initialization
-        if (peek(prs)->type == T_EQ) {
+        decl->var.init = NULL;
+        if (peek(prs) == T_EQ) {
             advance(prs);
             decl->var.init = parse_expr(prs, 0);
         }
@@ -301,22 +514,25 @@ static Decl *parse_declaration(Parser *prs) {
  *********************************************/
 
 static Block *parse_block(Parser *prs) {
-    Block *block          = malloc(sizeof(Block));
-    block->base.node_type = NODE_BLOCK;
-    block->items          = NULL;
-    block->item_count     = 0;
+    Block *block     = new_node(prs, sizeof(Block), NODE_BLOCK);
+    block->base.line = peek_line(prs);
+    unsigned mark    = prs->scratch.count;
 
     expect(prs, T_LBRACE, "Expected '{'");
 
-    while (peek(prs) && peek(prs)->type != T_RBRACE) {
-        block->items = realloc(block->items, (block->item_count + 1) * sizeof(Node *));
-        if (istypetok(peek(prs)->type)) {
-            block->items[block->item_count++] = (Node *)parse_declaration(prs);
+    while (peek(prs) != T_RBRACE && peek(prs) != T_EOF && !too_many_errors(prs)) {
+        int start = prs->pos;
+        if (istypetok(peek(prs))) {
+            push_child(prs, parse_declaration(prs));
         } else {
-            block->items[block->item_count++] = (Node *)parse_stmt(prs);
+            push_child(prs, parse_stmt(prs));
         }
+        if (prs->panic) synchronize(prs, start);
     }
     expect(prs, T_RBRACE, "Expected '}'");
+
+    block->item_count = prs->scratch.count - mark;
+    block->items      = pop_children(prs, mark);
     return block;
 }
 
@@ -325,11 +541,10 @@ static Block *parse_block(Parser *prs) {
  *********************************************/
 
 static Stmt *parse_stmt(Parser *prs) {
-    Token *next          = peek(prs);
-    Stmt *stmt           = malloc(sizeof(Stmt));
-    stmt->base.node_type = NODE_STMT;
+    Stmt *stmt      = new_node(prs, sizeof(Stmt), NODE_STMT);
+    stmt->base.line = peek_line(prs);
 
-    switch (next->type) {
+    switch (peek(prs)) {
     case T_LBRACE:
         stmt->stmt_type      = STMT_COMPOUND;
         stmt->compound.block = parse_block(prs);
@@ -355,23 +570,24 @@ static Stmt *parse_stmt(Parser *prs) {
  *********************************************/
 
 static Expr *parse_expr(Parser *prs, int min_prec) {
-    Expr *left  = parse_primary_expr(prs);
-    Token *next = peek(prs);
+    Expr *left   = parse_primary_expr(prs);
+    TokType next = peek(prs);
 
-    while (next && isbinop(next->type) && precedence(next->type) >= min_prec) {
-        TokType optoken = next->type;
+    while (isbinop(next) && precedence(next) >= min_prec) {
+        TokType optoken = next;
         int opprec      = precedence(optoken);
-
-        advance(prs); // Consume the operator
+        int line        = tokline(prs, advance(prs)); // Consume the operator
 
         if (optoken == T_EQ) {
             // Right-associative
-            Expr *right = parse_expr(prs, opprec);
-            left        = create_assign_expr(left, right);
+            Expr *right     = parse_expr(prs, opprec);
+            left            = create_assign_expr(prs, left, right);
+            left->base.line = line;
         } else {
             // Left-associative
-            Expr *right = parse_expr(prs, opprec + 1);
-            left        = create_binary_expr(tok_to_binop(optoken), left, right);
+            Expr *right     = parse_expr(prs, opprec + 1);
+            left            = create_binary_expr(prs, tok_to_binop(optoken), left, right);
+            left->base.line = line;
         }
         next = peek(prs);
     }
@@ -379,108 +595,127 @@ static Expr *parse_expr(Parser *prs, int min_prec) {
 }
 
 static Expr *parse_primary_expr(Parser *prs) {
-    Token *next = peek(prs);
+    TokType next = peek(prs);
 
-    if (next->type == T_IDENT) {
-        Expr *var = create_var_expr(next->value);
-        advance(prs);
-        if (peek(prs) && peek(prs)->type == T_LPAREN) {
+    if (next == T_IDENT) {
+        int tok        = advance(prs);
+        Expr *var      = create_var_expr(prs, tokatom(prs, tok));
+        var->base.line = tokline(prs, tok);
+        if (peek(prs) == T_LPAREN) {
             advance(prs);
-            Expr **args        = NULL;
-            unsigned arg_count = 0;
+            unsigned mark = prs->scratch.count;
 
-            while (peek(prs) && peek(prs)->type != T_RPAREN) {
-                args              = realloc(args, (arg_count + 1) * sizeof(Expr *));
-                args[arg_count++] = parse_expr(prs, 0);
-                if (peek(prs)->type != T_COMMA) break;
+            while (peek(prs) != T_RPAREN && peek(prs) != T_EOF) {
+                push_child(prs, parse_expr(prs, 0));
+                if (peek(prs) != T_COMMA) break;
                 advance(prs);
             }
             expect(prs, T_RPAREN, "Expected ')'");
-            return create_call_expr(var, args, arg_count);
+
+            unsigned arg_count = prs->scratch.count - mark;
+            Expr **args        = pop_children(prs, mark);
+
+            Expr *call      = create_call_expr(prs, var, args, arg_count);
+            call->base.line = var->base.line;
+            return call;
         }
         return var;
     }
 
-    else if (next->type == T_INT_LIT || next->type == T_FLOAT_LIT || next->type == T_STRING_LIT) {
-        Expr *c = create_const_expr(tok_to_consttype(next->type), next);
-        advance(prs);
+    else if (next == T_INT_LIT || next == T_FLOAT_LIT || next == T_STRING_LIT) {
+        int tok         = advance(prs);
+        ConstType ctype = tok_to_consttype(next);
+        unsigned len    = prs->list->lens[tokslot(prs, tok)];
+        Expr *c         = create_const_expr(prs, ctype, tokval(prs, tok), len);
+        c->base.line    = tokline(prs, tok);
 
         return c;
     }
 
-    else if (isunop(next->type)) {
-        UnOp op = tok_to_unop(next->type);
-        advance(prs);
+    else if (isunop(next)) {
+        UnOp op       = tok_to_unop(next);
+        int line      = tokline(prs, advance(prs));
         Expr *operand = parse_primary_expr(prs);
 
-        return create_unary_expr(op, operand);
+        Expr *unary      = create_unary_expr(prs, op, operand);
+        unary->base.line = line;
+        return unary;
     }
-    errexitinfo(prs, "Unexpected token in expression");
-    exit(1);
+    errinfo(prs, "Unexpected token in expression");
+
+    // Placeholder so the caller can carry on
+    Expr *c      = create_const_expr(prs, CONST_INT, "0", 1);
+    c->base.line = peek_line(prs);
+    return c;
 }
 
 /*********************************************
  * Expression Creation
  *********************************************/
 
-static Expr *create_assign_expr(Expr *left, Expr *right) {
-    Expr *expr             = malloc(sizeof(Expr));
-    expr->base.node_type   = NODE_EXPR;
+static Expr *create_assign_expr(Parser *prs, Expr *left, Expr *right) {
+    Expr *expr             = new_node(prs, sizeof(Expr), NODE_EXPR);
     expr->expr_type        = EXPR_ASSIGN;
     expr->assignment.left  = left;
     expr->assignment.right = right;
     return expr;
 }
 
-static Expr *create_const_expr(ConstType const_type, Token *tok) {
-    Expr *expr                = malloc(sizeof(Expr));
-    expr->base.node_type      = NODE_EXPR;
+static Expr *create_const_expr(Parser *prs, ConstType const_type, const char *val, unsigned len) {
+    Expr *expr                = new_node(prs, sizeof(Expr), NODE_EXPR);
     expr->expr_type           = EXPR_CONST;
     expr->constant.const_type = const_type;
 
+    // Numbers are converted from a terminated copy on the stack
+    char num[64];
+    if (const_type != CONST_STR) {
+        unsigned n = len < sizeof(num) ? len : sizeof(num) - 1;
+        memcpy(num, val, n);
+        num[n] = '\0';
+    }
+
     switch (const_type) {
-    case CONST_INT:   expr->constant.ival = atoi(tok->value); break;
-    case CONST_FLOAT: expr->constant.fval = atof(tok->value); break;
-    case CONST_STR:   expr->constant.sval = strdup(tok->value); break;
-    default:          break;
+    case CONST_INT:   expr->constant.ival = atoi(num); break;
+    case CONST_FLOAT: expr->constant.fval = atof(num); break;
+    case CONST_STR:
+        expr->constant.sval = arena_strndup(&prs->arena, val, len);
+        if (!expr->constant.sval) out_of_memory(prs);
+        break;
+    default: break;
     }
 
     return expr;
 }
 
-static Expr *create_var_expr(const char *name) {
-    Expr *expr           = malloc(sizeof(Expr));
-    expr->base.node_type = NODE_EXPR;
-    expr->expr_type      = EXPR_VAR;
-    expr->variable.name  = strdup(name);
+static Expr *create_var_expr(Parser *prs, const Atom *name) {
+    Expr *expr          = new_node(prs, sizeof(Expr), NODE_EXPR);
+    expr->expr_type     = EXPR_VAR;
+    expr->variable.name = name;
 
     return expr;
 }
 
-static Expr *create_unary_expr(UnOp op, Expr *operand) {
-    Expr *expr           = malloc(sizeof(Expr));
-    expr->base.node_type = NODE_EXPR;
-    expr->expr_type      = EXPR_UNARY;
-    expr->unary.op       = op;
-    expr->unary.expr     = operand;
+static Expr *create_unary_expr(Parser *prs, UnOp op, Expr *operand) {
+    Expr *expr       = new_node(prs, sizeof(Expr), NODE_EXPR);
+    expr->expr_type  = EXPR_UNARY;
+    expr->unary.op   = op;
+    expr->unary.expr = operand;
 
     return expr;
 }
 
-static Expr *create_binary_expr(BinOp op, Expr *left, Expr *right) {
-    Expr *expr           = malloc(sizeof(Expr));
-    expr->base.node_type = NODE_EXPR;
-    expr->expr_type      = EXPR_BINARY;
-    expr->binary.op      = op;
-    expr->binary.left    = left;
-    expr->binary.right   = right;
+static Expr *create_binary_expr(Parser *prs, BinOp op, Expr *left, Expr *right) {
+    Expr *expr         = new_node(prs, sizeof(Expr), NODE_EXPR);
+    expr->expr_type    = EXPR_BINARY;
+    expr->binary.op    = op;
+    expr->binary.left  = left;
+    expr->binary.right = right;
 
     return expr;
 }
 
-static Expr *create_call_expr(Expr *func, Expr **args, unsigned arg_count) {
-    Expr *expr           = malloc(sizeof(Expr));
-    expr->base.node_type = NODE_EXPR;
+static Expr *create_call_expr(Parser *prs, Expr *func, Expr **args, unsigned arg_count) {
+    Expr *expr           = new_node(prs, sizeof(Expr), NODE_EXPR);
     expr->expr_type      = EXPR_CALL;
     expr->call.func      = func;
     expr->call.args      = args;
@@ -581,125 +816,36 @@ static StgClass tok_to_sc(TokType type) {
  *********************************************/
 
 Program *parse_program(Parser *prs) {
-    Program *prog        = malloc(sizeof(Program));
-    prog->base.node_type = NODE_PROGRAM;
-    prog->decls          = NULL;
-    prog->decl_count     = 0;
+    if (setjmp(prs->fail)) return NULL;
 
-    while (peek(prs) && peek(prs)->type != T_EOF) {
-        prog->decls = realloc(prog->decls, (prog->decl_count + 1) * sizeof(Decl *));
-        prog->decls[prog->decl_count++] = parse_declaration(prs);
+    Program *prog   = new_node(prs, sizeof(Program), NODE_PROGRAM);
+    prog->base.line = 1;
+    unsigned mark   = prs->scratch.count;
+
+    while (peek(prs) != T_EOF && !too_many_errors(prs)) {
+        int start = prs->pos;
+        push_child(prs, parse_declaration(prs));
+        if (prs->panic) synchronize(prs, start);
     }
 
+    prog->decl_count = prs->scratch.count - mark;
+    prog->decls      = pop_children(prs, mark);
+
+    if (prs->errors) {
+        set_error(prs->ctx, CERR_SYNTAX);
+        return NULL;
+    }
     return prog;
 }
 
 /*********************************************
  * Cleanup Functions
  *********************************************/
-void purge_stmt(Stmt *stmt);
-void purge_block(Block *block);
-void purge_decl(Decl *decl);
-
-void purge_expr(Expr *expr) {
-    if (!expr) return;
-
-    switch (expr->expr_type) {
-    case EXPR_VAR: free(expr->variable.name); break;
-    case EXPR_CONST:
-        if (expr->constant.const_type == CONST_STR && expr->constant.sval) {
-            free(expr->constant.sval);
-        }
-        break;
-    case EXPR_UNARY: purge_expr(expr->unary.expr); break;
-    case EXPR_BINARY:
-        purge_expr(expr->binary.left);
-        purge_expr(expr->binary.right);
-        break;
-    case EXPR_CALL:
-        purge_expr(expr->call.func);
-        for (unsigned i = 0; i < expr->call.arg_count; i++) {
-            purge_expr(expr->call.args[i]);
-        }
-        free(expr->call.args);
-        break;
-    }
-    free(expr);
-}
-
-void purge_stmt(Stmt *stmt) {
-    if (!stmt) return;
-
-    switch (stmt->stmt_type) {
-    case STMT_COMPOUND: purge_block(stmt->compound.block); break;
-    case STMT_RETURN:   purge_expr(stmt->_return.expr); break;
-    case STMT_EXPR:     purge_expr(stmt->expr); break;
-    }
-    free(stmt);
-}
-
-void purge_block(Block *block) {
-    if (!block) return;
-
-    for (unsigned i = 0; i < block->item_count; i++) {
-        Node *node = block->items[i];
-        switch (node->node_type) {
-        case NODE_DECL: purge_decl((Decl *)node); break;
-        case NODE_STMT: purge_stmt((Stmt *)node); break;
-        default:        break;
-        }
-    }
-    free(block->items);
-    free(block);
-}
-
-void purge_type(Type *type) {
-    if (!type) return;
-
-    switch (type->type_kind) {
-    case TY_PTR: purge_type(type->ptr.ref); break;
-    case TY_FUNC:
-        purge_type(type->func.ret);
-        for (unsigned i = 0; i < type->func.param_count; i++) {
-            purge_type(type->func.params[i]);
-        }
-        free(type->func.params);
-        break;
-    default: break;
-    }
-    free(type);
-}
-
-void purge_decl(Decl *decl) {
-    if (!decl) return;
-
-    free(decl->name);
-    purge_type(decl->type);
-
-    // Free parameters
-    for (unsigned i = 0; i < decl->func.param_count; i++) {
-        purge_decl(decl->func.params[i]);
-    }
-    free(decl->func.params);
-
-    purge_expr(decl->var.init);
-    purge_block(decl->func.body);
-    free(decl);
-}
-
-void purge_program(Program *prog) {
-    if (!prog) return;
-
-    for (unsigned i = 0; i < prog->decl_count; i++) {
-        purge_decl(prog->decls[i]);
-    }
-    free(prog->decls);
-    free(prog);
-}
 
 void purge_parser(Parser *prs) {
     if (prs) {
-        // TODO: Free any parser-specific resources
+        purge_arena(&prs->arena);
+        free(prs->scratch.items);
         free(prs);
     }
 }
@@ -714,16 +860,11 @@ static void print_node(Node *node, int indent);
 static void print_indent(int indent);
 static void print_program(Program *prog, int indent);
 static void print_decl(Decl *decl, int indent);
-static void print_type(Type *type, int indent);
+static void print_type(const Type *type, int indent);
 static void print_block(Block *block, int indent);
 static void print_stmt(Stmt *stmt, int indent);
 static void print_expr(Expr *expr, int indent);
 
-static const char *typekind_str(TypeKind kind);
-static const char *stmttype_str(StmtType type);
-static const char *binop_str(BinOp op);
-static const char *unop_str(UnOp op);
-static const char *consttype_str(ConstType type);
 
 void print_ast(Node *node) {
     print_node(node, 0);
@@ -759,7 +900,7 @@ static void print_program(Program *prog, int indent) {
 
 static void print_decl(Decl *decl, int indent) {
     print_indent(indent);
-    printf("Declaration: %s\n", decl->name ? decl->name : "(anonymous)");
+    printf("Declaration: %s\n", decl->name ? decl->name->str : "(anonymous)");
 
     // Print expr_type information with null check
     print_indent(indent + 1);
@@ -779,7 +920,7 @@ static void print_decl(Decl *decl, int indent) {
     }
 
     // Print parameters with expr_type validation
-    if (decl->func.param_count > 0) {
+    if (decl->type && decl->type->type_kind == TY_FUNC && decl->func.param_count > 0) {
         print_indent(indent + 1);
         printf("Parameters (%u):\n", decl->func.param_count);
         for (unsigned i = 0; i < decl->func.param_count; i++) {
@@ -793,14 +934,14 @@ static void print_decl(Decl *decl, int indent) {
     }
 
     // Print function body if exists
-    if (decl->func.body) {
+    if (decl->type && decl->type->type_kind == TY_FUNC && decl->func.body) {
         print_indent(indent + 1);
         printf("Body:\n");
         print_block(decl->func.body, indent + 2);
     }
 }
 
-static void print_type(Type *type, int indent) {
+static void print_type(const Type *type, int indent) {
     print_indent(indent);
     if (!type) {
         printf("NULL TYPE\n");
@@ -872,7 +1013,7 @@ static void print_expr(Expr *expr, int indent) {
         }
         break;
 
-    case EXPR_VAR: printf("Variable: %s\n", expr->variable.name); break;
+    case EXPR_VAR: printf("Variable: %s\n", expr->variable.name->str); break;
 
     case EXPR_UNARY:
         printf("Unary %s:\n", unop_str(expr->unary.op));
@@ -899,7 +1040,7 @@ static void print_expr(Expr *expr, int indent) {
     }
 }
 
-static const char *typekind_str(TypeKind kind) {
+const char *typekind_str(TypeKind kind) {
     switch (kind) {
     case TY_VOID:   return "void";
     case TY_INT:    return "int";
@@ -912,7 +1053,7 @@ static const char *typekind_str(TypeKind kind) {
     }
 }
 
-static const char *stmttype_str(StmtType expr_type) {
+const char *stmttype_str(StmtType expr_type) {
     switch (expr_type) {
     case STMT_COMPOUND: return "compound";
     case STMT_RETURN:   return "return";
@@ -921,7 +1062,7 @@ static const char *stmttype_str(StmtType expr_type) {
     }
 }
 
-static const char *binop_str(BinOp op) {
+const char *binop_str(BinOp op) {
     switch (op) {
     case BOP_ADD:  return "+";
     case BOP_SUB:  return "-";
@@ -940,7 +1081,7 @@ static const char *binop_str(BinOp op) {
     }
 }
 
-static const char *unop_str(UnOp op) {
+const char *unop_str(UnOp op) {
     switch (op) {
     case UOP_NEG:   return "-";
     case UOP_NOT:   return "!";
@@ -950,7 +1091,7 @@ static const char *unop_str(UnOp op) {
     }
 }
 
-static const char *consttype_str(ConstType type) {
+const char *consttype_str(ConstType type) {
     switch (type) {
     case CONST_INT:   return "int";
     case CONST_FLOAT: return "float";
@@ -2,11 +2,14 @@
 #define _PARSER_H
 
 #include "lexer.h"
+#include "intern.h"
+#include "arena.h"
+#include "types.h"
+#include <setjmp.h>
 #include <stdlib.h>
 
 /* -------------------- Pre declaration -------------------- */
 typedef struct Node Node;
-typedef struct Type Type;
 typedef struct Decl Decl;
 typedef struct Stmt Stmt;
 typedef struct Expr Expr;
@@ -27,32 +30,7 @@ typedef enum {
 
 struct Node {
     NodeType node_type;
-};
-
-/* -------------------- Type System -------------------- */
-typedef enum {
-    TY_VOID,
-    TY_INT,
-    TY_FLOAT,
-    TY_CHAR,
-    TY_STRING,
-    TY_PTR,
-    TY_FUNC,
-} TypeKind;
-
-struct Type {
-    Node base;
-    TypeKind type_kind;
-    union {
-        struct { // TY_PTR
-            Type *ref;
-        } ptr;
-        struct { // TY_FUNC
-            Type *ret;
-            Type **params;
-            unsigned param_count;
-        } func;
-    };
+    int line; // Source line the node starts on
 };
 
 /* -------------------- Declarations -------------------- */
@@ -66,10 +44,10 @@ typedef enum {
 
 // Declarator node
 struct Decl {
-    Node base;      // Base node
-    char *name;     // Declaration name/identifier
-    Type *type;     // Declaration type
-    StgClass class; // Storage class
+    Node base;        // Base node
+    const Atom *name; // Declaration name/identifier
+    const Type *type; // Declaration type
+    StgClass class;   // Storage class
     union {
         struct { // Function declaration
             Decl **params;
@@ -179,7 +157,7 @@ struct Expr {
             };
         } constant;
         struct { // Variable
-            char *name;
+            const Atom *name;
         } variable;
         struct { // Unary
             UnOp op;
@@ -205,7 +183,7 @@ struct Expr {
             Expr *right;
         } conditional;
         struct { // Cast
-            Type *type;
+            const Type *type;
             Expr *expr;
         } cast;
     };
@@ -226,28 +204,82 @@ struct Program {
 };
 
 /* -------------------- Parser State -------------------- */
+
+// Stack the children of nodes under construction are collected on. Nested
+// nodes push above their parent's children and pop before the parent resumes.
+typedef struct {
+    void **items;      // Child pointers
+    unsigned count;    // Pushed children
+    unsigned capacity; // Allocated length of `items`
+} Scratch;
+
 struct Parser {
-    const TokList *list; // Token list
-    int pos;             // Current position
-    Token *token;        // Current token
+    CompilerContext *ctx;          // Receives syntax errors, parsing stops once it's list is full
+    TokList *list;                 // Token list or stream
+    int pos;                       // Current position, index of the last consumed token
+    Arena arena;                   // Storage of every AST node and array, owned by the parser
+    Scratch scratch;               // Children of the nodes being built, reused across nodes
+    unsigned nodes[NODE_TYPE + 1]; // Nodes allocated per `NodeType`
+    unsigned errors;               // Syntax errors reported so far
+    bool panic;                    // Recovering from an error, further errors are suppressed
+    jmp_buf fail;                  // Where running out of memory abandons the parse
 };
 
+// AST allocation statistics
+typedef struct {
+    size_t used;                   // Bytes allocated for the AST, including alignment padding
+    size_t reserved;               // Bytes reserved by the arena
+    unsigned nodes[NODE_TYPE + 1]; // Nodes allocated per `NodeType`, types are the context's
+} ParseStats;
+
 struct DeclInfo {
-    char *name;
-    Type *type;
+    const Atom *name;
+    const Type *type;
     struct { // For function parameters
-        char **names;
-        Type **types;
+        const Atom **names;
+        const Type **types;
         unsigned count;
     } params;
 };
 
-// Parser interface
-Parser *make_parser(const TokList *list);
+/**
+ * @brief Creates a parser over a token list or stream.
+ * @param ctx
+ * @param list
+ * @return NULL if memory ran out.
+ */
+Parser *make_parser(CompilerContext *ctx, TokList *list);
+
+/**
+ * @brief Frees the parser together with every AST it produced.
+ * @param prs
+ */
 void purge_parser(Parser *prs);
 
+/**
+ * @brief Parses the whole token list. Syntax errors do not stop the parse, they
+ * are reported to the parser's context and it resumes at the next statement or
+ * declaration.
+ * @param parser
+ * @return NULL if there were syntax errors or memory ran out, `ctx->err` tells
+ * which.
+ */
 Program *parse_program(Parser *parser);
 
+/**
+ * @brief Reports AST allocation statistics, for tuning the arena.
+ * @param prs
+ * @return
+ */
+ParseStats parse_stats(const Parser *prs);
+
 void print_ast(Node *node);
 
+// Display names of AST enumerators, shared by the AST printers
+const char *typekind_str(TypeKind kind);
+const char *stmttype_str(StmtType type);
+const char *binop_str(BinOp op);
+const char *unop_str(UnOp op);
+const char *consttype_str(ConstType type);
+
 #endif
@@ -1,36 +1,28 @@
 #include <stdlib.h>
 #include <string.h>
-#include <stdio.h>
 
-#include "utils.h"
+#include "memstat.h"
 #include "symbol.h"
 
-#define INITIAL_SIZE 64 // Initial size
+#define INITIAL_SIZE 64 // Initial size, a power of two
+#define MAX_LOAD_NUM 3  // Largest share of occupied slots, the table grows past it
+#define MAX_LOAD_DEN 4
+#define MIGRATE_STEP 8  // Old slots moved per insertion while growing, at least
+
+// Spelling of every builtin type
+static const char *builtin_names[BT_COUNT] = {
+    [BT_INT]    = "int",
+    [BT_FLOAT]  = "float",
+    [BT_CHAR]   = "char",
+    [BT_STRING] = "string",
+    [BT_VOID]   = "void",
+    [BT_BOOL]   = "bool",
+};
 
 /*********************************************
  * Utility Functions
  *********************************************/
 
-/**
- * @brief Generates a unique name based on the given name and scope.
- *
- * Allocates a new string in the format "name.scope".
- *
- * @param name The base name.
- * @param scope The scope level.
- * @return Pointer to the unique name. Must be freed by the caller.
- */
-char *sym_uname(char *name, int scope) {
-    char *uname = malloc(32);
-    if (!uname) {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(1);
-    }
-
-    snprintf(uname, 32, "%s.%d", name, scope);
-    return uname;
-}
-
 /**
  * @brief Sets the given flags.
  * @param symbol
@@ -74,50 +66,230 @@ bool hasaction(Symbol *symbol, unsigned action) {
  *********************************************/
 
 /**
- * @brief Creates a symbol table.
- * @return Pointer to the new symbol table.
+ * @brief Distance of a slot from the one its name hashes to.
+ * @param slots
+ * @param size Number of slots, a power of two.
+ * @param index Index of an occupied slot.
+ * @return
  */
-SymTab *make_symtab() {
-    SymTab *table = malloc(sizeof(SymTab));
-    if (!table) errexit("memory allocation error");
+static unsigned probe_dist(const SymSlot *slots, unsigned size, unsigned index) {
+    return (index - (slots[index].hash & (size - 1))) & (size - 1);
+}
 
-    table->size  = INITIAL_SIZE;
-    table->count = 0;
-    table->scope = 0;
+/**
+ * @brief Places a slot, displacing slots closer to their home than it is
+ * (Robin Hood). There must be an empty slot.
+ * @param slots
+ * @param size Number of slots, a power of two.
+ * @param slot
+ */
+static void place_slot(SymSlot *slots, unsigned size, SymSlot slot) {
+    unsigned mask  = size - 1;
+    unsigned index = slot.hash & mask;
+
+    for (unsigned dist = 0;; dist++, index = (index + 1) & mask) {
+        SymSlot *cur = &slots[index];
+        if (!cur->name) {
+            *cur = slot;
+            return;
+        }
 
-    table->buckets = calloc(table->size, sizeof(SymNode *));
-    if (!table->buckets) errexit("memory allocation error");
+        unsigned cur_dist = probe_dist(slots, size, index);
+        if (cur_dist < dist) {
+            SymSlot rich = *cur;
+            *cur         = slot;
+            slot         = rich;
+            dist         = cur_dist;
+        }
+    }
+}
 
-    return table;
+/**
+ * @brief Probes for the slot of a name.
+ * @param slots
+ * @param size Number of slots, a power of two.
+ * @param name
+ * @return NULL if the name is not in the slots.
+ */
+static SymSlot *probe(SymSlot *slots, unsigned size, const Atom *name) {
+    unsigned mask  = size - 1;
+    unsigned index = name->hash & mask;
+
+    // Robin Hood order ends the probe at the first slot closer to its home
+    for (unsigned dist = 0;; dist++, index = (index + 1) & mask) {
+        SymSlot *slot = &slots[index];
+        if (!slot->name || probe_dist(slots, size, index) < dist) return NULL;
+        if (slot->name == name) return slot;
+    }
 }
 
 /**
- * @brief Resizes the symbol table when load factor is exceeded.
+ * @brief Empties a slot. The slots after it are shifted back into the hole,
+ * so no tombstone is left behind.
+ * @param slots
+ * @param size Number of slots, a power of two.
+ * @param index
  */
-void resize_symtab(SymTab *table) {
-    unsigned new_size = table->size * 2; // Double size
+static void shift_back(SymSlot *slots, unsigned size, unsigned index) {
+    unsigned mask = size - 1;
 
-    SymNode **new_buckets = calloc(new_size, sizeof(SymNode *));
-    if (!new_buckets) errexit("memory allocation error");
+    for (;;) {
+        unsigned next = (index + 1) & mask;
+        if (!slots[next].name || probe_dist(slots, size, next) == 0) break;
 
-    for (unsigned i = 0; i < table->size; i++) {
-        SymNode *node = table->buckets[i];
+        slots[index] = slots[next];
+        index        = next;
+    }
+    slots[index] = (SymSlot){0};
+}
 
-        while (node != NULL) {
-            SymNode *next = node->next;
+/**
+ * @brief Frees a symbol with its parameter list.
+ * @param symbol
+ */
+static void purge_symbol(Symbol *symbol) {
+    free(symbol->params);
+    free(symbol);
+}
 
-            // Rehash and insert into new buckets
-            unsigned new_index     = hashfnv(node->symbol->name, new_size);
-            node->next             = new_buckets[new_index];
-            new_buckets[new_index] = node;
+/**
+ * @brief Frees every symbol of some slots, shadowed ones included.
+ * @param slots
+ * @param size
+ */
+static void purge_slots(SymSlot *slots, unsigned size) {
+    for (unsigned i = 0; i < size; i++) {
+        Symbol *symbol = slots[i].name ? slots[i].symbol : NULL;
+        while (symbol) {
+            Symbol *shadow = symbol->shadow;
+            purge_symbol(symbol);
+            symbol = shadow;
+        }
+    }
+    free(slots);
+}
+
+/**
+ * @brief Finds the slot of a name, among the old slots too while growing.
+ * @param table
+ * @param name
+ * @return NULL if the name is not in the table.
+ */
+static SymSlot *find_slot(const SymTab *table, const Atom *name) {
+    SymSlot *slot = probe(table->slots, table->size, name);
+    if (!slot && table->old) slot = probe(table->old, table->old_size, name);
+    return slot;
+}
 
-            node = next;
+/**
+ * @brief Removes the slot of a name.
+ * @param table
+ * @param slot
+ */
+static void remove_slot(SymTab *table, SymSlot *slot) {
+    if (slot >= table->slots && slot < table->slots + table->size) {
+        shift_back(table->slots, table->size, slot - table->slots);
+    } else {
+        shift_back(table->old, table->old_size, slot - table->old);
+    }
+    table->count--;
+}
+
+/**
+ * @brief Removes the innermost symbol of its name and frees it, the symbol it
+ * shadowed becomes visible again.
+ * @param table
+ * @param symbol Innermost symbol of its name.
+ */
+static void pop_symbol(SymTab *table, Symbol *symbol) {
+    SymSlot *slot = find_slot(table, symbol->name);
+    if (symbol->shadow) {
+        slot->symbol = symbol->shadow;
+    } else {
+        remove_slot(table, slot);
+    }
+    purge_symbol(symbol);
+}
+
+/**
+ * @brief Moves at least `budget` old slots into the current ones, stopping
+ * only where a cluster ends. Clusters move as a whole, so names left behind
+ * keep their probe sequence and can still be found.
+ * @param table
+ * @param budget
+ */
+static void migrate(SymTab *table, unsigned budget) {
+    unsigned mask = table->old_size - 1;
+
+    while (table->left) {
+        SymSlot *slot = &table->old[table->cursor];
+        if (slot->name) {
+            place_slot(table->slots, table->size, *slot);
+            *slot = (SymSlot){0};
         }
+        table->cursor = (table->cursor + 1) & mask;
+        table->left--;
+
+        if (budget) budget--;
+
+        // The next slot starts a cluster if it is empty or at its home
+        bool boundary = !table->old[table->cursor].name ||
+                        probe_dist(table->old, table->old_size, table->cursor) == 0;
+        if (!budget && boundary) break;
+    }
+
+    if (!table->left) {
+        free(table->old);
+        table->old = NULL;
+    }
+}
+
+/**
+ * @brief Creates a symbol table.
+ * @param ctx Context the builtin names are interned in.
+ * @return Pointer to the new symbol table, NULL if memory ran out.
+ */
+SymTab *make_symtab(CompilerContext *ctx) {
+    SymTab *table = mem_calloc(1, sizeof(SymTab));
+    if (!table) return NULL;
+
+    table->ctx  = ctx;
+    table->size = INITIAL_SIZE;
+
+    table->slots = mem_calloc(table->size, sizeof(SymSlot));
+    if (!table->slots) {
+        free(table);
+        return NULL;
     }
 
-    free(table->buckets);
-    table->buckets = new_buckets;
-    table->size    = new_size;
+    return table;
+}
+
+/**
+ * @brief Doubles the number of slots. The current slots become the old ones,
+ * moved over a few at a time by later insertions. An unfinished earlier
+ * move is completed first.
+ * @return false if memory ran out, the table is unchanged then.
+ */
+bool resize_symtab(SymTab *table) {
+    SymSlot *slots = mem_calloc(table->size * 2, sizeof(SymSlot));
+    if (!slots) return false;
+
+    if (table->old) migrate(table, table->left);
+
+    table->old      = table->slots;
+    table->old_size = table->size;
+    table->left     = table->size;
+    table->slots    = slots;
+    table->size     = table->size * 2;
+
+    // Start where a cluster starts, there is always an empty slot
+    table->cursor = 0;
+    while (table->old[table->cursor].name &&
+           probe_dist(table->old, table->old_size, table->cursor) != 0) {
+        table->cursor++;
+    }
+    return true;
 }
 
 /**
@@ -128,17 +300,15 @@ void resize_symtab(SymTab *table) {
  * @param modspec Symbol flags (modifiers, access, etc.).
  * @param scope Scope level.
  * @param type Pointer to the type symbol
- * @return Pointer to the created symbol.
+ * @return Pointer to the created symbol, NULL if memory ran out.
  */
 Symbol *make_symbol(
-    const char *name, SymGrp group, SymAct action, unsigned modspec, int scope, Symbol *type
+    const Atom *name, SymGrp group, SymAct action, unsigned modspec, int scope, Symbol *type
 ) {
-    Symbol *symbol = malloc(sizeof(Symbol));
-    if (!symbol) errexit("memory allocation error");
-
-    symbol->name = strdup(name); // Copy name
-    if (!symbol->name) errexit("strdup failed");
+    Symbol *symbol = mem_calloc(1, sizeof(Symbol));
+    if (!symbol) return NULL;
 
+    symbol->name    = name;
     symbol->group   = group;
     symbol->action  = action;
     symbol->modspec = modspec;
@@ -149,23 +319,42 @@ Symbol *make_symbol(
 }
 
 /**
- * @brief Adds a symbol to the symbol table.
+ * @brief Adds a symbol to the symbol table, which takes ownership of it. It
+ * shadows the symbol of the same name, if any, until its scope exits.
  * @param table Symbol table.
  * @param symbol Symbol to add.
+ * @return false if memory ran out, the symbol is not added then.
  */
-void add_symbol(SymTab *table, Symbol *symbol) {
-    if (table->count >= INITIAL_SIZE) {
-        resize_symtab(table);
+bool add_symbol(SymTab *table, Symbol *symbol) {
+    SymSlot *slot = find_slot(table, symbol->name);
+    if (!slot && (table->count + 1) * MAX_LOAD_DEN > table->size * MAX_LOAD_NUM &&
+        !resize_symtab(table)) {
+        return false;
     }
+    if (!slot && table->old) migrate(table, MIGRATE_STEP);
 
-    unsigned index = hashfnv(symbol->name, table->size);
-    SymNode *snode = malloc(sizeof(SymNode));
-    if (!snode) errexit("memory allocation error");
+    if (symbol->scope > 0) {
+        if (table->logged == table->log_cap) {
+            unsigned capacity = table->log_cap ? table->log_cap * 2 : INITIAL_SIZE;
+            Symbol **log      = mem_realloc(table->log, capacity * sizeof(Symbol *));
+            if (!log) return false;
 
-    snode->symbol         = symbol;
-    snode->next           = table->buckets[index];
-    table->buckets[index] = snode;
+            table->log     = log;
+            table->log_cap = capacity;
+        }
+        table->log[table->logged++] = symbol;
+    }
+
+    if (slot) {
+        symbol->shadow = slot->symbol;
+        slot->symbol   = symbol;
+        return true;
+    }
+
+    SymSlot new_slot = {.name = symbol->name, .hash = symbol->name->hash, .symbol = symbol};
+    place_slot(table->slots, table->size, new_slot);
     table->count++;
+    return true;
 }
 
 /**
@@ -173,57 +362,103 @@ void add_symbol(SymTab *table, Symbol *symbol) {
  * @param table Symbol table.
  * @param name Name of the symbol.
  * @param scope Current scope.
- * @return Pointer to the found symbol, or NULL if not found.
- */
-Symbol *search_symbol(SymTab *table, const char *name, int scope) {
-    for (int scp = scope; scp >= 0; scp--) {
-        unsigned index = hashfnv(name, table->size);
-        SymNode *node  = table->buckets[index];
-        while (node) {
-            if (strcmp(node->symbol->name, name) == 0 && node->symbol->scope == scp) {
-                return node->symbol;
-            }
-            node = node->next;
-        }
-    }
-    return NULL;
+ * @return Pointer to the symbol of the innermost scope up to `scope`, or NULL
+ * if not found.
+ */
+Symbol *search_symbol(SymTab *table, const Atom *name, int scope) {
+    SymSlot *slot  = find_slot(table, name);
+    Symbol *symbol = slot ? slot->symbol : NULL;
+
+    while (symbol && symbol->scope > scope) symbol = symbol->shadow;
+    return symbol;
 }
 
 /**
- * @brief Initialize symbol table.
+ * @brief Searches for a symbol declared in the current scope.
+ * @param table Symbol table.
+ * @param name Name of the symbol.
+ * @return NULL if the name is not declared in the current scope.
+ */
+Symbol *search_scope(SymTab *table, const Atom *name) {
+    SymSlot *slot = find_slot(table, name);
+    return slot && slot->symbol->scope == (int)table->scope ? slot->symbol : NULL;
+}
+
+/**
+ * @brief Enters a new scope.
  * @param table
  */
-void init_symtab(SymTab *table) {
-    Symbol *intsym = make_symbol("int", SG_TYPE, SA_DEC, 0, 0, NULL);
-    add_symbol(table, intsym);
-    intsym->type = intsym;
+void scope_enter(SymTab *table) {
+    table->scope++;
+}
 
-    Symbol *fltsym = make_symbol("float", SG_TYPE, SA_DEC, 0, 0, NULL);
-    add_symbol(table, fltsym);
-    fltsym->type = fltsym;
+/**
+ * @brief Exits the current scope. The undo log removes every symbol added to
+ * it, newest first, uncovering the symbols they shadowed.
+ * @param table
+ */
+void scope_exit(SymTab *table) {
+    while (table->logged && table->log[table->logged - 1]->scope >= (int)table->scope) {
+        pop_symbol(table, table->log[--table->logged]);
+    }
+    table->scope--;
+}
 
-    Symbol *charsym = make_symbol("char", SG_TYPE, SA_DEC, 0, 0, NULL);
-    add_symbol(table, charsym);
-    charsym->type = charsym;
+/**
+ * @brief Adds a builtin type, which is it's own type.
+ * @param table
+ * @param kind
+ * @return NULL if memory ran out.
+ */
+static Symbol *add_builtin(SymTab *table, Builtin kind) {
+    const Atom *atom = intern_cstr(&table->ctx->interner, builtin_names[kind]);
+    if (!atom) return NULL;
 
-    Symbol *strsym = make_symbol("string", SG_TYPE, SA_DEC, 0, 0, NULL);
-    add_symbol(table, strsym);
-    strsym->type = strsym;
+    Symbol *sym = make_symbol(atom, SG_TYPE, SA_DEC, 0, 0, NULL);
+    if (!sym) return NULL;
 
-    Symbol *voidsym = make_symbol("void", SG_TYPE, SA_DEC, 0, 0, NULL);
-    add_symbol(table, voidsym);
-    voidsym->type = voidsym;
+    if (!add_symbol(table, sym)) {
+        free(sym);
+        return NULL;
+    }
+    sym->type    = sym;
+    sym->builtin = kind;
+    return sym;
+}
 
-    Symbol *boolsym = make_symbol("bool", SG_TYPE, SA_DEC, 0, 0, NULL);
-    add_symbol(table, boolsym);
-    boolsym->type = boolsym;
+/**
+ * @brief Initialize symbol table.
+ * @param table
+ * @param builtins Receives the builtin type symbols by kind, NULL if not needed.
+ * @return false if memory ran out.
+ */
+bool init_symtab(SymTab *table, Symbol *builtins[BT_COUNT]) {
+    Symbol *types[BT_COUNT] = {NULL};
+    for (Builtin kind = BT_NONE + 1; kind < BT_COUNT; kind++) {
+        types[kind] = add_builtin(table, kind);
+        if (!types[kind]) return false;
+    }
+    if (builtins) memcpy(builtins, types, sizeof(types));
+
+    Symbol *intsym = types[BT_INT];
+    Symbol *strsym = types[BT_STRING];
 
     // Define c 'printf' with one 'char*' parameter
-    Symbol *cprintf    = make_symbol("printf", SG_FUNC, SA_DEC, 0, 0, intsym);
-    cprintf->params    = malloc(sizeof(Symbol *)); // Allocate for 1 parameter
-    cprintf->params[0] = strsym;                   // First param is 'char*'
-    cprintf->pcount    = 1;                        // One parameter
-    add_symbol(table, cprintf);
+    const Atom *name = intern_cstr(&table->ctx->interner, "printf");
+    if (!name) return false;
+
+    Symbol *cprintf = make_symbol(name, SG_FUNC, SA_DEC, 0, 0, intsym);
+    if (!cprintf) return false;
+
+    cprintf->params = mem_malloc(sizeof(Symbol *)); // Allocate for 1 parameter
+    if (!cprintf->params || !add_symbol(table, cprintf)) {
+        free(cprintf->params);
+        free(cprintf);
+        return false;
+    }
+    cprintf->params[0] = strsym; // First param is 'char*'
+    cprintf->pcount    = 1;      // One parameter
+    return true;
 }
 
 /*********************************************
@@ -237,18 +472,8 @@ void init_symtab(SymTab *table) {
 void purge_symtab(SymTab *table) {
     if (!table) return;
 
-    for (unsigned i = 0; i < table->size; i++) {
-        SymNode *node = table->buckets[i];
-
-        while (node != NULL) {
-            SymNode *temp = node;
-            node          = node->next;
-
-            free(temp->symbol->name); // Free symbol name
-            free(temp->symbol);       // Free symbol itself
-            free(temp);               // Free node
-        }
-    }
-    free(table->buckets);
+    purge_slots(table->slots, table->size);
+    if (table->old) purge_slots(table->old, table->old_size);
+    free(table->log);
     free(table);
 }
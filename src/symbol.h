@@ -2,6 +2,7 @@
 #define _SYMBOL_H
 
 #include "lexer.h"
+#include "intern.h"
 
 // Symbol group (e.g., SG_TYPE, SG_VAR)
 typedef enum {
@@ -16,6 +17,18 @@ typedef enum {
     SG_POINTER,
 } SymGrp;
 
+// Builtin type a type symbol stands for
+typedef enum {
+    BT_NONE, // Not a builtin type
+    BT_INT,
+    BT_FLOAT,
+    BT_CHAR,
+    BT_STRING,
+    BT_VOID,
+    BT_BOOL,
+    BT_COUNT, // Number of builtin types
+} Builtin;
+
 // Symbol action
 typedef enum {
     SA_DEC = 1 << 0, // Declaration
@@ -34,7 +47,7 @@ typedef enum {
 } SymMsp;
 
 typedef struct Symbol {
-    char *name;             // Symbol name (string)
+    const Atom *name;       // Symbol name (interned)
     SymGrp group;           // Symbol group
     SymAct action;          // Symbol action flags
     unsigned modspec;       // Modifier/specifier flags
@@ -42,19 +55,39 @@ typedef struct Symbol {
     struct Symbol *type;    // Type of the symbol (e.g., "int", "float")
     struct Symbol **params; // Array of parameter types (for functions)
     int pcount;             // Number of parameters (for functions)
+    struct Symbol *shadow;  // Symbol of the same name in an outer scope, hidden by this one
+    unsigned order;         // Top level declaration that added the symbol, 0 for builtins
+    Builtin builtin;        // Builtin type the symbol stands for, `BT_NONE` for other symbols
 } Symbol;
 
-typedef struct SymNode {
-    Symbol *symbol;       // Symbol data
-    struct SymNode *next; // Next symbol in the bucket
-} SymNode;
-
-// Symbol table
+// Slot of the symbol table, one per name. The name and its hash are kept
+// inline, so probing compares them without touching the symbol.
+typedef struct {
+    const Atom *name; // Interned name, NULL for an empty slot
+    unsigned hash;    // Hash of the name, gives the slot the probe starts at
+    Symbol *symbol;   // Innermost symbol of the name, the outer ones follow `shadow`
+} SymSlot;
+
+// Scoped symbol table, open addressed with Robin Hood probing. A declaration
+// in an inner scope shadows the name's symbol, leaving it on the `shadow`
+// chain, and the scope's undo log restores it when the scope exits.
+//
+// Growing is incremental. The slots of the previous size stay in `old` and
+// every insertion moves a few of them over, so no insertion rehashes the
+// whole table. Until they are all moved, names are searched in both.
 typedef struct SymTab {
-    SymNode **buckets; // Array of buckets
-    unsigned size;     // Number of buckets
-    unsigned count;    // Number of symbols in table
-    unsigned scope;    // Current scope
+    CompilerContext *ctx; // Context symbol names are interned in
+    SymSlot *slots;       // Slots, `size` of them
+    unsigned size;        // Number of slots, a power of two
+    unsigned count;       // Number of names in the table
+    SymSlot *old;         // Slots still to be moved into `slots`, NULL when there are none
+    unsigned old_size;    // Number of slots in `old`
+    unsigned cursor;      // Next slot of `old` to move
+    unsigned left;        // Slots of `old` not visited yet
+    unsigned scope;       // Current scope
+    Symbol **log;         // Undo log, symbols of inner scopes in the order they were added
+    unsigned logged;      // Symbols in `log`
+    unsigned log_cap;     // Capacity of `log`
 } SymTab;
 
 // Semantic error
@@ -71,19 +104,21 @@ void setaction(Symbol *symbol, unsigned action);
 bool hasmodspec(Symbol *symbol, unsigned check);
 bool hasaction(Symbol *symbol, unsigned action);
 
-SymTab *make_symtab();
+SymTab *make_symtab(CompilerContext *ctx);
 
-void init_symtab(SymTab *table);
+bool init_symtab(SymTab *table, Symbol *builtins[BT_COUNT]);
 void purge_symtab(SymTab *table);
-void resize_symtab(SymTab *table);
-
-char *sym_uname(char *name, int scope);
+bool resize_symtab(SymTab *table);
 
 Symbol *make_symbol(
-    const char *name, SymGrp group, SymAct action, unsigned modspec, int scope, Symbol *type
+    const Atom *name, SymGrp group, SymAct action, unsigned modspec, int scope, Symbol *type
 );
 
-void add_symbol(SymTab *table, Symbol *symbol);
-Symbol *search_symbol(SymTab *table, const char *name, int scope);
+bool add_symbol(SymTab *table, Symbol *symbol);
+Symbol *search_symbol(SymTab *table, const Atom *name, int scope);
+Symbol *search_scope(SymTab *table, const Atom *name);
+
+void scope_enter(SymTab *table);
+void scope_exit(SymTab *table);
 
 #endif
@@ -0,0 +1,205 @@
+#include <sys/resource.h>
+#include <time.h>
+
+#include "timing.h"
+
+static const char *phase_names[PHASE_COUNT] = {
+    [PHASE_LOAD]    = "load",
+    [PHASE_SCAN]    = "scan",
+    [PHASE_PARSE]   = "parse",
+    [PHASE_FLATTEN] = "flatten",
+    [PHASE_RESOLVE] = "resolve",
+    [PHASE_LOWER]   = "lower",
+    [PHASE_FOLD]    = "fold",
+};
+
+static const char *phase_units[PHASE_COUNT] = {
+    [PHASE_LOAD]    = "bytes",
+    [PHASE_SCAN]    = "tokens",
+    [PHASE_PARSE]   = "nodes",
+    [PHASE_FLATTEN] = "nodes",
+    [PHASE_RESOLVE] = "nodes",
+    [PHASE_LOWER]   = "nodes",
+    [PHASE_FOLD]    = "insts",
+};
+
+/**
+ * @brief Reads a clock in milliseconds.
+ * @param id
+ * @return
+ */
+static double clock_ms(clockid_t id) {
+    struct timespec ts;
+    clock_gettime(id, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+/**
+ * @brief Peak resident set of the process so far.
+ * @return KiB
+ */
+static long peak_rss() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024; // Reported in bytes
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+// CPU time absorbed from joined threads
+static _Thread_local double absorbed;
+
+double thread_cpu() {
+    return clock_ms(CLOCK_THREAD_CPUTIME_ID) + absorbed;
+}
+
+void absorb_cpu(double ms) {
+    absorbed += ms;
+}
+
+void start_phase(TimeReport *rep, Phase phase) {
+    rep->current = phase;
+    rep->mem     = mem_stats();
+    rep->cpu     = thread_cpu();
+    rep->wall    = clock_ms(CLOCK_MONOTONIC);
+}
+
+void end_phase(TimeReport *rep, size_t items) {
+    double wall  = clock_ms(CLOCK_MONOTONIC);
+    double cpu   = thread_cpu();
+    MemStats mem = mem_stats();
+
+    PhaseTime *pt = &rep->phases[rep->current];
+    long rss      = peak_rss();
+
+    pt->runs++;
+    pt->wall   += wall - rep->wall;
+    pt->cpu    += cpu - rep->cpu;
+    pt->allocs += mem.allocs - rep->mem.allocs;
+    pt->bytes  += mem.bytes - rep->mem.bytes;
+    pt->items  += items;
+    if (rss > pt->peak_rss) pt->peak_rss = rss;
+}
+
+void prune_items(TimeReport *rep, Phase phase, size_t items) {
+    rep->phases[phase].pruned += items;
+}
+
+void merge_report(TimeReport *into, const TimeReport *from) {
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        PhaseTime *dst       = &into->phases[i];
+        const PhaseTime *src = &from->phases[i];
+
+        dst->runs   += src->runs;
+        dst->wall   += src->wall;
+        dst->cpu    += src->cpu;
+        dst->allocs += src->allocs;
+        dst->bytes  += src->bytes;
+        dst->items  += src->items;
+        dst->pruned += src->pruned;
+        if (src->peak_rss > dst->peak_rss) dst->peak_rss = src->peak_rss;
+    }
+}
+
+const char *phase_str(Phase phase) {
+    return phase < PHASE_COUNT ? phase_names[phase] : "unknown";
+}
+
+const char *phase_unit(Phase phase) {
+    return phase < PHASE_COUNT ? phase_units[phase] : "items";
+}
+
+/**
+ * @brief Sums every phase that ran, items are left out as their units differ.
+ * @param rep
+ * @return
+ */
+static PhaseTime total_time(const TimeReport *rep) {
+    PhaseTime total = {0};
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        const PhaseTime *pt = &rep->phases[i];
+
+        total.runs   += pt->runs;
+        total.wall   += pt->wall;
+        total.cpu    += pt->cpu;
+        total.allocs += pt->allocs;
+        total.bytes  += pt->bytes;
+        if (pt->peak_rss > total.peak_rss) total.peak_rss = pt->peak_rss;
+    }
+    return total;
+}
+
+/**
+ * @brief Items processed per second of wall clock time.
+ * @param pt
+ * @return 0 if the phase took no measurable time.
+ */
+static double item_rate(const PhaseTime *pt) {
+    return pt->wall > 0 ? pt->items / (pt->wall / 1e3) : 0;
+}
+
+void print_report(const TimeReport *rep, FILE *out) {
+    fprintf(
+        out, "%-10s %6s %11s %11s %11s %10s %12s %14s\n", "phase", "runs", "wall ms", "cpu ms",
+        "peak KiB", "allocs", "alloc KiB", "rate"
+    );
+
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        const PhaseTime *pt = &rep->phases[i];
+        if (!pt->runs) continue;
+
+        fprintf(
+            out, "%-10s %6u %11.3f %11.3f %11ld %10zu %12.1f %14.0f %s/s", phase_str(i),
+            pt->runs, pt->wall, pt->cpu, pt->peak_rss, pt->allocs, pt->bytes / 1024.0,
+            item_rate(pt), phase_unit(i)
+        );
+        if (pt->pruned) fprintf(out, ", %zu %s removed", pt->pruned, phase_unit(i));
+        fputc('\n', out);
+    }
+
+    PhaseTime total = total_time(rep);
+    fprintf(
+        out, "%-10s %6u %11.3f %11.3f %11ld %10zu %12.1f\n", "total", total.runs, total.wall,
+        total.cpu, total.peak_rss, total.allocs, total.bytes / 1024.0
+    );
+}
+
+/**
+ * @brief Prints the fields shared by phase and total objects.
+ * @param pt
+ * @param out
+ */
+static void print_fields_json(const PhaseTime *pt, FILE *out) {
+    fprintf(
+        out,
+        "\"runs\": %u, \"wall_ms\": %.3f, \"cpu_ms\": %.3f, \"peak_rss_kib\": %ld, "
+        "\"allocs\": %zu, \"alloc_bytes\": %zu",
+        pt->runs, pt->wall, pt->cpu, pt->peak_rss, pt->allocs, pt->bytes
+    );
+}
+
+void print_report_json(const TimeReport *rep, FILE *out) {
+    fprintf(out, "{\n  \"phases\": [");
+
+    const char *sep = "\n";
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        const PhaseTime *pt = &rep->phases[i];
+        if (!pt->runs) continue;
+
+        fprintf(out, "%s    {\"phase\": \"%s\", ", sep, phase_str(i));
+        print_fields_json(pt, out);
+        fprintf(
+            out, ", \"items\": %zu, \"unit\": \"%s\", \"per_sec\": %.0f, \"removed\": %zu}",
+            pt->items, phase_unit(i), item_rate(pt), pt->pruned
+        );
+        sep = ",\n";
+    }
+
+    PhaseTime total = total_time(rep);
+    fprintf(out, "\n  ],\n  \"total\": {");
+    print_fields_json(&total, out);
+    fprintf(out, "}\n}\n");
+}
@@ -0,0 +1,115 @@
+#ifndef _TIMING_H
+#define _TIMING_H
+
+#include <stdio.h>
+
+#include "memstat.h"
+
+// Compiler phases measured by a time report, in pipeline order
+typedef enum {
+    PHASE_LOAD,    // `make_lexer`, reading the source
+    PHASE_SCAN,    // `scan`
+    PHASE_PARSE,   // `parse_program`
+    PHASE_FLATTEN, // `flatten_program`
+    PHASE_RESOLVE, // `resolve_program`
+    PHASE_LOWER,   // `lower_program`
+    PHASE_FOLD,    // `fold_module`
+    PHASE_COUNT,
+} Phase;
+
+// Cost of one phase, summed over every time it ran
+typedef struct {
+    unsigned runs; // Times the phase ran
+    double wall;   // Wall clock milliseconds
+    double cpu;    // CPU milliseconds of the thread that ran it and the threads it joined
+    long peak_rss; // Process peak resident set in KiB when the phase ended
+    size_t allocs; // Heap allocations, see `MemStats`
+    size_t bytes;  // Bytes requested by those allocations
+    size_t items;  // Bytes, tokens, nodes or instructions processed, see `phase_unit`
+    size_t pruned; // Items the phase removed, see `prune_items`
+} PhaseTime;
+
+// Per-phase costs of one or more compilations. A zeroed report is empty.
+typedef struct {
+    PhaseTime phases[PHASE_COUNT];
+    Phase current; // Phase being measured
+    double wall;   // Wall clock when `current` started
+    double cpu;    // Thread CPU time when `current` started
+    MemStats mem;  // Allocations when `current` started
+} TimeReport;
+
+/**
+ * @brief Starts measuring `phase`. Phases do not nest, each one is ended
+ * before the next starts, on the same thread.
+ * @param rep
+ * @param phase
+ */
+void start_phase(TimeReport *rep, Phase phase);
+
+/**
+ * @brief Stops measuring the current phase and adds its cost to the report.
+ * @param rep
+ * @param items Bytes, tokens or nodes the phase processed.
+ */
+void end_phase(TimeReport *rep, size_t items);
+
+/**
+ * @brief Records items a phase removed from its input, like the instructions
+ * folded away, shown next to the items it processed.
+ * @param rep
+ * @param phase
+ * @param items
+ */
+void prune_items(TimeReport *rep, Phase phase, size_t items);
+
+/**
+ * @brief CPU time of the calling thread, plus what it absorbed from threads it
+ * joined.
+ * @return Milliseconds.
+ */
+double thread_cpu();
+
+/**
+ * @brief Adds CPU time spent on another thread to the calling thread's, once
+ * that thread is joined, so phases that start threads count their work.
+ * @param ms Difference of two `thread_cpu` calls on the joined thread.
+ */
+void absorb_cpu(double ms);
+
+/**
+ * @brief Adds the costs of `from` to `into`, peak RSS keeps the larger one.
+ * @param into
+ * @param from
+ */
+void merge_report(TimeReport *into, const TimeReport *from);
+
+/**
+ * @brief Display name of a phase.
+ * @param phase
+ * @return
+ */
+const char *phase_str(Phase phase);
+
+/**
+ * @brief What the items of a phase are, "bytes", "tokens", "nodes" or "insts".
+ * @param phase
+ * @return
+ */
+const char *phase_unit(Phase phase);
+
+/**
+ * @brief Prints the report as a table, one row per phase that ran.
+ * @param rep
+ * @param out
+ */
+void print_report(const TimeReport *rep, FILE *out);
+
+/**
+ * @brief Prints the report as a JSON object with a `phases` array, one
+ * object per phase that ran, and a `total` object.
+ * @param rep
+ * @param out
+ */
+void print_report_json(const TimeReport *rep, FILE *out);
+
+#endif
@@ -0,0 +1,163 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+#include "memstat.h"
+#include "types.h"
+
+#define INITIAL_SLOTS 64 // Initial slot count, must be power of two
+
+/**
+ * @brief Hashes one more word into an FNV hash.
+ * @param hash
+ * @param word
+ * @return
+ */
+static unsigned mix(unsigned hash, unsigned word) {
+    for (int i = 0; i < 4; i++) {
+        hash ^= (word >> (8 * i)) & 0xff;
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * @brief Hashes the kind and the parts of a type.
+ * @param type
+ * @return
+ */
+static unsigned hash_type(const Type *type) {
+    unsigned hash = mix(FNV_OFFSET, type->type_kind);
+
+    switch (type->type_kind) {
+    case TY_PTR: hash = mix(hash, type->ptr.ref->id); break;
+    case TY_FUNC:
+        hash = mix(hash, type->func.ret->id);
+        for (unsigned i = 0; i < type->func.param_count; i++) {
+            hash = mix(hash, type->func.params[i]->id);
+        }
+        break;
+    default: break;
+    }
+    return hash;
+}
+
+/**
+ * @brief Checks whether two types have the same kind and the same parts. The
+ * parts are canonical, so they are compared by pointer.
+ * @param a
+ * @param b
+ * @return
+ */
+static bool same_shape(const Type *a, const Type *b) {
+    if (a->hash != b->hash || a->type_kind != b->type_kind) return false;
+
+    switch (a->type_kind) {
+    case TY_PTR: return a->ptr.ref == b->ptr.ref;
+    case TY_FUNC:
+        if (a->func.ret != b->func.ret || a->func.param_count != b->func.param_count) return false;
+        for (unsigned i = 0; i < a->func.param_count; i++) {
+            if (a->func.params[i] != b->func.params[i]) return false;
+        }
+        return true;
+    default: return true;
+    }
+}
+
+/**
+ * @brief Doubles the slot array and reinserts every type by it's stored hash.
+ * @param tt
+ * @return false if memory ran out, the table is unchanged then.
+ */
+static bool grow_types(TypeTable *tt) {
+    unsigned size      = tt->size ? tt->size * 2 : INITIAL_SLOTS;
+    const Type **slots = mem_calloc(size, sizeof(Type *));
+    if (!slots) return false;
+
+    for (unsigned i = 0; i < tt->count; i++) {
+        const Type *type = tt->types[i];
+
+        unsigned idx = type->hash & (size - 1);
+        while (slots[idx]) idx = (idx + 1) & (size - 1);
+        slots[idx] = type;
+    }
+
+    free(tt->slots);
+    tt->slots = slots;
+    tt->size  = size;
+    return true;
+}
+
+/**
+ * @brief Finds the canonical type shaped like `key`, adding a copy of it
+ * when there is none.
+ * @param tt
+ * @param key Type with its kind and parts set, the parameter list is copied.
+ * @return NULL if memory ran out.
+ */
+static const Type *canonical(TypeTable *tt, Type *key) {
+    // Keep load factor under 1/2
+    if (tt->count * 2 >= tt->size && !grow_types(tt)) return NULL;
+
+    key->hash     = hash_type(key);
+    unsigned mask = tt->size - 1;
+    unsigned idx  = key->hash & mask;
+
+    for (const Type *type; (type = tt->slots[idx]); idx = (idx + 1) & mask) {
+        if (same_shape(type, key)) return type;
+    }
+
+    if (tt->count == tt->capacity) {
+        unsigned capacity  = tt->capacity ? tt->capacity * 2 : INITIAL_SLOTS;
+        const Type **types = mem_realloc(tt->types, capacity * sizeof(Type *));
+        if (!types) return NULL;
+
+        tt->types    = types;
+        tt->capacity = capacity;
+    }
+
+    Type *type = arena_alloc(&tt->arena, sizeof(Type));
+    if (!type) return NULL;
+
+    *type    = *key;
+    type->id = tt->count;
+
+    if (key->type_kind == TY_FUNC && key->func.param_count) {
+        size_t size       = key->func.param_count * sizeof(Type *);
+        type->func.params = arena_alloc(&tt->arena, size);
+        if (!type->func.params) return NULL;
+
+        memcpy(type->func.params, key->func.params, size);
+    }
+
+    tt->slots[idx]         = type;
+    tt->types[tt->count++] = type;
+    return type;
+}
+
+const Type *basic_type(TypeTable *tt, TypeKind kind) {
+    Type key = {.type_kind = kind};
+    return canonical(tt, &key);
+}
+
+const Type *pointer_type(TypeTable *tt, const Type *ref) {
+    Type key = {.type_kind = TY_PTR, .ptr.ref = ref};
+    return canonical(tt, &key);
+}
+
+const Type *func_type(TypeTable *tt, const Type *ret, const Type *const *params, unsigned count) {
+    Type key = {
+        .type_kind        = TY_FUNC,
+        .func.ret         = ret,
+        .func.params      = count ? (const Type **)params : NULL,
+        .func.param_count = count,
+    };
+    return canonical(tt, &key);
+}
+
+void purge_types(TypeTable *tt) {
+    purge_arena(&tt->arena);
+    free(tt->slots);
+    free(tt->types);
+    *tt = (TypeTable){0};
+}
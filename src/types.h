@@ -0,0 +1,81 @@
+#ifndef _TYPES_H
+#define _TYPES_H
+
+#include <stdbool.h>
+
+#include "arena.h"
+
+typedef enum {
+    TY_VOID,
+    TY_INT,
+    TY_FLOAT,
+    TY_CHAR,
+    TY_STRING,
+    TY_PTR,
+    TY_FUNC,
+} TypeKind;
+
+typedef struct Type Type;
+
+// Canonical type. Every structurally distinct type has exactly one, so two
+// types are equal if and only if their pointers are equal. The parts of a
+// derived type are canonical too.
+struct Type {
+    TypeKind type_kind;
+    unsigned id;   // Creation order, the parts of a type have smaller ids
+    unsigned hash; // Hash of the kind and the ids of the parts
+    union {
+        struct { // TY_PTR
+            const Type *ref;
+        } ptr;
+        struct { // TY_FUNC
+            const Type *ret;
+            const Type **params; // NULL without parameters
+            unsigned param_count;
+        } func;
+    };
+};
+
+// Open addressing hash-table of canonical types. A zeroed table is ready to use.
+typedef struct {
+    const Type **slots; // Slots, NULL if empty
+    unsigned size;      // Number of slots, power of two
+    unsigned count;     // Number of types
+    const Type **types; // Every type by id
+    unsigned capacity;  // Allocated length of `types`
+    Arena arena;        // Storage of the types and their parameter lists
+} TypeTable;
+
+/**
+ * @brief Canonical type of a kind without parts.
+ * @param tt
+ * @param kind Neither `TY_PTR` nor `TY_FUNC`.
+ * @return NULL if memory ran out.
+ */
+const Type *basic_type(TypeTable *tt, TypeKind kind);
+
+/**
+ * @brief Canonical pointer to `ref`.
+ * @param tt
+ * @param ref Canonical type of the same table.
+ * @return NULL if memory ran out.
+ */
+const Type *pointer_type(TypeTable *tt, const Type *ref);
+
+/**
+ * @brief Canonical function type.
+ * @param tt
+ * @param ret Canonical return type of the same table.
+ * @param params Canonical parameter types, copied when the type is new.
+ * @param count Number of parameters.
+ * @return NULL if memory ran out.
+ */
+const Type *func_type(TypeTable *tt, const Type *ret, const Type *const *params, unsigned count);
+
+/**
+ * @brief Frees every type. Previously returned types become invalid.
+ * @param tt
+ */
+void purge_types(TypeTable *tt);
+
+#endif
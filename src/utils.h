@@ -1,15 +1,9 @@
 #ifndef _UTILS_H
 #define _UTILS_H
 
-#include "lexer.h"
-#include "parser.h"
-
-void errexit(const char *msg);
-void errwarn(const char *msg);
+#define FNV_OFFSET 2166136261u // FNV-1a offset basis
+#define FNV_PRIME  16777619u   // FNV-1a prime
 
 unsigned hashfnv(const char *str, const int size);
 
-void print_ast(Node *node, int indent);
-void print_tlist(const TokList *list);
-
 #endif
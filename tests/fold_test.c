@@ -0,0 +1,242 @@
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "context.h"
+#include "ir.h"
+#include "fold.h"
+
+/*
+ * Builds single block functions `f(x)` returning an expression, folds them
+ * and checks the value returned and the number of instructions removed. The
+ * folded IR has to pass `verify_ir` as well.
+ */
+
+static CompilerContext *ctx;
+static IrModule *mod;
+static IrBuilder *bld;
+static jmp_buf fail;
+static int failures;
+
+/**
+ * @brief Reports a failed check.
+ * @param ok
+ * @param what
+ */
+static void check(bool ok, const char *what) {
+    if (ok) return;
+
+    fprintf(stderr, "FAIL: %s\n", what);
+    failures++;
+}
+
+/**
+ * @brief Starts a function `f` taking and returning `type`.
+ * @param type
+ * @return The parameter `x`.
+ */
+static IrRef begin_case(IrType type) {
+    mod = make_module();
+    bld = mod ? make_builder(mod, &fail) : NULL;
+    if (!bld) longjmp(fail, 1);
+
+    uint32_t func = ir_add_func(mod, intern_cstr(&ctx->interner, "f"), type, &type, 1);
+    if (func == IR_NONE) longjmp(fail, 1);
+
+    ir_begin(bld, func);
+    return ir_param(bld, 0);
+}
+
+/**
+ * @brief Returns `value` from the function, then folds the module.
+ * @param value
+ * @param removed Number of instructions `fold_module` has to remove.
+ * @param what
+ * @return What the function returns after folding.
+ */
+static const IrInst *end_case(IrRef value, size_t removed, const char *what) {
+    ir_ret(bld, value);
+    ir_end(bld);
+    purge_builder(bld);
+
+    size_t folded = fold_module(ctx, mod);
+    check(folded == removed, what);
+    check(verify_ir(ctx, mod), what);
+    if (folded != removed) {
+        fprintf(stderr, "      %zu instructions removed, %zu expected\n", folded, removed);
+        print_ir(mod, stderr);
+    }
+
+    const IrFunc *fn = &mod->funcs[0];
+    return &fn->insts[fn->insts[fn->inst_count - 1].ops[0]];
+}
+
+static IrRef num(IrType type, int32_t value) {
+    return ir_const_int(bld, type, value);
+}
+
+static IrRef flt(double value) {
+    return ir_const_float(bld, value);
+}
+
+static IrRef binary(IrOp op, IrRef lhs, IrRef rhs) {
+    return ir_binary(bld, op, lhs, rhs);
+}
+
+/**
+ * @brief Whether a folded value is the integer constant `value`.
+ * @param inst
+ * @param value
+ * @return
+ */
+static bool is_int(const IrInst *inst, int32_t value) {
+    return inst->op == IR_CONST && inst->type != IT_FLOAT && inst->ival == value;
+}
+
+/***** Tests *****/
+
+/**
+ * @brief `5 * 2 - 3` and `x * 0 + 2` become constants. The unused parameter
+ * goes as well.
+ */
+static void test_constants() {
+    begin_case(IT_INT);
+    IrRef ten           = binary(IR_MUL, num(IT_INT, 5), num(IT_INT, 2));
+    const IrInst *seven = end_case(binary(IR_SUB, ten, num(IT_INT, 3)), 5, "5 * 2 - 3");
+    check(is_int(seven, 7), "5 * 2 - 3 is 7");
+    purge_module(mod);
+
+    IrRef x           = begin_case(IT_INT);
+    IrRef zero        = binary(IR_MUL, x, num(IT_INT, 0));
+    const IrInst *two = end_case(binary(IR_ADD, zero, num(IT_INT, 2)), 4, "x * 0 + 2");
+    check(is_int(two, 2), "x * 0 + 2 is 2");
+    purge_module(mod);
+}
+
+/**
+ * @brief `x + 0`, `x * 1` and `1 * x` are `x`.
+ */
+static void test_identities() {
+    IrRef x           = begin_case(IT_INT);
+    const IrInst *sum = end_case(binary(IR_ADD, x, num(IT_INT, 0)), 2, "x + 0");
+    check(sum->op == IR_PARAM, "x + 0 is x");
+    purge_module(mod);
+
+    x                  = begin_case(IT_INT);
+    const IrInst *prod = end_case(binary(IR_MUL, x, num(IT_INT, 1)), 2, "x * 1");
+    check(prod->op == IR_PARAM, "x * 1 is x");
+    purge_module(mod);
+
+    x    = begin_case(IT_INT);
+    prod = end_case(binary(IR_MUL, num(IT_INT, 1), x), 2, "1 * x");
+    check(prod->op == IR_PARAM, "1 * x is x");
+    purge_module(mod);
+}
+
+/**
+ * @brief Division by zero and `INT32_MIN / -1` are left for run time.
+ */
+static void test_division() {
+    IrRef x            = begin_case(IT_INT);
+    const IrInst *quot = end_case(binary(IR_DIV, x, num(IT_INT, 0)), 0, "x / 0");
+    check(quot->op == IR_DIV, "x / 0 is kept");
+    purge_module(mod);
+
+    begin_case(IT_INT);
+    IrRef min = num(IT_INT, INT32_MIN);
+    quot      = end_case(binary(IR_DIV, min, num(IT_INT, -1)), 1, "INT32_MIN / -1");
+    check(quot->op == IR_DIV, "INT32_MIN / -1 is kept");
+    purge_module(mod);
+}
+
+/**
+ * @brief Char results wrap like `int8_t`.
+ */
+static void test_char_wrap() {
+    begin_case(IT_CHAR);
+    IrRef big         = num(IT_CHAR, 100);
+    const IrInst *sum = end_case(binary(IR_ADD, big, num(IT_CHAR, 100)), 3, "100 + 100");
+    check(is_int(sum, (int8_t)200), "char 100 + 100 wraps");
+    purge_module(mod);
+}
+
+/**
+ * @brief `x + 0.0` and `x * 0.0` do not hold for `-0.0` and infinities, only
+ * `x - 0.0` is `x`.
+ */
+static void test_float() {
+    IrRef x           = begin_case(IT_FLOAT);
+    const IrInst *sum = end_case(binary(IR_ADD, x, flt(0.0)), 0, "x + 0.0");
+    check(sum->op == IR_ADD, "float x + 0.0 is kept");
+    purge_module(mod);
+
+    x                  = begin_case(IT_FLOAT);
+    const IrInst *prod = end_case(binary(IR_MUL, x, flt(0.0)), 0, "x * 0.0");
+    check(prod->op == IR_MUL, "float x * 0.0 is kept");
+    purge_module(mod);
+
+    x                  = begin_case(IT_FLOAT);
+    const IrInst *diff = end_case(binary(IR_SUB, x, flt(0.0)), 2, "x - 0.0");
+    check(diff->op == IR_PARAM, "float x - 0.0 is x");
+    purge_module(mod);
+
+    x    = begin_case(IT_FLOAT);
+    diff = end_case(binary(IR_SUB, x, flt(-0.0)), 0, "x - -0.0");
+    check(diff->op == IR_SUB, "float x - -0.0 is kept");
+    purge_module(mod);
+}
+
+/**
+ * @brief Integer `x * 2^k` and `2^k * x` become `x << k`, other factors and
+ * divisions stay.
+ */
+static void test_shift() {
+    IrRef x           = begin_case(IT_INT);
+    const IrInst *shl = end_case(binary(IR_MUL, x, num(IT_INT, 8)), 1, "x * 8");
+    check(shl->op == IR_SHL && shl->ops[0] == 0 && shl->ops[1] == 3, "x * 8 is x << 3");
+    purge_module(mod);
+
+    x   = begin_case(IT_CHAR);
+    shl = end_case(binary(IR_MUL, num(IT_CHAR, 4), x), 1, "4 * x");
+    check(shl->op == IR_SHL && shl->ops[0] == 0 && shl->ops[1] == 2, "char 4 * x is x << 2");
+    purge_module(mod);
+
+    x                 = begin_case(IT_INT);
+    const IrInst *mul = end_case(binary(IR_MUL, x, num(IT_INT, 6)), 0, "x * 6");
+    check(mul->op == IR_MUL, "x * 6 is kept");
+    purge_module(mod);
+
+    x                 = begin_case(IT_INT);
+    const IrInst *div = end_case(binary(IR_DIV, x, num(IT_INT, 4)), 0, "x / 4");
+    check(div->op == IR_DIV, "signed x / 4 is kept");
+    purge_module(mod);
+
+    x   = begin_case(IT_FLOAT);
+    mul = end_case(binary(IR_MUL, x, flt(8.0)), 0, "float x * 8.0");
+    check(mul->op == IR_MUL, "float x * 8.0 is kept");
+    purge_module(mod);
+}
+
+int main() {
+    ctx = make_context();
+    if (!ctx) return 1;
+
+    if (setjmp(fail)) {
+        fprintf(stderr, "FAIL: out of memory\n");
+        return 1;
+    }
+
+    test_constants();
+    test_identities();
+    test_division();
+    test_char_wrap();
+    test_float();
+    test_shift();
+
+    print_diags(&ctx->diags, stderr);
+    purge_context(ctx);
+    if (failures) return 1;
+
+    printf("fold: all tests passed\n");
+    return 0;
+}
@@ -0,0 +1,313 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "context.h"
+#include "flat.h"
+#include "lower.h"
+#include "fold.h"
+
+/*
+ * Lowers statements the parser cannot produce yet (if, loops, break and
+ * continue, the conditional operator) from a flat AST built by hand, and
+ * checks the IR with `verify_ir` before and after folding.
+ */
+
+#define POOL 256 // Capacity of every pool, enough for the programs below
+
+static FlatAst ast;
+static CompilerContext *ctx;
+static int failures;
+
+/**
+ * @brief Reports a failed check.
+ * @param ok
+ * @param what
+ */
+static void check(bool ok, const char *what) {
+    if (ok) return;
+
+    fprintf(stderr, "FAIL: %s\n", what);
+    failures++;
+}
+
+/**
+ * @brief Starts an empty program with the types `void`, `int` and
+ * `int (int)` at 0, 1 and 2.
+ */
+static void reset_ast() {
+    ast.types       = calloc(POOL, sizeof(FlatType));
+    ast.decls       = calloc(POOL, sizeof(FlatDecl));
+    ast.blocks      = calloc(POOL, sizeof(FlatBlock));
+    ast.stmts       = calloc(POOL, sizeof(FlatStmt));
+    ast.exprs       = calloc(POOL, sizeof(FlatExpr));
+    ast.extra       = calloc(POOL * 4, sizeof(uint32_t));
+    ast.decl_count  = 0;
+    ast.block_count = 0;
+    ast.stmt_count  = 0;
+    ast.expr_count  = 0;
+    ast.extra_count = 1; // List 0, the empty list
+
+    ast.types[0].kind = TY_VOID;
+    ast.types[1].kind = TY_INT;
+    ast.types[2].kind = TY_FUNC;
+    ast.type_count    = 3;
+}
+
+/**
+ * @brief Frees the pools of the program.
+ */
+static void free_ast() {
+    free(ast.types);
+    free(ast.decls);
+    free(ast.blocks);
+    free(ast.stmts);
+    free(ast.exprs);
+    free(ast.extra);
+}
+
+/***** Builders *****/
+
+static uint32_t list(int count, ...) {
+    uint32_t at                  = ast.extra_count;
+    ast.extra[ast.extra_count++] = count;
+
+    va_list ap;
+    va_start(ap, count);
+    for (int i = 0; i < count; i++) ast.extra[ast.extra_count++] = va_arg(ap, uint32_t);
+    va_end(ap);
+    return at;
+}
+
+static NodeRef expr(FlatExpr e) {
+    ast.exprs[ast.expr_count] = e;
+    return ast.expr_count++;
+}
+
+static NodeRef num(int value) {
+    return expr((FlatExpr){.kind = EXPR_CONST, .op = CONST_INT, .ival = value});
+}
+
+static NodeRef var(const char *name) {
+    return expr((FlatExpr){.kind = EXPR_VAR, .name = intern_cstr(&ctx->interner, name)});
+}
+
+static NodeRef unary(UnOp op, NodeRef operand) {
+    return expr((FlatExpr){.kind = EXPR_UNARY, .op = op, .operand = operand});
+}
+
+static NodeRef binary(BinOp op, NodeRef left, NodeRef right) {
+    return expr((FlatExpr){.kind = EXPR_BINARY, .op = op, .binary = {left, right}});
+}
+
+static NodeRef assign(const char *name, NodeRef value) {
+    return expr((FlatExpr){.kind = EXPR_ASSIGN, .op = BOP_ASSIGN, .binary = {var(name), value}});
+}
+
+static NodeRef ternary(NodeRef cond, NodeRef then, NodeRef else_) {
+    return expr((FlatExpr){.kind = EXPR_TERNARY, .conditional = list(3, cond, then, else_) + 1});
+}
+
+static NodeRef block(uint32_t items) {
+    ast.blocks[ast.block_count] = (FlatBlock){.items = items};
+    return ast.block_count++;
+}
+
+/**
+ * @brief Adds a statement.
+ * @param s
+ * @return The statement tagged as a block item, untag it to nest it.
+ */
+static NodeRef stmt(FlatStmt s) {
+    ast.stmts[ast.stmt_count] = s;
+    return ast.stmt_count++ | ITEM_STMT;
+}
+
+static NodeRef compound(uint32_t items) {
+    return stmt((FlatStmt){.kind = STMT_COMPOUND, .block = block(items)});
+}
+
+static NodeRef expr_stmt(NodeRef e) {
+    return stmt((FlatStmt){.kind = STMT_EXPR, .expr = e});
+}
+
+static NodeRef return_stmt(NodeRef e) {
+    return stmt((FlatStmt){.kind = STMT_RETURN, .expr = e});
+}
+
+static NodeRef jump_stmt(StmtType kind) {
+    return stmt((FlatStmt){.kind = kind});
+}
+
+static NodeRef if_stmt(NodeRef cond, NodeRef then, NodeRef else_) {
+    if (else_ != NO_NODE) else_ &= ~ITEM_STMT;
+    return stmt((FlatStmt){.kind = STMT_IF, ._if = {cond, then & ~ITEM_STMT, else_}});
+}
+
+static NodeRef loop_stmt(StmtType kind, NodeRef cond, NodeRef body) {
+    return stmt((FlatStmt){.kind = kind, ._while = {cond, body & ~ITEM_STMT}});
+}
+
+static NodeRef for_stmt(NodeRef init, NodeRef cond, NodeRef post, NodeRef body) {
+    return stmt((FlatStmt){.kind = STMT_FOR, ._for = {init, cond, post, body & ~ITEM_STMT}});
+}
+
+static NodeRef var_decl(const char *name, NodeRef init) {
+    ast.decls[ast.decl_count] = (FlatDecl){
+        .name = intern_cstr(&ctx->interner, name),
+        .type = 1,
+        .var  = {init},
+    };
+    return ast.decl_count++;
+}
+
+/**
+ * @brief Declares `int name(int n)` with `items` as its body, as the only
+ * declaration of the program.
+ * @param name
+ * @param items
+ */
+static void define_func(const char *name, uint32_t items) {
+    ast.types[2].func.ret    = 1;
+    ast.types[2].func.params = list(1, 1);
+
+    NodeRef param = var_decl("n", NO_NODE);
+    NodeRef body  = block(items);
+
+    ast.decls[ast.decl_count] = (FlatDecl){
+        .name = intern_cstr(&ctx->interner, name),
+        .type = 2,
+        .func = {list(1, param), body},
+    };
+    ast.program = list(1, ast.decl_count++);
+}
+
+/**
+ * @brief Finds a function of a module by name.
+ * @param mod
+ * @param name
+ * @return NULL if there is none.
+ */
+static const IrFunc *find_func(const IrModule *mod, const char *name) {
+    const Atom *atom = intern_cstr(&ctx->interner, name);
+    for (uint32_t f = 0; f < mod->func_count; f++) {
+        if (mod->funcs[f].name == atom) return &mod->funcs[f];
+    }
+    return NULL;
+}
+
+/***** Tests *****/
+
+/**
+ * @brief Lowers a function with every loop kind, `if` with and without `else`,
+ * `break` and `continue`, short circuit operators and a conditional.
+ *
+ *     int f(int n) {
+ *         int s = 0;
+ *         int i = 0;
+ *         while (i < n) {
+ *             if (i % 2 == 0) { s = s + i; } else { i = i + 1; continue; }
+ *             i = i + 1;
+ *             if (s > 100) break;
+ *         }
+ *         do { s = s - 1; } while (s > 50);
+ *         for (int k = 0; k < 3; k = k + 1) { s = s + k; }
+ *         for (;;) { break; }
+ *         if (!(n || s)) return 7;
+ *         return s > 3 && n < 10 ? s : -1;
+ *     }
+ */
+static void test_control_flow() {
+    reset_ast();
+
+    NodeRef is_even = binary(BOP_EQ, binary(BOP_MOD, var("i"), num(2)), num(0));
+    NodeRef add_i   = assign("s", binary(BOP_ADD, var("s"), var("i")));
+    NodeRef next_i  = assign("i", binary(BOP_ADD, var("i"), num(1)));
+    NodeRef even    = compound(list(1, expr_stmt(add_i)));
+    NodeRef odd     = compound(list(2, expr_stmt(next_i), jump_stmt(STMT_CONTINUE)));
+
+    NodeRef loop = loop_stmt(
+        STMT_WHILE, binary(BOP_LT, var("i"), var("n")),
+        compound(list(
+            3, if_stmt(is_even, even, odd),
+            expr_stmt(assign("i", binary(BOP_ADD, var("i"), num(1)))),
+            if_stmt(binary(BOP_GT, var("s"), num(100)), jump_stmt(STMT_BREAK), NO_NODE)
+        ))
+    );
+
+    NodeRef down = loop_stmt(
+        STMT_DO_WHILE, binary(BOP_GT, var("s"), num(50)),
+        compound(list(1, expr_stmt(assign("s", binary(BOP_SUB, var("s"), num(1))))))
+    );
+    NodeRef count = for_stmt(
+        var_decl("k", num(0)), binary(BOP_LT, var("k"), num(3)),
+        assign("k", binary(BOP_ADD, var("k"), num(1))),
+        compound(list(1, expr_stmt(assign("s", binary(BOP_ADD, var("s"), var("k"))))))
+    );
+    NodeRef forever = for_stmt(NO_NODE, NO_NODE, NO_NODE, compound(list(1, jump_stmt(STMT_BREAK))));
+
+    NodeRef not_any = unary(UOP_NOT, binary(BOP_OR, var("n"), var("s")));
+    NodeRef early   = if_stmt(not_any, return_stmt(num(7)), NO_NODE);
+    NodeRef big     = binary(BOP_GT, var("s"), num(3));
+    NodeRef few     = binary(BOP_LT, var("n"), num(10));
+    NodeRef pick    = ternary(binary(BOP_AND, big, few), var("s"), unary(UOP_NEG, num(1)));
+    NodeRef result  = return_stmt(pick);
+
+    NodeRef s = var_decl("s", num(0));
+    NodeRef i = var_decl("i", num(0));
+    define_func("f", list(8, s, i, loop, down, count, forever, early, result));
+
+    IrModule *mod = lower_program(ctx, &ast);
+    check(mod && ctx->err == CERR_OK, "control flow lowers");
+    if (mod) {
+        const IrFunc *fn = find_func(mod, "f");
+        check(fn && fn->block_count > 1, "control flow makes blocks");
+
+        uint32_t phis = 0;
+        for (uint32_t k = 0; fn && k < fn->block_count; k++) phis += fn->blocks[k].phis;
+        check(phis > 0, "loop carried values become phis");
+
+        check(verify_ir(ctx, mod), "lowered control flow verifies");
+        fold_module(ctx, mod);
+        check(verify_ir(ctx, mod), "folded control flow verifies");
+    }
+
+    print_diags(&ctx->diags, stderr);
+    purge_module(mod);
+    free_ast();
+}
+
+/**
+ * @brief `break` outside a loop is reported instead of lowered.
+ *
+ *     int g(int n) { break; return n; }
+ */
+static void test_stray_break() {
+    reset_ast();
+    define_func("g", list(2, jump_stmt(STMT_BREAK), return_stmt(var("n"))));
+
+    IrModule *mod = lower_program(ctx, &ast);
+    check(!mod && ctx->err == CERR_IR, "break outside a loop is reported");
+
+    purge_module(mod);
+    free_ast();
+}
+
+int main() {
+    ctx = make_context();
+    if (!ctx) return 1;
+
+    test_control_flow();
+    purge_context(ctx);
+
+    ctx = make_context();
+    if (!ctx) return 1;
+
+    test_stray_break();
+    purge_context(ctx);
+
+    if (failures) return 1;
+
+    printf("lower: all tests passed\n");
+    return 0;
+}